@@ -0,0 +1,556 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file exports interned triples as Apache Arrow record batches. The
+// batches are handed over through the Arrow C data interface, which any
+// Arrow implementation (pyarrow, arrow-rs, DuckDB, ...) can import without
+// copying; with BST_HAVE_ARROW they can also be written to Arrow IPC
+// files through the Arrow C++ library.
+//
+// A batch has three columns, subject, predicate and object, each
+// dictionary-encoded: int32 indices into one dictionary of terms shared
+// by every column and every batch. The dictionary is a struct array of
+// kind (int8, a term_kind), value, datatype and language (large strings;
+// datatype is empty but for typed literals, language but for literals
+// with a language tag).
+//===========================================================================
+
+#ifndef BST_ARROW_EXPORT_HPP_
+#define BST_ARROW_EXPORT_HPP_
+
+#include "term_id.hpp"
+#include "term_dictionary.hpp"
+#include "sharded.hpp"
+
+#include <list>
+#include <algorithm>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdint>
+
+#ifdef BST_HAVE_ARROW
+#include <arrow/array.h>
+#include <arrow/buffer.h>
+#include <arrow/c/bridge.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#include <arrow/record_batch.h>
+#endif
+
+//===========================================================================
+// The C data interface structures, as given by the Arrow specification.
+// The guard is the one the specification asks every copy to use.
+//===========================================================================
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema
+{
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+  void (*release)(struct ArrowSchema*);
+  void* private_data;
+};
+
+struct ArrowArray
+{
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+  void (*release)(struct ArrowArray*);
+  void* private_data;
+};
+
+#endif
+
+namespace rdf {
+
+namespace {
+
+//----------------------------------------------------------------------
+// What an exported schema or array owns. Children live in the parent's
+// holder, and the release callbacks release them along with it, as the
+// specification asks; the data behind the buffers is kept alive by a
+// shared_ptr, so arrays sharing data (every column's dictionary) do not
+// need to copy it.
+//----------------------------------------------------------------------
+struct arrow_schema_holder
+{
+  explicit arrow_schema_holder(std::size_t n)
+    : children(n), child_pointers(n)
+  {}
+
+  std::string format;
+  std::string name;
+  std::vector<ArrowSchema> children;
+  std::vector<ArrowSchema*> child_pointers;
+  ArrowSchema dictionary;
+};
+
+struct arrow_array_holder
+{
+  explicit arrow_array_holder(std::size_t n)
+    : children(n), child_pointers(n)
+  {}
+
+  std::vector<void const*> buffers;
+  std::vector<ArrowArray> children;
+  std::vector<ArrowArray*> child_pointers;
+  ArrowArray dictionary;
+  std::shared_ptr<void const> data;
+};
+
+inline void release_arrow_schema(ArrowSchema* schema)
+{
+  arrow_schema_holder* h = static_cast<arrow_schema_holder*>(schema->private_data);
+  for (std::size_t i = 0; i < h->child_pointers.size(); ++i)
+    if (h->child_pointers[i]->release != NULL)
+      h->child_pointers[i]->release(h->child_pointers[i]);
+  if (schema->dictionary != NULL && schema->dictionary->release != NULL)
+    schema->dictionary->release(schema->dictionary);
+  delete h;
+  schema->release = NULL;
+}
+
+inline void release_arrow_array(ArrowArray* array)
+{
+  arrow_array_holder* h = static_cast<arrow_array_holder*>(array->private_data);
+  for (std::size_t i = 0; i < h->child_pointers.size(); ++i)
+    if (h->child_pointers[i]->release != NULL)
+      h->child_pointers[i]->release(h->child_pointers[i]);
+  if (array->dictionary != NULL && array->dictionary->release != NULL)
+    array->dictionary->release(array->dictionary);
+  delete h;
+  array->release = NULL;
+}
+
+//----------------------------------------------------------------------
+// Fill in a schema node; returns its holder so children and dictionary
+// can be filled in next.
+//----------------------------------------------------------------------
+inline arrow_schema_holder* make_arrow_schema(
+  ArrowSchema* out, char const* format, char const* name,
+  std::size_t n_children, std::int64_t flags = 0)
+{
+  arrow_schema_holder* h = new arrow_schema_holder(n_children);
+  h->format = format;
+  h->name = name;
+  for (std::size_t i = 0; i < n_children; ++i)
+    h->child_pointers[i] = &h->children[i];
+
+  out->format = h->format.c_str();
+  out->name = h->name.c_str();
+  out->metadata = NULL;
+  out->flags = flags;
+  out->n_children = static_cast<std::int64_t>(n_children);
+  out->children = n_children != 0 ? h->child_pointers.data() : NULL;
+  out->dictionary = NULL;
+  out->release = &release_arrow_schema;
+  out->private_data = h;
+  return h;
+}
+
+inline arrow_array_holder* make_arrow_array(
+  ArrowArray* out, std::int64_t length, std::vector<void const*> const& buffers,
+  std::size_t n_children, std::shared_ptr<void const> const& data)
+{
+  arrow_array_holder* h = new arrow_array_holder(n_children);
+  h->buffers = buffers;
+  h->data = data;
+  for (std::size_t i = 0; i < n_children; ++i)
+    h->child_pointers[i] = &h->children[i];
+
+  out->length = length;
+  out->null_count = 0;
+  out->offset = 0;
+  out->n_buffers = static_cast<std::int64_t>(buffers.size());
+  out->n_children = static_cast<std::int64_t>(n_children);
+  out->buffers = h->buffers.data();
+  out->children = n_children != 0 ? h->child_pointers.data() : NULL;
+  out->dictionary = NULL;
+  out->release = &release_arrow_array;
+  out->private_data = h;
+  return h;
+}
+
+} // namespace
+
+//===========================================================================
+// Exports triples against a snapshot of a term_dictionary. Arrow's string
+// layouts want a column's values back to back in one buffer, while the
+// dictionary keeps every term in a string of its own, so each term is
+// copied once, when the exporter is built, into the dictionary arrays
+// every batch then shares. That is the only copy: batches themselves are
+// only the int32 indices.
+//
+// The dictionary holds the terms in term_dictionary::for_each( ) order:
+// the vocabulary, then each stripe's terms in id order. A term's index is
+// therefore its stripe's starting position plus its index within the
+// stripe, and is found with no lookup. Triples using terms interned after
+// the snapshot cannot be exported; export_batch( ) throws
+// std::domain_error for them.
+//===========================================================================
+class arrow_exporter
+{
+  static const std::size_t stripe_count = std::size_t(1) << term_stripe_bits;
+
+public:
+  explicit arrow_exporter(term_dictionary const& dict)
+    : terms_(std::make_shared<arrow_term_columns>()),
+      starts_(stripe_count, 0), counts_(stripe_count, 0)
+  {
+    arrow_term_columns& t = *terms_;
+    t.value_offsets.push_back(0);
+    t.datatype_offsets.push_back(0);
+    t.language_offsets.push_back(0);
+
+    dict.for_each([this, &t](term_id id, term_view const& v) {
+        std::size_t stripe = (id >> term_index_bits) & (stripe_count - 1);
+        if (counts_[stripe] == 0)
+          starts_[stripe] = static_cast<std::int32_t>(t.kinds.size());
+        ++counts_[stripe];
+
+        t.kinds.push_back(static_cast<std::int8_t>(v.kind));
+        t.values.append(v.data, v.size);
+        t.value_offsets.push_back(static_cast<std::int64_t>(t.values.size()));
+        t.datatypes.append(v.datatype, v.datatype_size);
+        t.datatype_offsets.push_back(static_cast<std::int64_t>(t.datatypes.size()));
+        t.languages.append(v.language, v.language_size);
+        t.language_offsets.push_back(static_cast<std::int64_t>(t.languages.size()));
+      });
+
+    if (t.kinds.size() > 0x7FFFFFFFu)
+      throw std::domain_error("too many terms for an Arrow dictionary");
+  }
+
+  std::size_t dictionary_size() const { return terms_->kinds.size(); }
+
+  //----------------------------------------------------------------------
+  // The schema of the batches: a struct of the three dictionary-encoded
+  // columns. The caller owns the result and must release it.
+  //----------------------------------------------------------------------
+  void export_schema(ArrowSchema* out) const
+  {
+    static char const* const names[3] = { "subject", "predicate", "object" };
+
+    arrow_schema_holder* h = make_arrow_schema(out, "+s", "", 3);
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+      arrow_schema_holder* column = make_arrow_schema(&h->children[i], "i", names[i], 0);
+      out->children[i]->dictionary = &column->dictionary;
+
+      arrow_schema_holder* term = make_arrow_schema(&column->dictionary, "+s", "", 4);
+      make_arrow_schema(&term->children[0], "c", "kind", 0);
+      make_arrow_schema(&term->children[1], "U", "value", 0);
+      make_arrow_schema(&term->children[2], "U", "datatype", 0);
+      make_arrow_schema(&term->children[3], "U", "language", 0);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // Export n triples as one record batch (a struct array, as the C data
+  // interface represents batches). The caller owns the result and must
+  // release it; the dictionary stays valid for as long as any batch
+  // referring to it does, even past the exporter.
+  //
+  // The C data interface hangs a dictionary off every dictionary-encoded
+  // column, so each of the three columns of every batch carries its own
+  // ArrowArray for it. These all point at the same buffers; nothing is
+  // copied. A consumer importing the batches does see three dictionaries
+  // per batch, though, and one comparing them against the last batch's
+  // pays for the comparison: arrow_ipc_writer avoids that by building
+  // its batches around a single imported dictionary instead.
+  //----------------------------------------------------------------------
+  void export_batch(id_triple const* triples, std::size_t n, ArrowArray* out) const
+  {
+    std::shared_ptr<arrow_index_columns> indices = std::make_shared<arrow_index_columns>();
+    for (std::size_t c = 0; c < 3; ++c)
+      indices->columns[c].resize(n);
+
+    std::int32_t* s = indices->columns[0].data();
+    std::int32_t* p = indices->columns[1].data();
+    std::int32_t* o = indices->columns[2].data();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      s[i] = index_of(triples[i].subject);
+      p[i] = index_of(triples[i].predicate);
+      o[i] = index_of(triples[i].object);
+    }
+
+    std::int64_t length = static_cast<std::int64_t>(n);
+    std::vector<void const*> no_validity(1, static_cast<void const*>(NULL));
+    arrow_array_holder* h = make_arrow_array(out, length, no_validity, 3, indices);
+    for (std::size_t c = 0; c < 3; ++c)
+    {
+      std::vector<void const*> buffers(2);
+      buffers[1] = indices->columns[c].data();
+      arrow_array_holder* column = make_arrow_array(&h->children[c], length, buffers, 0, indices);
+      h->children[c].dictionary = &column->dictionary;
+      export_dictionary(&column->dictionary);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // The dictionary index of a term.
+  //----------------------------------------------------------------------
+  std::int32_t index_of(term_id id) const
+  {
+    std::size_t stripe = (id >> term_index_bits) & (stripe_count - 1);
+    std::uint32_t index = id & ((1u << term_index_bits) - 1);
+    if (id == invalid_term_id || index >= counts_[stripe])
+      throw std::domain_error("term not in the exported dictionary");
+    return starts_[stripe] + static_cast<std::int32_t>(index);
+  }
+
+  //----------------------------------------------------------------------
+  // The dictionary on its own, as the struct array of term columns every
+  // batch refers to. The caller owns the result and must release it.
+  //----------------------------------------------------------------------
+  void export_dictionary(ArrowArray* out) const
+  {
+    arrow_term_columns const& t = *terms_;
+    std::int64_t length = static_cast<std::int64_t>(t.kinds.size());
+
+    std::vector<void const*> no_validity(1, static_cast<void const*>(NULL));
+    arrow_array_holder* h = make_arrow_array(out, length, no_validity, 4, terms_);
+
+    std::vector<void const*> kinds(2);
+    kinds[1] = t.kinds.data();
+    make_arrow_array(&h->children[0], length, kinds, 0, terms_);
+
+    std::vector<void const*> values(3);
+    values[1] = t.value_offsets.data();
+    values[2] = t.values.data();
+    make_arrow_array(&h->children[1], length, values, 0, terms_);
+
+    std::vector<void const*> datatypes(3);
+    datatypes[1] = t.datatype_offsets.data();
+    datatypes[2] = t.datatypes.data();
+    make_arrow_array(&h->children[2], length, datatypes, 0, terms_);
+
+    std::vector<void const*> languages(3);
+    languages[1] = t.language_offsets.data();
+    languages[2] = t.languages.data();
+    make_arrow_array(&h->children[3], length, languages, 0, terms_);
+  }
+
+private:
+  //----------------------------------------------------------------------
+  // The term dictionary and the indices of a batch, laid out as Arrow
+  // buffers.
+  //----------------------------------------------------------------------
+  struct arrow_term_columns
+  {
+    std::vector<std::int8_t> kinds;
+    std::vector<std::int64_t> value_offsets;
+    std::string values;
+    std::vector<std::int64_t> datatype_offsets;
+    std::string datatypes;
+    std::vector<std::int64_t> language_offsets;
+    std::string languages;
+  };
+
+  struct arrow_index_columns
+  {
+    std::vector<std::int32_t> columns[3];
+  };
+
+  std::shared_ptr<arrow_term_columns> terms_;
+  std::vector<std::int32_t> starts_;
+  std::vector<std::uint32_t> counts_;
+};
+
+//===========================================================================
+// A visitor collecting interned triples straight from the parsers into
+// batches for export, without loading a store. Use it with an
+// interning_converter, from any number of threads; each thread fills
+// batches of its own. Read the batches once the parsers are done, then
+// build the exporter, so that the dictionary covers every term.
+//===========================================================================
+class arrow_sink
+{
+public:
+  explicit arrow_sink(std::size_t batch_rows = 1 << 16)
+    : state_(std::make_shared<state>(batch_rows))
+  {}
+
+  template <typename Iter>
+  void operator()(std::string const&, Iter first, Iter last) const
+  {
+    std::vector<id_triple>& batch = open_.local();
+    for (; first != last; ++first)
+    {
+      batch.push_back(*first);
+      if (batch.size() == state_->batch_rows)
+      {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->full.push_back(std::vector<id_triple>());
+        state_->full.back().swap(batch);
+      }
+    }
+  }
+
+  std::list<std::vector<id_triple>>& batches() const
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    open_.merge([this](std::vector<id_triple>&, std::vector<id_triple>& batch) {
+        if (!batch.empty())
+        {
+          state_->full.push_back(std::vector<id_triple>());
+          state_->full.back().swap(batch);
+        }
+      });
+    return state_->full;
+  }
+
+private:
+  struct state
+  {
+    explicit state(std::size_t rows) : batch_rows(rows != 0 ? rows : 1) {}
+
+    std::size_t batch_rows;
+    std::mutex mutex;
+    std::list<std::vector<id_triple>> full;
+  };
+
+  std::shared_ptr<state> state_;
+  sharded<std::vector<id_triple>> open_;
+};
+
+#ifdef BST_HAVE_ARROW
+
+//===========================================================================
+// Writes exported triples to an Arrow IPC file through the Arrow C++
+// library. The dictionary is imported once, without copying, and every
+// column of every batch is built around that one array, so the writer
+// recognises it as unchanged by pointer instead of comparing it term by
+// term on each batch. The IPC format gives each dictionary-encoded field
+// a dictionary of its own, however, so the file does hold the terms three
+// times, once per column, written with the first batch. Errors are
+// thrown as std::domain_error.
+//===========================================================================
+class arrow_ipc_writer
+{
+public:
+  arrow_ipc_writer(std::string const& file_name, arrow_exporter const& exporter)
+    : exporter_(exporter)
+  {
+    ArrowSchema c_schema;
+    exporter_.export_schema(&c_schema);
+    schema_ = check(arrow::ImportSchema(&c_schema));
+
+    ArrowArray c_dictionary;
+    exporter_.export_dictionary(&c_dictionary);
+    dictionary_ = check(arrow::ImportArray(&c_dictionary, term_type()));
+
+    std::shared_ptr<arrow::io::FileOutputStream> file =
+      check(arrow::io::FileOutputStream::Open(file_name));
+    writer_ = check(arrow::ipc::MakeFileWriter(file, schema_));
+  }
+
+  void write(id_triple const* triples, std::size_t n)
+  {
+    std::int64_t length = static_cast<std::int64_t>(n);
+    std::shared_ptr<arrow::Buffer> buffers[3];
+    std::int32_t* indices[3];
+    for (std::size_t c = 0; c < 3; ++c)
+    {
+      buffers[c] = check(arrow::AllocateBuffer(length * sizeof(std::int32_t)));
+      indices[c] = reinterpret_cast<std::int32_t*>(buffers[c]->mutable_data());
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      indices[0][i] = exporter_.index_of(triples[i].subject);
+      indices[1][i] = exporter_.index_of(triples[i].predicate);
+      indices[2][i] = exporter_.index_of(triples[i].object);
+    }
+
+    std::vector<std::shared_ptr<arrow::Array>> columns;
+    for (std::size_t c = 0; c < 3; ++c)
+      columns.push_back(std::make_shared<arrow::DictionaryArray>(
+          schema_->field(static_cast<int>(c))->type(),
+          std::make_shared<arrow::Int32Array>(length, buffers[c]),
+          dictionary_));
+
+    std::shared_ptr<arrow::RecordBatch> batch = arrow::RecordBatch::Make(schema_, length, columns);
+    check(writer_->WriteRecordBatch(*batch));
+  }
+
+  void write(std::vector<id_triple> const& triples, std::size_t batch_rows = 1 << 20)
+  {
+    for (std::size_t i = 0; i < triples.size(); i += batch_rows)
+      write(triples.data() + i, std::min(batch_rows, triples.size() - i));
+  }
+
+  void close()
+  {
+    check(writer_->Close());
+  }
+
+private:
+  static void check(arrow::Status const& status)
+  {
+    if (!status.ok())
+      throw std::domain_error(status.ToString());
+  }
+
+  template <typename T>
+  static T check(arrow::Result<T> result)
+  {
+    check(result.status());
+    return std::move(result).ValueOrDie();
+  }
+
+  std::shared_ptr<arrow::DataType> term_type() const
+  {
+    return static_cast<arrow::DictionaryType const&>(*schema_->field(0)->type()).value_type();
+  }
+
+  arrow_exporter const& exporter_;
+  std::shared_ptr<arrow::Schema> schema_;
+  std::shared_ptr<arrow::Array> dictionary_;
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> writer_;
+};
+
+#endif
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,114 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains the batch parsing API: parse a large number of local
+// rdf files on a pool of worker threads, calling a visitor on the triples
+// of each document as it is parsed.
+//===========================================================================
+
+#ifndef BST_BATCH_PARSER_HPP_
+#define BST_BATCH_PARSER_HPP_
+
+#include "rdf_parser.hpp"
+#include "batch_reader.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <string>
+#include <iostream>
+#include <vector>
+
+namespace rdf {
+
+//===========================================================================
+// Parse every file named in [first, last). The files are read in batches
+// by read_files( ) and parsed on the worker threads with contexts from the
+// parser's pool. For every file, the visitor is called as
+//
+//   visitor(file_name, first_triple, last_triple)
+//
+// which is the same interface the ontology_walker visitors use. Calls
+// happen concurrently, so the visitor must be thread-safe. Returns the
+// number of documents that could not be read or that the parser reported
+// errors for. A file that cannot be read is not visited; it is passed to
+// opts.on_error if set, or else its name and the reason are written to
+// std::cerr, as the parser does with its own errors.
+//
+// A converter may be given to change what the visitor sees; with an
+// interning_converter, for instance, it is handed id_triples. Any parser
+// with rdf_parser's parse_buffer( ) will do, ntriples_parser included.
+//===========================================================================
+template <typename Parser, typename InputIter, typename Visitor, typename Converter>
+std::size_t parse_files(
+  Parser const& parser, InputIter first, InputIter last,
+  thread_pool& workers, Visitor visitor, Converter conv,
+  batch_read_options const& opts = batch_read_options())
+{
+  typedef typename Converter::result_type triple_type;
+  std::atomic<std::size_t> bad_documents(0);
+
+  batch_read_options read_opts = opts;
+  batch_read_options::error_handler on_error = opts.on_error;
+  read_opts.on_error = [&bad_documents, on_error](std::string const& name, std::string const& message) {
+      ++bad_documents;
+      if (on_error)
+        on_error(name, message);
+      else
+        std::cerr << message << std::endl;
+    };
+
+  read_files(first, last, workers,
+    [&parser, &bad_documents, visitor, conv](std::string const& name,
+                                            unsigned char const* data, std::size_t size)
+    {
+      std::vector<triple_type> triples;
+      if (!parser.parse_buffer(name, data, size, std::back_inserter(triples), conv))
+        ++bad_documents;
+      visitor(name, std::begin(triples), std::end(triples));
+    },
+    read_opts);
+
+  return bad_documents;
+}
+
+template <typename Parser, typename InputIter, typename Visitor>
+std::size_t parse_files(
+  Parser const& parser, InputIter first, InputIter last,
+  thread_pool& workers, Visitor visitor,
+  batch_read_options const& opts = batch_read_options())
+{
+  return parse_files(parser, first, last, workers, visitor, rdf_triple_converter(), opts);
+}
+
+template <typename InputIter, typename Visitor>
+std::size_t parse_files(
+  InputIter first, InputIter last, Visitor visitor,
+  batch_read_options const& opts = batch_read_options())
+{
+  rdf_parser parser;
+  thread_pool workers;
+  return parse_files(parser, first, last, workers, visitor, opts);
+}
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,444 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines read_files, which loads many small files as whole
+// buffers and hands each one to a worker thread. It is the I/O side of the
+// batch parsing API in batch_parser.hpp.
+//
+// When the library is built with BST_HAVE_LIBURING defined (and linked
+// against liburing), opens, size queries, reads and closes are batched
+// through io_uring, so a batch of files costs a handful of system calls
+// instead of four per file. Otherwise, or if the kernel refuses to set up
+// a ring, every worker simply reads its own files with pread.
+//===========================================================================
+
+#ifndef BST_BATCH_READER_HPP_
+#define BST_BATCH_READER_HPP_
+
+#include "thread_pool.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#include <system_error>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef BST_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace rdf {
+
+struct batch_read_options
+{
+  typedef std::function<void(std::string const& file_name, std::string const& message)> error_handler;
+
+  batch_read_options()
+    : batch_size(64), max_pending(256), use_io_uring(true)
+  {}
+
+  std::size_t batch_size;   // files opened and read together
+  std::size_t max_pending;  // buffers allowed to wait for a worker
+  bool use_io_uring;        // set to false to force the pread fallback
+  error_handler on_error;   // told of files that cannot be read, if set
+};
+
+namespace {
+
+struct file_buffer
+{
+  std::string name;
+  std::vector<unsigned char> data;
+  std::string error;  // why the file could not be read, if it could not
+};
+
+inline std::string batch_errno_message(std::string const& what, std::string const& file_name, int err)
+{
+  return what + " '" + file_name + "': " + std::generic_category().message(err);
+}
+
+//----------------------------------------------------------------------
+// The plain way: open, fstat, pread until done, close.
+//----------------------------------------------------------------------
+inline void pread_whole_file(file_buffer& file)
+{
+  int fd = ::open(file.name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::domain_error(batch_errno_message("Failed to open file", file.name, errno));
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+  {
+    int err = errno;
+    ::close(fd);
+    throw std::domain_error(batch_errno_message("Failed to stat file", file.name, err));
+  }
+
+  file.data.resize(static_cast<std::size_t>(st.st_size));
+  std::size_t done = 0;
+  while (done < file.data.size())
+  {
+    ssize_t n = ::pread(fd, &file.data[done], file.data.size() - done, done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+    {
+      int err = errno;
+      ::close(fd);
+      throw std::domain_error(batch_errno_message("Failed to read file", file.name, err));
+    }
+    if (n == 0)
+      break;
+    done += static_cast<std::size_t>(n);
+  }
+  file.data.resize(done);
+  ::close(fd);
+}
+
+#ifdef BST_HAVE_LIBURING
+
+//----------------------------------------------------------------------
+// Reads batches of files through an io_uring. Every batch goes through
+// three rounds: open + statx, read (repeated for short reads), close.
+// Each round is submitted and reaped with a single system call.
+//----------------------------------------------------------------------
+class uring_batch_reader
+{
+  enum op_kind { op_open, op_statx, op_read, op_close };
+
+  struct slot
+  {
+    file_buffer* file;
+    int fd;
+    int error;
+    std::size_t done;
+    struct statx stx;
+  };
+
+public:
+  explicit uring_batch_reader(std::size_t batch_size)
+    : batch_size_(batch_size), ok_(false)
+  {
+    ok_ = (io_uring_queue_init(static_cast<unsigned>(2 * batch_size_), &ring_, 0) == 0);
+  }
+
+  ~uring_batch_reader()
+  {
+    if (ok_)
+      io_uring_queue_exit(&ring_);
+  }
+
+  bool ok() const { return ok_; }
+
+  //----------------------------------------------------------------------
+  // Read every file in the batch into its buffer. At most batch_size
+  // files may be passed at once. A file that cannot be read gets an
+  // error message instead; only a failure of the ring itself throws.
+  //----------------------------------------------------------------------
+  void read(std::vector<std::unique_ptr<file_buffer>>& files)
+  {
+    std::vector<slot> slots(files.size());
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+      slots[i].file = files[i].get();
+      slots[i].fd = -1;
+      slots[i].error = 0;
+      slots[i].done = 0;
+    }
+
+    // Round one: open the files and ask for their sizes.
+    for (std::size_t i = 0; i < slots.size(); ++i)
+    {
+      char const* path = slots[i].file->name.c_str();
+      prep(op_open, i, [&](io_uring_sqe* sqe) {
+          io_uring_prep_openat(sqe, AT_FDCWD, path, O_RDONLY | O_CLOEXEC, 0);
+        });
+      prep(op_statx, i, [&](io_uring_sqe* sqe) {
+          io_uring_prep_statx(sqe, AT_FDCWD, path, 0, STATX_SIZE, &slots[i].stx);
+        });
+    }
+    complete(2 * slots.size(), slots);
+
+    // Round two: read everything, resubmitting short reads.
+    std::size_t in_flight = 0;
+    for (std::size_t i = 0; i < slots.size(); ++i)
+    {
+      if (slots[i].fd < 0 || slots[i].error != 0)
+        continue;
+      slots[i].file->data.resize(static_cast<std::size_t>(slots[i].stx.stx_size));
+      if (!slots[i].file->data.empty())
+      {
+        prep_read(i, slots[i]);
+        ++in_flight;
+      }
+    }
+    while (in_flight != 0)
+      in_flight = complete(in_flight, slots);
+
+    // Round three: close what was opened.
+    std::size_t opened = 0;
+    for (std::size_t i = 0; i < slots.size(); ++i)
+    {
+      if (slots[i].fd < 0)
+        continue;
+      int fd = slots[i].fd;
+      prep(op_close, i, [&](io_uring_sqe* sqe) { io_uring_prep_close(sqe, fd); });
+      ++opened;
+    }
+    complete(opened, slots);
+
+    for (auto& s : slots)
+      if (s.error != 0)
+      {
+        s.file->data.clear();
+        s.file->error = batch_errno_message("Failed to read file", s.file->name, s.error);
+      }
+  }
+
+private:
+  uring_batch_reader(uring_batch_reader const&);
+  uring_batch_reader& operator=(uring_batch_reader const&);
+
+  //----------------------------------------------------------------------
+  // The operation kind and slot index are packed into the user data.
+  //----------------------------------------------------------------------
+  template <typename Prep>
+  void prep(op_kind kind, std::size_t index, Prep p)
+  {
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    if (sqe == NULL)
+    {
+      // The submission queue is full: hand what is there to the kernel.
+      io_uring_submit(&ring_);
+      sqe = io_uring_get_sqe(&ring_);
+      if (sqe == NULL)
+        throw std::domain_error("io_uring submission queue is full");
+    }
+    p(sqe);
+    io_uring_sqe_set_data64(sqe, (static_cast<__u64>(index) << 2) | kind);
+  }
+
+  // A read's length is 32 bits, so large files are read a gigabyte at a
+  // time; short reads are resubmitted anyway.
+  void prep_read(std::size_t index, slot& s)
+  {
+    std::size_t size = std::min<std::size_t>(s.file->data.size() - s.done, 1u << 30);
+    prep(op_read, index, [&](io_uring_sqe* sqe) {
+        io_uring_prep_read(sqe, s.fd, s.file->data.data() + s.done,
+                           static_cast<unsigned>(size), s.done);
+      });
+  }
+
+  //----------------------------------------------------------------------
+  // Submit what has been prepared, wait for n completions and process
+  // them. Returns the number of reads that had to be resubmitted.
+  //----------------------------------------------------------------------
+  std::size_t complete(std::size_t n, std::vector<slot>& slots)
+  {
+    if (n == 0)
+      return 0;
+
+    int rc = io_uring_submit_and_wait(&ring_, static_cast<unsigned>(n));
+    if (rc < 0)
+      throw std::domain_error("io_uring submission failed: " + std::generic_category().message(-rc));
+
+    std::size_t resubmitted = 0;
+    for (std::size_t k = 0; k < n; ++k)
+    {
+      io_uring_cqe* cqe = NULL;
+      rc = io_uring_wait_cqe(&ring_, &cqe);
+      if (rc < 0)
+        throw std::domain_error("io_uring completion failed: " + std::generic_category().message(-rc));
+
+      __u64 data = io_uring_cqe_get_data64(cqe);
+      int res = cqe->res;
+      io_uring_cqe_seen(&ring_, cqe);
+
+      slot& s = slots[static_cast<std::size_t>(data >> 2)];
+      switch (static_cast<op_kind>(data & 3))
+      {
+      case op_open:
+        if (res >= 0) s.fd = res; else s.error = -res;
+        break;
+      case op_statx:
+        if (res < 0 && s.error == 0) s.error = -res;
+        break;
+      case op_read:
+        if (res < 0)
+          s.error = -res;
+        else if (res == 0)
+          s.file->data.resize(s.done);          // the file shrank under us
+        else if ((s.done += static_cast<std::size_t>(res)) < s.file->data.size())
+        {
+          prep_read(static_cast<std::size_t>(data >> 2), s);
+          ++resubmitted;
+        }
+        break;
+      case op_close:
+        break;
+      }
+    }
+    return resubmitted;
+  }
+
+  std::size_t batch_size_;
+  bool ok_;
+  io_uring ring_;
+};
+
+#endif // BST_HAVE_LIBURING
+
+//----------------------------------------------------------------------
+// A file that could not be read: handed to the error handler if there is
+// one, thrown from the file's task otherwise.
+//----------------------------------------------------------------------
+inline void report_unreadable(batch_read_options::error_handler const& on_error,
+                              std::string const& file_name, std::string const& message)
+{
+  if (!on_error)
+    throw std::domain_error(message);
+  on_error(file_name, message);
+}
+
+//----------------------------------------------------------------------
+// The body of read_files( ): queue a task per file, reading the files in
+// batches through io_uring when possible and in the tasks otherwise.
+//----------------------------------------------------------------------
+template <typename InputIter, typename Func>
+void submit_reads(
+  InputIter first, InputIter last, thread_pool& workers, Func f,
+  batch_read_options const& opts)
+{
+  std::shared_ptr<Func> func = std::make_shared<Func>(std::move(f));
+  batch_read_options::error_handler on_error = opts.on_error;
+
+#ifdef BST_HAVE_LIBURING
+  if (opts.use_io_uring)
+  {
+    std::size_t batch_size = opts.batch_size == 0 ? 1 : opts.batch_size;
+    uring_batch_reader ring(batch_size);
+    if (ring.ok())
+    {
+      while (first != last)
+      {
+        std::vector<std::unique_ptr<file_buffer>> batch;
+        for (; first != last && batch.size() < batch_size; ++first)
+        {
+          batch.push_back(std::unique_ptr<file_buffer>(new file_buffer()));
+          batch.back()->name = *first;
+        }
+
+        ring.read(batch);
+
+        for (auto& file : batch)
+        {
+          std::shared_ptr<file_buffer> buf(std::move(file));
+          workers.submit([func, on_error, buf]() {
+              if (!buf->error.empty())
+                report_unreadable(on_error, buf->name, buf->error);
+              else
+                (*func)(buf->name, buf->data.data(), buf->data.size());
+            });
+        }
+
+        // Don't let the reader get too far ahead of the parsers.
+        workers.wait(opts.max_pending);
+      }
+      return;
+    }
+  }
+#endif
+
+  for (; first != last; ++first)
+  {
+    std::string name = *first;
+    workers.submit([func, on_error, name]() {
+        file_buffer file;
+        file.name = name;
+        try
+        {
+          pread_whole_file(file);
+        }
+        catch (std::domain_error const& e)
+        {
+          report_unreadable(on_error, name, e.what());
+          return;
+        }
+        (*func)(file.name, file.data.data(), file.data.size());
+      });
+    workers.wait(opts.max_pending);
+  }
+}
+
+} // namespace
+
+//===========================================================================
+// Read every file named in [first, last) and call
+//
+//   f(std::string const& file_name, unsigned char const* data, std::size_t size)
+//
+// for each one on one of the pool's threads. f must therefore be safe to
+// call concurrently. A file that cannot be read does not stop the others:
+// it goes to opts.on_error, which is called on the pool's threads too, or
+// without one it is an error like any other. Returns once every call has
+// finished, even when something fails; the first exception thrown by the
+// I/O or by f is then rethrown.
+//
+// This waits on the whole pool, so the pool should not have other work
+// in it meanwhile (see thread_pool).
+//===========================================================================
+template <typename InputIter, typename Func>
+void read_files(
+  InputIter first, InputIter last, thread_pool& workers, Func f,
+  batch_read_options const& opts = batch_read_options())
+{
+  try
+  {
+    submit_reads(first, last, workers, std::move(f), opts);
+  }
+  catch (...)
+  {
+    // Tasks already queued may refer to the caller's state: let them
+    // finish before the exception leaves.
+    std::exception_ptr error = std::current_exception();
+    try
+    {
+      workers.wait();
+    }
+    catch (...)
+    {}
+    std::rethrow_exception(error);
+  }
+  workers.wait();
+}
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,861 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file adds support for block-compressed dumps. A plain gzip file
+// can only be inflated from the front, on one thread, which leaves the
+// parallel N-Triples parser waiting on it. BGZF (the blocked gzip of
+// bgzip and htslib) and seekable zstd are made of small independent
+// blocks with an index of where each starts, so a file can be split into
+// segments that are decompressed and parsed on every core at once.
+//
+// block_compressed_file reads the index of either format and inflates
+// blocks on demand; read_block_compressed( ) and parse_block_compressed( )
+// run whole files through a thread_pool; block_compressed_writer produces
+// such files. Seekable zstd needs libzstd and BST_HAVE_ZSTD; BGZF only
+// needs zlib.
+//===========================================================================
+
+#ifndef BST_BLOCK_COMPRESSION_HPP_
+#define BST_BLOCK_COMPRESSION_HPP_
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <system_error>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#ifdef BST_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace rdf {
+
+enum block_format
+{
+  bgzf_format,
+  seekable_zstd_format
+};
+
+//===========================================================================
+// Where one block is in the file, and where its contents go in the
+// uncompressed stream.
+//===========================================================================
+struct compressed_block
+{
+  std::uint64_t offset;
+  std::uint32_t size;
+  std::uint64_t data_offset;
+  std::uint32_t data_size;
+};
+
+namespace {
+
+inline std::uint16_t get_le16(unsigned char const* p)
+{
+  return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline std::uint32_t get_le32(unsigned char const* p)
+{
+  return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8)
+    | (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+inline std::uint64_t get_le64(unsigned char const* p)
+{
+  return get_le32(p) | (static_cast<std::uint64_t>(get_le32(p + 4)) << 32);
+}
+
+inline void put_le16(unsigned char* p, std::uint16_t v)
+{
+  p[0] = static_cast<unsigned char>(v);
+  p[1] = static_cast<unsigned char>(v >> 8);
+}
+
+inline void put_le32(unsigned char* p, std::uint32_t v)
+{
+  put_le16(p, static_cast<std::uint16_t>(v));
+  put_le16(p + 2, static_cast<std::uint16_t>(v >> 16));
+}
+
+inline void put_le64(unsigned char* p, std::uint64_t v)
+{
+  put_le32(p, static_cast<std::uint32_t>(v));
+  put_le32(p + 4, static_cast<std::uint32_t>(v >> 32));
+}
+
+inline std::string block_io_error(std::string const& what, std::string const& file_name)
+{
+  return what + " '" + file_name + "': " + std::generic_category().message(errno);
+}
+
+//----------------------------------------------------------------------
+// pread the whole range or throw; returns false at the end of the file.
+//----------------------------------------------------------------------
+inline bool pread_fully(int fd, unsigned char* buf, std::size_t size, std::uint64_t offset,
+                        std::string const& file_name)
+{
+  while (size != 0)
+  {
+    ssize_t n = ::pread(fd, buf, size, static_cast<off_t>(offset));
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      throw std::domain_error(block_io_error("Failed to read file", file_name));
+    }
+    if (n == 0)
+      return false;
+    buf += n;
+    size -= static_cast<std::size_t>(n);
+    offset += static_cast<std::uint64_t>(n);
+  }
+  return true;
+}
+
+inline void write_fully(int fd, unsigned char const* buf, std::size_t size,
+                        std::string const& file_name)
+{
+  while (size != 0)
+  {
+    ssize_t n = ::write(fd, buf, size);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      throw std::domain_error(block_io_error("Failed to write file", file_name));
+    }
+    buf += n;
+    size -= static_cast<std::size_t>(n);
+  }
+}
+
+//----------------------------------------------------------------------
+// The fixed parts of the formats.
+//----------------------------------------------------------------------
+const std::size_t bgzf_header_size = 18;
+const std::size_t bgzf_max_block_size = 0x10000;
+const std::size_t bgzf_max_data_size = 0xff00;
+
+const unsigned char bgzf_eof_block[28] = {
+  0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43,
+  0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+const std::uint32_t zstd_frame_magic = 0xFD2FB528u;
+const std::uint32_t zstd_skippable_magic = 0x184D2A5Eu;
+const std::uint32_t zstd_seekable_magic = 0x8F92EAB1u;
+const std::size_t zstd_seek_footer_size = 9;
+
+//----------------------------------------------------------------------
+// Whether a block header is BGZF's: a gzip member with the BC extra
+// subfield. Returns the total size of the block, or 0.
+//----------------------------------------------------------------------
+inline std::size_t bgzf_block_size(unsigned char const* h)
+{
+  if (h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || (h[3] & 4) == 0)
+    return 0;
+  if (get_le16(h + 10) != 6 || h[12] != 'B' || h[13] != 'C' || get_le16(h + 14) != 2)
+    return 0;
+  return static_cast<std::size_t>(get_le16(h + 16)) + 1;
+}
+
+} // namespace
+
+//===========================================================================
+// A block-compressed file open for reading. The constructor reads the
+// index, from a bgzip .gzi file next to a BGZF file if there is one and
+// otherwise by walking the block headers, and throws std::domain_error if
+// the file is in neither format. Reading blocks is thread-safe.
+//===========================================================================
+class block_compressed_file
+{
+public:
+  explicit block_compressed_file(std::string const& file_name)
+    : file_name_(file_name), fd_(::open(file_name.c_str(), O_RDONLY | O_CLOEXEC))
+  {
+    if (fd_ < 0)
+      throw std::domain_error(block_io_error("Failed to open file", file_name));
+
+    try
+    {
+      struct stat st;
+      if (::fstat(fd_, &st) != 0)
+        throw std::domain_error(block_io_error("Failed to stat file", file_name));
+      file_size_ = static_cast<std::uint64_t>(st.st_size);
+
+      unsigned char head[bgzf_header_size] = { 0 };
+      pread_fully(fd_, head, std::min<std::uint64_t>(sizeof(head), file_size_), 0, file_name_);
+
+      if (bgzf_block_size(head) != 0)
+      {
+        format_ = bgzf_format;
+        if (!load_gzi(file_name + ".gzi"))
+          scan_bgzf();
+      }
+      else if (get_le32(head) == zstd_frame_magic)
+      {
+        format_ = seekable_zstd_format;
+        read_seek_table();
+      }
+      else
+        throw std::domain_error("Not a BGZF or seekable zstd file '" + file_name + "'");
+    }
+    catch (...)
+    {
+      ::close(fd_);
+      throw;
+    }
+  }
+
+  ~block_compressed_file()
+  {
+    ::close(fd_);
+  }
+
+  std::string const& file_name() const { return file_name_; }
+  block_format format() const { return format_; }
+  std::vector<compressed_block> const& blocks() const { return blocks_; }
+
+  std::uint64_t data_size() const
+  {
+    return blocks_.empty() ? 0 : blocks_.back().data_offset + blocks_.back().data_size;
+  }
+
+  //----------------------------------------------------------------------
+  // The block holding a byte of the uncompressed stream.
+  //----------------------------------------------------------------------
+  std::size_t find_block(std::uint64_t data_offset) const
+  {
+    std::vector<compressed_block>::const_iterator i = std::upper_bound(
+      blocks_.begin(), blocks_.end(), data_offset,
+      [](std::uint64_t offset, compressed_block const& b) { return offset < b.data_offset; });
+    return i == blocks_.begin() ? 0 : static_cast<std::size_t>(i - blocks_.begin() - 1);
+  }
+
+  //----------------------------------------------------------------------
+  // Decompress block i, appending its contents to out. Throws
+  // std::domain_error for corrupt blocks.
+  //----------------------------------------------------------------------
+  void read_block(std::size_t i, std::vector<unsigned char>& out) const
+  {
+    compressed_block const& b = blocks_[i];
+    std::vector<unsigned char> packed(b.size);
+    if (!pread_fully(fd_, packed.data(), b.size, b.offset, file_name_))
+      throw std::domain_error("Truncated block in '" + file_name_ + "'");
+
+    // A stale .gzi can point anywhere: the header has to agree with the
+    // index before its sizes are trusted.
+    if (format_ == bgzf_format
+        && (b.size < bgzf_header_size || bgzf_block_size(packed.data()) != b.size))
+      throw std::domain_error("Corrupt BGZF block in '" + file_name_ + "'");
+
+    std::size_t at = out.size();
+    out.resize(at + b.data_size);
+    if (format_ == bgzf_format)
+      inflate_bgzf(packed.data(), b.size, out.data() + at, b.data_size);
+    else
+      inflate_zstd(packed.data(), b.size, out.data() + at, b.data_size);
+  }
+
+  //----------------------------------------------------------------------
+  // Write the index in bgzip's .gzi layout: the number of entries, then
+  // the compressed and uncompressed offset of every block but the first,
+  // all as little-endian 64-bit integers.
+  //----------------------------------------------------------------------
+  void save_gzi(std::string const& file_name) const
+  {
+    save_gzi(blocks_, file_name);
+  }
+
+  static void save_gzi(std::vector<compressed_block> const& blocks, std::string const& file_name)
+  {
+    std::size_t entries = blocks.empty() ? 0 : blocks.size() - 1;
+    std::vector<unsigned char> gzi(8 + 16 * entries);
+    put_le64(gzi.data(), entries);
+    for (std::size_t i = 0; i < entries; ++i)
+    {
+      put_le64(gzi.data() + 8 + 16 * i, blocks[i + 1].offset);
+      put_le64(gzi.data() + 16 + 16 * i, blocks[i + 1].data_offset);
+    }
+
+    int fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+      throw std::domain_error(block_io_error("Failed to create file", file_name));
+    try
+    {
+      write_fully(fd, gzi.data(), gzi.size(), file_name);
+    }
+    catch (...)
+    {
+      ::close(fd);
+      throw;
+    }
+    ::close(fd);
+  }
+
+private:
+  block_compressed_file(block_compressed_file const&);
+  block_compressed_file& operator=(block_compressed_file const&);
+
+  //----------------------------------------------------------------------
+  // Walk the chain of BGZF headers, a megabyte of the file at a time.
+  // The size of a block's contents is in its last four bytes.
+  //----------------------------------------------------------------------
+  void scan_bgzf()
+  {
+    const std::size_t window_size = 1 << 20;
+    std::vector<unsigned char> window(window_size);
+    std::uint64_t window_offset = 0;
+    std::size_t window_fill = 0;
+
+    std::uint64_t offset = 0;
+    std::uint64_t data_offset = 0;
+    while (offset < file_size_)
+    {
+      if (offset + bgzf_max_block_size > window_offset + window_fill)
+      {
+        window_offset = offset;
+        window_fill = static_cast<std::size_t>(std::min<std::uint64_t>(window_size, file_size_ - offset));
+        pread_fully(fd_, window.data(), window_fill, window_offset, file_name_);
+      }
+
+      unsigned char const* h = window.data() + (offset - window_offset);
+      std::size_t available = window_fill - static_cast<std::size_t>(offset - window_offset);
+      std::size_t size = available < bgzf_header_size ? 0 : bgzf_block_size(h);
+      if (size < bgzf_header_size + 8 || size > available)
+        throw std::domain_error("Bad BGZF block in '" + file_name_ + "'");
+
+      compressed_block b = {
+        offset, static_cast<std::uint32_t>(size), data_offset, get_le32(h + size - 4)
+      };
+      if (b.data_size != 0)
+        blocks_.push_back(b);
+      offset += size;
+      data_offset += b.data_size;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // Read the blocks from a .gzi file. Returns false, leaving no blocks,
+  // if there is none or it cannot describe this file, in which case the
+  // blocks are found by scanning instead.
+  //----------------------------------------------------------------------
+  bool load_gzi(std::string const& gzi_name)
+  {
+    int fd = ::open(gzi_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+
+    std::vector<unsigned char> gzi;
+    struct stat st;
+    bool ok = ::fstat(fd, &st) == 0 && st.st_size >= 8;
+    if (ok)
+    {
+      gzi.resize(static_cast<std::size_t>(st.st_size));
+      ok = pread_fully(fd, gzi.data(), gzi.size(), 0, gzi_name);
+    }
+    ::close(fd);
+    if (!ok || get_le64(gzi.data()) > gzi.size() / 16
+        || gzi.size() != 8 + 16 * get_le64(gzi.data()))
+      return false;
+
+    // The index has offsets only; sizes follow from the next entry, and
+    // the last block's from its own trailer.
+    std::size_t entries = static_cast<std::size_t>(get_le64(gzi.data()));
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> starts(1, std::make_pair(0, 0));
+    for (std::size_t i = 0; i < entries; ++i)
+      starts.push_back(std::make_pair(get_le64(gzi.data() + 8 + 16 * i),
+                                      get_le64(gzi.data() + 16 + 16 * i)));
+
+    std::vector<compressed_block> blocks;
+    for (std::size_t i = 0; i < starts.size(); ++i)
+    {
+      compressed_block b;
+      b.offset = starts[i].first;
+      b.data_offset = starts[i].second;
+      if (b.offset >= file_size_)
+        return false;
+      if (i + 1 < starts.size())
+      {
+        if (starts[i + 1].first <= b.offset || starts[i + 1].second < b.data_offset
+            || starts[i + 1].first - b.offset > bgzf_max_block_size
+            || starts[i + 1].second - b.data_offset > bgzf_max_block_size)
+          return false;
+        b.size = static_cast<std::uint32_t>(starts[i + 1].first - b.offset);
+        b.data_size = static_cast<std::uint32_t>(starts[i + 1].second - b.data_offset);
+      }
+      else
+      {
+        unsigned char h[bgzf_header_size];
+        if (!pread_fully(fd_, h, sizeof(h), b.offset, file_name_) || bgzf_block_size(h) == 0)
+          return false;
+        b.size = static_cast<std::uint32_t>(bgzf_block_size(h));
+        unsigned char trailer[4];
+        if (!pread_fully(fd_, trailer, 4, b.offset + b.size - 4, file_name_))
+          return false;
+        b.data_size = get_le32(trailer);
+        if (b.data_size > bgzf_max_block_size)
+          return false;
+      }
+      if (b.data_size != 0)
+        blocks.push_back(b);
+    }
+    blocks_.swap(blocks);
+    return true;
+  }
+
+  //----------------------------------------------------------------------
+  // The seek table is a skippable frame at the end of the file: an entry
+  // of compressed and uncompressed size per frame, optionally with a
+  // checksum, and a footer with the frame count, a descriptor byte and
+  // the seekable magic number.
+  //----------------------------------------------------------------------
+  void read_seek_table()
+  {
+    unsigned char footer[zstd_seek_footer_size];
+    if (file_size_ < zstd_seek_footer_size + 8
+        || !pread_fully(fd_, footer, sizeof(footer), file_size_ - sizeof(footer), file_name_)
+        || get_le32(footer + 5) != zstd_seekable_magic)
+      throw std::domain_error("No seek table in zstd file '" + file_name_ + "'");
+
+    std::size_t frames = get_le32(footer);
+    std::size_t entry_size = (footer[4] & 0x80) ? 12 : 8;
+    std::uint64_t table_size = 8 + frames * entry_size + zstd_seek_footer_size;
+    if (table_size > file_size_)
+      throw std::domain_error("Bad seek table in '" + file_name_ + "'");
+
+    std::vector<unsigned char> table(static_cast<std::size_t>(table_size));
+    pread_fully(fd_, table.data(), table.size(), file_size_ - table_size, file_name_);
+    if (get_le32(table.data()) != zstd_skippable_magic)
+      throw std::domain_error("Bad seek table in '" + file_name_ + "'");
+
+    std::uint64_t offset = 0;
+    std::uint64_t data_offset = 0;
+    for (std::size_t i = 0; i < frames; ++i)
+    {
+      unsigned char const* e = table.data() + 8 + i * entry_size;
+      compressed_block b = { offset, get_le32(e), data_offset, get_le32(e + 4) };
+      if (b.data_size != 0)
+        blocks_.push_back(b);
+      offset += b.size;
+      data_offset += b.data_size;
+    }
+    if (offset + table_size != file_size_)
+      throw std::domain_error("Bad seek table in '" + file_name_ + "'");
+  }
+
+  void inflate_bgzf(unsigned char const* in, std::size_t size,
+                    unsigned char* out, std::size_t out_size) const
+  {
+    std::size_t header = 12 + get_le16(in + 10);
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, -15) != Z_OK)
+      throw std::bad_alloc();
+
+    z.next_in = const_cast<unsigned char*>(in + header);
+    z.avail_in = static_cast<uInt>(size - header - 8);
+    z.next_out = out;
+    z.avail_out = static_cast<uInt>(out_size);
+    int rc = inflate(&z, Z_FINISH);
+    inflateEnd(&z);
+
+    if (rc != Z_STREAM_END || z.avail_out != 0
+        || crc32(0, out, static_cast<uInt>(out_size)) != get_le32(in + size - 8))
+      throw std::domain_error("Corrupt BGZF block in '" + file_name_ + "'");
+  }
+
+  void inflate_zstd(unsigned char const* in, std::size_t size,
+                    unsigned char* out, std::size_t out_size) const
+  {
+#ifdef BST_HAVE_ZSTD
+    std::size_t n = ZSTD_decompress(out, out_size, in, size);
+    if (ZSTD_isError(n) || n != out_size)
+      throw std::domain_error("Corrupt zstd frame in '" + file_name_ + "'");
+#else
+    (void)in; (void)size; (void)out; (void)out_size;
+    throw std::domain_error("Built without zstd support, cannot read '" + file_name_ + "'");
+#endif
+  }
+
+  std::string file_name_;
+  int fd_;
+  std::uint64_t file_size_;
+  block_format format_;
+  std::vector<compressed_block> blocks_;
+};
+
+//===========================================================================
+// Tuning knobs for reading block-compressed files in parallel.
+//===========================================================================
+struct block_read_options
+{
+  block_read_options()
+    : segment_size(8 << 20), max_pending(0)
+  {}
+
+  std::size_t segment_size;  // uncompressed bytes per task
+  std::size_t max_pending;   // segments in flight; 0 for twice the workers
+};
+
+//===========================================================================
+// Decompress a block-compressed text file on a pool of worker threads,
+// handing it to
+//
+//   f(data, size, data_offset)
+//
+// in segments of whole lines, concurrently and in no particular order.
+// data_offset is where the segment starts in the uncompressed stream.
+// Each segment starts after the first newline at or past its first block
+// and runs to the first newline at or past the start of the next, so
+// every line is seen exactly once however the blocks cut them. Errors,
+// from decompression or from f, are rethrown once every task is done.
+//===========================================================================
+template <typename Func>
+void read_block_compressed(
+  std::string const& file_name, thread_pool& workers, Func f,
+  block_read_options const& opts = block_read_options())
+{
+  std::shared_ptr<block_compressed_file> file = std::make_shared<block_compressed_file>(file_name);
+  std::vector<compressed_block> const& blocks = file->blocks();
+
+  std::size_t max_pending = opts.max_pending != 0 ? opts.max_pending : 2 * workers.size();
+  std::size_t first = 0;
+  while (first < blocks.size())
+  {
+    std::size_t last = first;
+    std::uint64_t size = 0;
+    while (last < blocks.size() && (last == first || size < opts.segment_size))
+      size += blocks[last++].data_size;
+
+    workers.submit([file, first, last, f]() {
+        std::vector<compressed_block> const& blocks = file->blocks();
+        std::vector<unsigned char> data;
+        for (std::size_t i = first; i < last; ++i)
+          file->read_block(i, data);
+
+        std::size_t begin = 0;
+        if (first != 0)
+        {
+          unsigned char const* nl = static_cast<unsigned char const*>(
+            std::memchr(data.data(), '\n', data.size()));
+          // No line starts in these blocks: the segment that holds the
+          // start of the line reads on through them.
+          if (nl == NULL)
+            return;
+          begin = nl - data.data() + 1;
+        }
+
+        // Finish the last line from the blocks that follow.
+        std::size_t end = data.size();
+        for (std::size_t next = last; next < blocks.size(); ++next)
+        {
+          std::size_t at = data.size();
+          file->read_block(next, data);
+          unsigned char const* nl = static_cast<unsigned char const*>(
+            std::memchr(data.data() + at, '\n', data.size() - at));
+          if (nl != NULL)
+          {
+            end = nl - data.data() + 1;
+            break;
+          }
+          end = data.size();
+        }
+
+        if (begin < end)
+          f(static_cast<unsigned char const*>(data.data() + begin), end - begin,
+            blocks[first].data_offset + begin);
+      });
+
+    workers.wait(max_pending);
+    first = last;
+  }
+  workers.wait();
+}
+
+//===========================================================================
+// Parse a block-compressed N-Triples or N-Quads file in parallel. Any
+// line-oriented parser with ntriples_parser's parse_buffer( ) will do.
+// The visitor is called as
+//
+//   visitor(file_name, first_triple, last_triple)
+//
+// once per segment, concurrently, as with parse_files( ). Returns the
+// number of segments the parser reported errors for.
+//===========================================================================
+template <typename Parser, typename Visitor, typename Converter>
+std::size_t parse_block_compressed(
+  Parser const& parser, std::string const& file_name,
+  thread_pool& workers, Visitor visitor, Converter conv,
+  block_read_options const& opts = block_read_options())
+{
+  typedef typename Converter::result_type triple_type;
+  std::atomic<std::size_t> bad_segments(0);
+
+  read_block_compressed(file_name, workers,
+    [&parser, &bad_segments, &file_name, visitor, conv](
+      unsigned char const* data, std::size_t size, std::uint64_t)
+    {
+      std::vector<triple_type> triples;
+      if (!parser.parse_buffer(file_name, data, size, std::back_inserter(triples), conv))
+        ++bad_segments;
+      visitor(file_name, std::begin(triples), std::end(triples));
+    },
+    opts);
+
+  return bad_segments;
+}
+
+//===========================================================================
+// Writes a block-compressed file. Data is cut into blocks of at most
+// block_size bytes (BGZF caps this at 65280); with a thread_pool, batches
+// of blocks are compressed in parallel and written in order. finish( )
+// writes BGZF's end-of-file block or the zstd seek table, and must be
+// called for the file to be complete; the destructor does not.
+//===========================================================================
+class block_compressed_writer
+{
+public:
+  block_compressed_writer(
+    std::string const& file_name, block_format format,
+    int level = -1, thread_pool* workers = NULL, std::size_t block_size = 0)
+    : file_name_(file_name), format_(format), level_(level), workers_(workers),
+      block_size_(block_size), offset_(0), data_offset_(0), finished_(false)
+  {
+    if (format_ == bgzf_format)
+    {
+      if (block_size_ == 0 || block_size_ > bgzf_max_data_size)
+        block_size_ = bgzf_max_data_size;
+      if (level_ < 0)
+        level_ = Z_DEFAULT_COMPRESSION;
+    }
+    else
+    {
+#ifndef BST_HAVE_ZSTD
+      throw std::domain_error("Built without zstd support, cannot write '" + file_name + "'");
+#endif
+      if (block_size_ == 0)
+        block_size_ = 1 << 20;
+      if (level_ < 0)
+        level_ = 3;
+    }
+
+    fd_ = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+      throw std::domain_error(block_io_error("Failed to create file", file_name));
+    current_.reserve(block_size_);
+  }
+
+  ~block_compressed_writer()
+  {
+    ::close(fd_);
+  }
+
+  void write(void const* data, std::size_t size)
+  {
+    unsigned char const* p = static_cast<unsigned char const*>(data);
+    while (size != 0)
+    {
+      std::size_t n = std::min(size, block_size_ - current_.size());
+      current_.insert(current_.end(), p, p + n);
+      p += n;
+      size -= n;
+      if (current_.size() == block_size_)
+        end_block();
+    }
+  }
+
+  void finish()
+  {
+    if (finished_)
+      return;
+    if (!current_.empty())
+      end_block();
+    flush();
+
+    if (format_ == bgzf_format)
+      write_fully(fd_, bgzf_eof_block, sizeof(bgzf_eof_block), file_name_);
+    else
+    {
+      std::vector<unsigned char> table(8 + 8 * blocks_.size() + zstd_seek_footer_size);
+      put_le32(table.data(), zstd_skippable_magic);
+      put_le32(table.data() + 4, static_cast<std::uint32_t>(table.size() - 8));
+      for (std::size_t i = 0; i < blocks_.size(); ++i)
+      {
+        put_le32(table.data() + 8 + 8 * i, blocks_[i].size);
+        put_le32(table.data() + 12 + 8 * i, blocks_[i].data_size);
+      }
+      unsigned char* footer = table.data() + table.size() - zstd_seek_footer_size;
+      put_le32(footer, static_cast<std::uint32_t>(blocks_.size()));
+      footer[4] = 0;
+      put_le32(footer + 5, zstd_seekable_magic);
+      write_fully(fd_, table.data(), table.size(), file_name_);
+    }
+
+    if (::fsync(fd_) != 0 && errno != EINVAL)
+      throw std::domain_error(block_io_error("Failed to write file", file_name_));
+    finished_ = true;
+  }
+
+  //----------------------------------------------------------------------
+  // The blocks written so far, for block_compressed_file::save_gzi( ).
+  //----------------------------------------------------------------------
+  std::vector<compressed_block> const& blocks() const { return blocks_; }
+
+private:
+  block_compressed_writer(block_compressed_writer const&);
+  block_compressed_writer& operator=(block_compressed_writer const&);
+
+  struct pending_block
+  {
+    std::vector<unsigned char> data;
+    std::vector<unsigned char> packed;
+  };
+
+  void end_block()
+  {
+    pending_.push_back(pending_block());
+    pending_.back().data.swap(current_);
+    current_.reserve(block_size_);
+
+    std::size_t batch = workers_ != NULL ? 4 * workers_->size() : 1;
+    if (pending_.size() >= batch)
+      flush();
+  }
+
+  void flush()
+  {
+    if (workers_ != NULL && pending_.size() > 1)
+    {
+      for (std::size_t i = 0; i < pending_.size(); ++i)
+      {
+        pending_block* b = &pending_[i];
+        workers_->submit([this, b]() { compress(*b); });
+      }
+      workers_->wait();
+    }
+    else
+    {
+      for (std::size_t i = 0; i < pending_.size(); ++i)
+        compress(pending_[i]);
+    }
+
+    for (std::size_t i = 0; i < pending_.size(); ++i)
+    {
+      pending_block const& b = pending_[i];
+      write_fully(fd_, b.packed.data(), b.packed.size(), file_name_);
+      compressed_block entry = {
+        offset_, static_cast<std::uint32_t>(b.packed.size()),
+        data_offset_, static_cast<std::uint32_t>(b.data.size())
+      };
+      blocks_.push_back(entry);
+      offset_ += b.packed.size();
+      data_offset_ += b.data.size();
+    }
+    pending_.clear();
+  }
+
+  void compress(pending_block& b) const
+  {
+    if (format_ == bgzf_format)
+    {
+      // Data that will not shrink below a block is stored instead.
+      if (!deflate_bgzf(b, level_))
+        deflate_bgzf(b, 0);
+    }
+    else
+      compress_zstd(b);
+  }
+
+  static bool deflate_bgzf(pending_block& b, int level)
+  {
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::bad_alloc();
+
+    b.packed.resize(bgzf_max_block_size);
+    z.next_in = b.data.data();
+    z.avail_in = static_cast<uInt>(b.data.size());
+    z.next_out = b.packed.data() + bgzf_header_size;
+    z.avail_out = static_cast<uInt>(bgzf_max_block_size - bgzf_header_size - 8);
+    int rc = deflate(&z, Z_FINISH);
+    std::size_t size = bgzf_header_size + z.total_out + 8;
+    deflateEnd(&z);
+    if (rc != Z_STREAM_END)
+      return false;
+
+    unsigned char* h = b.packed.data();
+    std::memcpy(h, bgzf_eof_block, 16);
+    put_le16(h + 16, static_cast<std::uint16_t>(size - 1));
+    put_le32(h + size - 8, crc32(0, b.data.data(), static_cast<uInt>(b.data.size())));
+    put_le32(h + size - 4, static_cast<std::uint32_t>(b.data.size()));
+    b.packed.resize(size);
+    return true;
+  }
+
+  void compress_zstd(pending_block& b) const
+  {
+#ifdef BST_HAVE_ZSTD
+    b.packed.resize(ZSTD_compressBound(b.data.size()));
+    std::size_t n = ZSTD_compress(b.packed.data(), b.packed.size(),
+                                  b.data.data(), b.data.size(), level_);
+    if (ZSTD_isError(n))
+      throw std::domain_error("Failed to compress for '" + file_name_ + "'");
+    b.packed.resize(n);
+#else
+    (void)b;
+#endif
+  }
+
+  std::string file_name_;
+  block_format format_;
+  int level_;
+  thread_pool* workers_;
+  std::size_t block_size_;
+  int fd_;
+
+  std::vector<unsigned char> current_;
+  std::vector<pending_block> pending_;
+  std::vector<compressed_block> blocks_;
+  std::uint64_t offset_;
+  std::uint64_t data_offset_;
+  bool finished_;
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,175 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines sameas_canonicalizer, which gathers the owl:sameAs
+// links among interned terms into equivalence classes and rewrites
+// triples to one representative term per class.
+//===========================================================================
+
+#ifndef BST_CANONICALIZATION_HPP_
+#define BST_CANONICALIZATION_HPP_
+
+#include "term_id.hpp"
+#include "vocabulary.hpp"
+#include "union_find.hpp"
+#include "thread_pool.hpp"
+#include "triple_store.hpp"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace rdf {
+
+//===========================================================================
+// The classes are kept in a sparse_union_find over term ids, so links can
+// be added from any number of threads while triples are still streaming
+// in, typically by a collector aggregated with the store's loader:
+//
+//   sameas_canonicalizer same;
+//   parse_files(..., make_aggregate(store.bulk_loader(),
+//                                   same.make_collector()), ...);
+//   canonicalize(store, same, workers);
+//
+// The representative of a class is its smallest term id: a vocabulary
+// term if the class has one, then uris before blank nodes, then the term
+// interned first. Representatives are only final once every link is in,
+// so rewriting is done afterwards.
+//===========================================================================
+class sameas_canonicalizer
+{
+public:
+  sameas_canonicalizer()
+    : merged_(0)
+  {}
+
+  //----------------------------------------------------------------------
+  // Record that a and b denote the same resource. Literals are ignored:
+  // owl:sameAs only relates individuals.
+  //----------------------------------------------------------------------
+  void add(term_id a, term_id b)
+  {
+    if (a == b || kind_of(a) == literal_term || kind_of(b) == literal_term)
+      return;
+    if (sets_.unite(a, b))
+      merged_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------
+  // Record the owl:sameAs links among a range of id_triples.
+  //----------------------------------------------------------------------
+  template <typename Iter>
+  void add(Iter first, Iter last)
+  {
+    for (; first != last; ++first)
+      if (first->predicate == vocab::owl_sameAs)
+        add(first->subject, first->object);
+  }
+
+  term_id canonical(term_id id) const
+  {
+    return sets_.find(id);
+  }
+
+  id_triple canonical(id_triple const& t) const
+  {
+    id_triple c = { canonical(t.subject), canonical(t.predicate), canonical(t.object) };
+    return c;
+  }
+
+  bool same(term_id a, term_id b) const
+  {
+    return canonical(a) == canonical(b);
+  }
+
+  //----------------------------------------------------------------------
+  // The number of terms merged into another's class so far.
+  //----------------------------------------------------------------------
+  std::size_t merged() const
+  {
+    return merged_.load(std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------
+  // A visitor, for parse_files( ) or the ontology walker with an
+  // interning converter, that adds the links among the triples it sees.
+  // Copies may be used from any number of threads.
+  //----------------------------------------------------------------------
+  class collector
+  {
+  public:
+    explicit collector(sameas_canonicalizer& same)
+      : same_(&same)
+    {}
+
+    template <typename Iter>
+    void operator()(std::string const&, Iter first, Iter last) const
+    {
+      same_->add(first, last);
+    }
+
+  private:
+    sameas_canonicalizer* same_;
+  };
+
+  collector make_collector() { return collector(*this); }
+
+private:
+  sameas_canonicalizer(sameas_canonicalizer const&);
+  sameas_canonicalizer& operator=(sameas_canonicalizer const&);
+
+  // find( ) only compresses paths, which leaves every class as it was.
+  mutable sparse_union_find sets_;
+  std::atomic<std::size_t> merged_;
+};
+
+//===========================================================================
+// Rewrite the store's triples to the representatives of their terms, in
+// parallel. The owl:sameAs links themselves become reflexive and are
+// dropped, as are the duplicates the rewriting makes; the triples are
+// left sorted.
+//===========================================================================
+inline void canonicalize(triple_store& store, sameas_canonicalizer const& same,
+                         thread_pool& workers)
+{
+  std::vector<id_triple> triples(store.triples());
+  parallel_for(workers, triples.size(), [&triples, &same](std::size_t b, std::size_t e) {
+      for (std::size_t i = b; i < e; ++i)
+        triples[i] = same.canonical(triples[i]);
+    });
+
+  parallel_sort(workers, triples.begin(), triples.end());
+  triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+  triples.erase(
+    std::remove_if(triples.begin(), triples.end(), [](id_triple const& t) {
+        return t.predicate == vocab::owl_sameAs && t.subject == t.object;
+      }),
+    triples.end());
+
+  store.assign(std::move(triples));
+}
+
+} // namespace rdf
+
+#endif
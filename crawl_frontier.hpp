@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines the frontier policies of the ontology walker: which
+// of the uris found so far it fetches next. A frontier f is used as
+//
+//   f.push(uri)            add a starting point
+//   f.empty()              whether anything is left to fetch
+//   f.pop()                the next uri to fetch, as a std::string
+//   f.fetched(uri, links)  uri was fetched, and links (a vector of
+//                          strings) are the uris found in it, in order,
+//                          repeats included; empty if it failed
+//
+// The walker skips uris it has already visited, so a frontier may hand
+// the same uri out more than once.
+//===========================================================================
+
+#ifndef BST_CRAWL_FRONTIER_HPP_
+#define BST_CRAWL_FRONTIER_HPP_
+
+#include <queue>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace rdf {
+
+//===========================================================================
+// Breadth-first: uris are fetched in the order they were found.
+//===========================================================================
+class bfs_frontier
+{
+public:
+  void push(std::string const& uri) { fringe_.push(uri); }
+  bool empty() const { return fringe_.empty(); }
+
+  std::string pop()
+  {
+    std::string uri = fringe_.front();
+    fringe_.pop();
+    return uri;
+  }
+
+  void fetched(std::string const&, std::vector<std::string> const& links)
+  {
+    for (auto const& link : links)
+      fringe_.push(link);
+  }
+
+private:
+  std::queue<std::string> fringe_;
+};
+
+//===========================================================================
+// Importance first, after OPIC (Abiteboul, Preda and Cobena, "Adaptive
+// On-Line Page Importance Computation"). Every starting point is given
+// one unit of cash. Fetching a document moves its cash into its history
+// and shares it equally among the links found in it, so cash flows along
+// the link graph as it is discovered, much as PageRank would. The
+// unfetched document holding the most cash is fetched next, so heavily
+// linked vocabularies come before the leaves that merely use them.
+//
+// The importance of a document is its share of all the cash handed out
+// so far, history and current cash together. Documents without links
+// pass their cash to every document equally, as PageRank does with
+// dangling nodes; that leaves the order unchanged, so it is only kept as
+// a total.
+//===========================================================================
+class opic_frontier
+{
+public:
+  opic_frontier()
+    : pending_(0), distributed_(0), seeded_(0), dangling_(0)
+  {}
+
+  void push(std::string const& uri)
+  {
+    std::uint32_t d = add(uri);
+    seeded_ += 1;
+    credit(d, 1);
+  }
+
+  bool empty() const { return pending_ == 0; }
+
+  std::string pop()
+  {
+    for (;;)
+    {
+      entry e = heap_.top();
+      heap_.pop();
+
+      // Entries are not updated in place; a document's cash may have
+      // grown since this one was pushed, in which case a newer entry
+      // holds the right amount.
+      document& doc = documents_[e.id];
+      if (!doc.fetched && e.cash == doc.cash)
+      {
+        doc.fetched = true;
+        --pending_;
+        return uris_[e.id];
+      }
+    }
+  }
+
+  void fetched(std::string const& uri, std::vector<std::string> const& links)
+  {
+    std::uint32_t d = add(uri);
+    double cash = documents_[d].cash;
+    documents_[d].history += cash;
+    documents_[d].cash = 0;
+    distributed_ += cash;
+
+    if (!documents_[d].fetched)
+    {
+      documents_[d].fetched = true;
+      --pending_;
+    }
+
+    if (links.empty())
+    {
+      dangling_ += cash;
+      return;
+    }
+
+    double share = cash / links.size();
+    for (auto const& link : links)
+      credit(add(link), share);
+  }
+
+  //----------------------------------------------------------------------
+  // The estimated importance of a document, between 0 and 1, or 0 for a
+  // document never seen.
+  //----------------------------------------------------------------------
+  double importance(std::string const& uri) const
+  {
+    auto it = ids_.find(uri);
+    if (it == ids_.end() || seeded_ == 0)
+      return 0;
+    document const& doc = documents_[it->second];
+    double spread = uris_.empty() ? 0 : dangling_ / uris_.size();
+    return (doc.history + doc.cash + spread) / (distributed_ + seeded_);
+  }
+
+  std::size_t size() const { return uris_.size(); }
+
+private:
+  struct document
+  {
+    document() : cash(0), history(0), fetched(false) {}
+
+    double cash;
+    double history;
+    bool fetched;
+  };
+
+  struct entry
+  {
+    double cash;
+    std::uint32_t id;
+
+    bool operator<(entry const& e) const { return cash < e.cash; }
+  };
+
+  std::uint32_t add(std::string const& uri)
+  {
+    auto it = ids_.find(uri);
+    if (it != ids_.end())
+      return it->second;
+
+    std::uint32_t d = static_cast<std::uint32_t>(uris_.size());
+    ids_.insert(std::make_pair(uri, d));
+    uris_.push_back(uri);
+    documents_.push_back(document());
+    ++pending_;
+    return d;
+  }
+
+  void credit(std::uint32_t d, double cash)
+  {
+    document& doc = documents_[d];
+    doc.cash += cash;
+    if (!doc.fetched)
+    {
+      entry e = { doc.cash, d };
+      heap_.push(e);
+    }
+  }
+
+  // The uris are kept by value, so copies of a frontier stand alone.
+  std::unordered_map<std::string, std::uint32_t> ids_;
+  std::vector<std::string> uris_;
+  std::vector<document> documents_;
+  std::priority_queue<entry> heap_;
+  std::size_t pending_;
+  double distributed_;
+  double seeded_;
+  double dangling_;
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,402 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file turns interned triples into a graph in compressed sparse row
+// form, and runs the usual whole-graph kernels over it on a thread_pool:
+// breadth-first search, connected components and PageRank.
+//===========================================================================
+
+#ifndef BST_CSR_GRAPH_HPP_
+#define BST_CSR_GRAPH_HPP_
+
+#include "term_id.hpp"
+#include "thread_pool.hpp"
+#include "union_find.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+namespace rdf {
+
+//===========================================================================
+// A directed graph over the terms of some triples. Vertices are numbered
+// densely from 0, in term id order within each dictionary stripe; the
+// out-edges of vertex v are targets()[offsets()[v] .. offsets()[v + 1]),
+// sorted. term( ) and find( ) map between vertices and term ids without
+// hashing: the vertex of a term is looked up by its stripe and its index
+// within the stripe.
+//===========================================================================
+class csr_graph
+{
+public:
+  typedef std::uint32_t vertex;
+
+  static const vertex no_vertex = 0xFFFFFFFFu;
+
+  csr_graph()
+    : vertices_(std::make_shared<vertex_table>()), offsets_(1, 0)
+  {}
+
+  std::size_t vertex_count() const { return vertices_->terms.size(); }
+  std::size_t edge_count() const { return targets_.size(); }
+
+  std::vector<std::uint64_t> const& offsets() const { return offsets_; }
+  std::vector<vertex> const& targets() const { return targets_; }
+
+  vertex const* begin(vertex v) const { return targets_.data() + offsets_[v]; }
+  vertex const* end(vertex v) const { return targets_.data() + offsets_[v + 1]; }
+  std::size_t degree(vertex v) const { return offsets_[v + 1] - offsets_[v]; }
+
+  term_id term(vertex v) const { return vertices_->terms[v]; }
+
+  //----------------------------------------------------------------------
+  // The vertex of a term, or no_vertex if it is not in the graph.
+  //----------------------------------------------------------------------
+  vertex find(term_id id) const
+  {
+    std::vector<vertex> const& stripe =
+      vertices_->index[(id >> term_index_bits) & (stripe_count - 1)];
+    std::uint32_t i = id & ((1u << term_index_bits) - 1);
+    return id != invalid_term_id && i < stripe.size() ? stripe[i] : no_vertex;
+  }
+
+  //----------------------------------------------------------------------
+  // The same graph with every edge reversed; it shares the vertex tables.
+  //----------------------------------------------------------------------
+  csr_graph transpose(thread_pool& workers) const
+  {
+    csr_graph t;
+    t.vertices_ = vertices_;
+    std::vector<std::pair<vertex, vertex>> edges;
+    edges.reserve(targets_.size());
+    for (vertex v = 0; v + 1 < offsets_.size(); ++v)
+      for (vertex const* u = begin(v); u != end(v); ++u)
+        edges.push_back(std::make_pair(*u, v));
+    t.assign(vertex_count(), edges, workers);
+    return t;
+  }
+
+  template <typename Iter>
+  static csr_graph build(Iter first, Iter last, std::vector<term_id> predicates,
+                         thread_pool& workers, bool undirected);
+
+private:
+  static const std::size_t stripe_count = std::size_t(1) << term_stripe_bits;
+
+  struct vertex_table
+  {
+    vertex_table() : index(stripe_count) {}
+
+    std::vector<term_id> terms;
+    std::vector<std::vector<vertex>> index;
+  };
+
+  //----------------------------------------------------------------------
+  // Lay out edges, as (source, target) vertex pairs, in CSR form: count
+  // the degrees, place every edge after its source's predecessors, then
+  // sort and deduplicate each vertex's targets in parallel.
+  //----------------------------------------------------------------------
+  void assign(std::size_t n, std::vector<std::pair<vertex, vertex>> const& edges,
+              thread_pool& workers)
+  {
+    offsets_.assign(n + 1, 0);
+    for (std::size_t i = 0; i < edges.size(); ++i)
+      ++offsets_[edges[i].first + 1];
+    for (std::size_t v = 0; v < n; ++v)
+      offsets_[v + 1] += offsets_[v];
+
+    std::vector<std::uint64_t> cursor(offsets_.begin(), offsets_.end() - 1);
+    targets_.resize(edges.size());
+    for (std::size_t i = 0; i < edges.size(); ++i)
+      targets_[cursor[edges[i].first]++] = edges[i].second;
+
+    std::vector<std::uint64_t> unique(n, 0);
+    parallel_for(workers, n, [this, &unique](std::size_t first, std::size_t last) {
+        for (std::size_t v = first; v < last; ++v)
+        {
+          vertex* b = targets_.data() + offsets_[v];
+          vertex* e = targets_.data() + offsets_[v + 1];
+          std::sort(b, e);
+          unique[v] = std::unique(b, e) - b;
+        }
+      });
+
+    // Close the gaps the duplicates left.
+    std::uint64_t out = 0;
+    for (std::size_t v = 0; v < n; ++v)
+    {
+      std::uint64_t first = offsets_[v];
+      offsets_[v] = out;
+      for (std::uint64_t i = 0; i < unique[v]; ++i)
+        targets_[out++] = targets_[first + i];
+    }
+    offsets_[n] = out;
+    targets_.resize(out);
+    targets_.shrink_to_fit();
+  }
+
+  std::shared_ptr<vertex_table> vertices_;
+  std::vector<std::uint64_t> offsets_;
+  std::vector<vertex> targets_;
+};
+
+template <typename Iter>
+csr_graph csr_graph::build(
+  Iter triples, Iter last, std::vector<term_id> predicates,
+  thread_pool& workers, bool undirected)
+{
+  std::sort(predicates.begin(), predicates.end());
+  std::size_t n = last - triples;
+
+  // Pick out the edges wanted, in parallel.
+  std::vector<char> keep(n, 0);
+  parallel_for(workers, n, [&triples, &keep, &predicates](std::size_t b, std::size_t e) {
+      for (std::size_t i = b; i < e; ++i)
+        keep[i] = kind_of(triples[i].object) != literal_term
+          && (predicates.empty() || std::binary_search(
+                predicates.begin(), predicates.end(), triples[i].predicate));
+    });
+
+  // Number the vertices: mark every endpoint in its stripe's table, then
+  // hand out numbers in stripe order.
+  csr_graph g;
+  std::vector<std::vector<vertex>>& index = g.vertices_->index;
+  auto mark = [&index](term_id id) {
+    std::vector<vertex>& stripe = index[(id >> term_index_bits) & (stripe_count - 1)];
+    std::uint32_t i = id & ((1u << term_index_bits) - 1);
+    if (i >= stripe.size())
+      stripe.resize(i + 1, vertex(no_vertex));
+    stripe[i] = 0;
+  };
+  for (std::size_t i = 0; i < n; ++i)
+    if (keep[i])
+    {
+      mark(triples[i].subject);
+      mark(triples[i].object);
+    }
+
+  std::vector<term_id>& terms = g.vertices_->terms;
+  for (std::size_t s = 0; s < index.size(); ++s)
+    for (std::size_t i = 0; i < index[s].size(); ++i)
+      if (index[s][i] == 0)
+      {
+        index[s][i] = static_cast<vertex>(terms.size());
+        terms.push_back(0);
+      }
+
+  // A term's slot does not record its kind, so the ids are filled in
+  // from the triples.
+  std::vector<std::pair<vertex, vertex>> edges;
+  edges.reserve(undirected ? 2 * n : n);
+  for (std::size_t i = 0; i < n; ++i)
+    if (keep[i])
+    {
+      vertex s = g.find(triples[i].subject);
+      vertex o = g.find(triples[i].object);
+      terms[s] = triples[i].subject;
+      terms[o] = triples[i].object;
+      edges.push_back(std::make_pair(s, o));
+      if (undirected)
+        edges.push_back(std::make_pair(o, s));
+    }
+
+  g.assign(terms.size(), edges, workers);
+  return g;
+}
+
+//===========================================================================
+// Build the graph of the triples in [first, last), a random-access range,
+// whose predicate is one of predicates (or any, if predicates is empty):
+// an edge from subject to object for each, duplicates merged. Literal
+// objects are not entities and are left out. With undirected set, every
+// edge is added both ways.
+//===========================================================================
+template <typename Iter>
+csr_graph build_csr_graph(
+  Iter first, Iter last, std::vector<term_id> const& predicates,
+  thread_pool& workers, bool undirected = false)
+{
+  return csr_graph::build(first, last, predicates, workers, undirected);
+}
+
+template <typename Iter>
+csr_graph build_csr_graph(Iter first, Iter last, thread_pool& workers, bool undirected = false)
+{
+  return csr_graph::build(first, last, std::vector<term_id>(), workers, undirected);
+}
+
+//===========================================================================
+// Breadth-first search from source, level by level, with the frontier
+// split across the workers. Returns each vertex's distance from source
+// in edges, or unreached.
+//===========================================================================
+const std::uint32_t unreached = 0xFFFFFFFFu;
+
+inline std::vector<std::uint32_t> parallel_bfs(
+  csr_graph const& g, csr_graph::vertex source, thread_pool& workers)
+{
+  typedef csr_graph::vertex vertex;
+  std::size_t n = g.vertex_count();
+
+  std::vector<std::atomic<std::uint32_t>> distance(n);
+  for (std::size_t v = 0; v < n; ++v)
+    distance[v].store(unreached, std::memory_order_relaxed);
+
+  std::vector<vertex> frontier;
+  if (source < n)
+  {
+    distance[source].store(0, std::memory_order_relaxed);
+    frontier.push_back(source);
+  }
+
+  std::mutex mutex;
+  for (std::uint32_t level = 1; !frontier.empty(); ++level)
+  {
+    std::vector<vertex> next;
+    parallel_for(workers, frontier.size(),
+      [&g, &distance, &frontier, &next, &mutex, level](std::size_t b, std::size_t e) {
+        std::vector<vertex> found;
+        for (std::size_t i = b; i < e; ++i)
+          for (vertex const* v = g.begin(frontier[i]); v != g.end(frontier[i]); ++v)
+          {
+            // Claim a vertex once: only the thread whose exchange
+            // succeeds adds it to the next frontier.
+            std::uint32_t expected = unreached;
+            if (distance[*v].load(std::memory_order_relaxed) == unreached
+                && distance[*v].compare_exchange_strong(expected, level, std::memory_order_relaxed))
+              found.push_back(*v);
+          }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        next.insert(next.end(), found.begin(), found.end());
+      }, 64);
+    frontier.swap(next);
+  }
+
+  std::vector<std::uint32_t> result(n);
+  for (std::size_t v = 0; v < n; ++v)
+    result[v] = distance[v].load(std::memory_order_relaxed);
+  return result;
+}
+
+//===========================================================================
+// Weakly connected components: edges are united in parallel in a
+// concurrent_union_find. Returns each vertex's component, named by its
+// smallest vertex.
+//===========================================================================
+inline std::vector<csr_graph::vertex> connected_components(
+  csr_graph const& g, thread_pool& workers)
+{
+  typedef csr_graph::vertex vertex;
+  std::size_t n = g.vertex_count();
+  concurrent_union_find sets(n);
+
+  parallel_for(workers, n, [&g, &sets](std::size_t b, std::size_t e) {
+      for (std::size_t v = b; v < e; ++v)
+        for (vertex const* u = g.begin(static_cast<vertex>(v)); u != g.end(static_cast<vertex>(v)); ++u)
+          sets.unite(static_cast<vertex>(v), *u);
+    });
+
+  std::vector<vertex> component(n);
+  parallel_for(workers, n, [&sets, &component](std::size_t b, std::size_t e) {
+      for (std::size_t v = b; v < e; ++v)
+        component[v] = sets.find(static_cast<vertex>(v));
+    });
+  return component;
+}
+
+//===========================================================================
+// PageRank by power iteration. Each round pulls rank along the reversed
+// edges, one slice of the vertices per task, so no two tasks write the
+// same rank; the rank of vertices without out-edges is spread over all.
+// Stops when the ranks change by less than tolerance in total (L1), or
+// after max_iterations. The ranks sum to 1.
+//===========================================================================
+struct pagerank_options
+{
+  pagerank_options()
+    : damping(0.85), tolerance(1e-6), max_iterations(100)
+  {}
+
+  double damping;
+  double tolerance;
+  unsigned max_iterations;
+};
+
+inline std::vector<double> pagerank(
+  csr_graph const& g, thread_pool& workers,
+  pagerank_options const& opts = pagerank_options())
+{
+  typedef csr_graph::vertex vertex;
+  std::size_t n = g.vertex_count();
+  if (n == 0)
+    return std::vector<double>();
+
+  csr_graph in = g.transpose(workers);
+  std::vector<double> rank(n, 1.0 / n);
+  std::vector<double> next(n);
+  std::vector<double> share(n);
+
+  for (unsigned iteration = 0; iteration < opts.max_iterations; ++iteration)
+  {
+    double dangling = 0;
+    for (std::size_t v = 0; v < n; ++v)
+    {
+      std::size_t d = g.degree(static_cast<vertex>(v));
+      share[v] = d != 0 ? rank[v] / d : 0;
+      if (d == 0)
+        dangling += rank[v];
+    }
+
+    double base = (1 - opts.damping) / n + opts.damping * dangling / n;
+    std::mutex mutex;
+    double change = 0;
+    parallel_for(workers, n, [&](std::size_t b, std::size_t e) {
+        double local = 0;
+        for (std::size_t v = b; v < e; ++v)
+        {
+          double sum = 0;
+          for (vertex const* u = in.begin(static_cast<vertex>(v)); u != in.end(static_cast<vertex>(v)); ++u)
+            sum += share[*u];
+          next[v] = base + opts.damping * sum;
+          local += std::fabs(next[v] - rank[v]);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        change += local;
+      });
+
+    rank.swap(next);
+    if (change < opts.tolerance)
+      break;
+  }
+  return rank;
+}
+
+} // namespace rdf
+
+#endif
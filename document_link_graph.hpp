@@ -0,0 +1,204 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines document_link_graph, the graph of which documents
+// link to which, as the ontology walker finds it: one edge per linking
+// document, linked document and predicate, with the number of triples
+// that made the link.
+//===========================================================================
+
+#ifndef BST_DOCUMENT_LINK_GRAPH_HPP_
+#define BST_DOCUMENT_LINK_GRAPH_HPP_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <unordered_map>
+#include <cstdint>
+
+namespace rdf {
+
+//===========================================================================
+// Documents and predicates are numbered from 0 in the order they are
+// first seen; a document may be known only as a link target, without
+// having been visited yet. URIs are stored once, as the keys of the map
+// that numbers them. Not thread-safe.
+//===========================================================================
+class document_link_graph
+{
+public:
+  typedef std::uint32_t document;
+  typedef std::uint32_t predicate;
+
+  static const document no_document = 0xFFFFFFFFu;
+
+  struct link
+  {
+    document from;
+    document to;
+    predicate via;
+    std::uint32_t count;
+  };
+
+  document_link_graph() {}
+
+  //----------------------------------------------------------------------
+  // Documents.
+  //----------------------------------------------------------------------
+  document add_document(std::string const& uri)
+  {
+    auto it = documents_.find(uri);
+    if (it != documents_.end())
+      return it->second;
+
+    document d = static_cast<document>(uris_.size());
+    it = documents_.insert(std::make_pair(uri, d)).first;
+    uris_.push_back(&it->first);
+    visited_.push_back(false);
+    return d;
+  }
+
+  document find(std::string const& uri) const
+  {
+    auto it = documents_.find(uri);
+    return it == documents_.end() ? no_document : it->second;
+  }
+
+  std::string const& uri(document d) const { return *uris_.at(d); }
+  std::size_t document_count() const { return uris_.size(); }
+
+  void mark_visited(document d) { visited_.at(d) = true; }
+  bool visited(document d) const { return visited_.at(d); }
+
+  //----------------------------------------------------------------------
+  // Predicates.
+  //----------------------------------------------------------------------
+  predicate add_predicate(std::string const& iri)
+  {
+    auto it = predicates_.find(iri);
+    if (it != predicates_.end())
+      return it->second;
+
+    predicate p = static_cast<predicate>(predicate_iris_.size());
+    it = predicates_.insert(std::make_pair(iri, p)).first;
+    predicate_iris_.push_back(&it->first);
+    return p;
+  }
+
+  std::string const& predicate_iri(predicate p) const { return *predicate_iris_.at(p); }
+  std::size_t predicate_count() const { return predicate_iris_.size(); }
+
+  //----------------------------------------------------------------------
+  // Links.
+  //----------------------------------------------------------------------
+  void add_link(document from, document to, predicate via, std::uint32_t count = 1)
+  {
+    if (from >= uris_.size() || to >= uris_.size() || via >= predicate_iris_.size())
+      throw std::domain_error("link to an unknown document or predicate");
+    link_key key = { from, to, via };
+    links_[key] += count;
+  }
+
+  std::size_t link_count() const { return links_.size(); }
+
+  //----------------------------------------------------------------------
+  // Every link, ordered by linking document, linked document and
+  // predicate.
+  //----------------------------------------------------------------------
+  std::vector<link> links() const
+  {
+    std::vector<link> result;
+    result.reserve(links_.size());
+    for (auto const& l : links_)
+    {
+      link x = { l.first.from, l.first.to, l.first.via, l.second };
+      result.push_back(x);
+    }
+    std::sort(result.begin(), result.end(), [](link const& a, link const& b) {
+        return a.from != b.from ? a.from < b.from
+          : a.to != b.to ? a.to < b.to : a.via < b.via;
+      });
+    return result;
+  }
+
+  //----------------------------------------------------------------------
+  // The number of links into and out of each document, counting each
+  // link as many times as triples made it. Documents with many links in
+  // are the hubs.
+  //----------------------------------------------------------------------
+  std::vector<std::size_t> in_counts() const
+  {
+    std::vector<std::size_t> counts(uris_.size(), 0);
+    for (auto const& l : links_)
+      counts[l.first.to] += l.second;
+    return counts;
+  }
+
+  std::vector<std::size_t> out_counts() const
+  {
+    std::vector<std::size_t> counts(uris_.size(), 0);
+    for (auto const& l : links_)
+      counts[l.first.from] += l.second;
+    return counts;
+  }
+
+private:
+  document_link_graph(document_link_graph const&);
+  document_link_graph& operator=(document_link_graph const&);
+
+  struct link_key
+  {
+    document from;
+    document to;
+    predicate via;
+
+    bool operator==(link_key const& k) const
+    {
+      return from == k.from && to == k.to && via == k.via;
+    }
+  };
+
+  struct link_hash
+  {
+    std::size_t operator()(link_key const& k) const
+    {
+      std::uint64_t h = (static_cast<std::uint64_t>(k.from) << 32) ^ k.to;
+      h ^= static_cast<std::uint64_t>(k.via) * 0x9E3779B97F4A7C15ULL;
+      h *= 0xFF51AFD7ED558CCDULL;
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+  };
+
+  std::unordered_map<std::string, document> documents_;
+  std::vector<std::string const*> uris_;
+  std::vector<bool> visited_;
+
+  std::unordered_map<std::string, predicate> predicates_;
+  std::vector<std::string const*> predicate_iris_;
+
+  std::unordered_map<link_key, std::uint32_t, link_hash> links_;
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,316 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines file_reader, the local-file I/O layer used by the
+// parsers. It reads a file in large fixed-size chunks, tells the kernel
+// about the access pattern, can bypass the page cache with O_DIRECT, and
+// can read ahead on a background thread so the disk stays busy while the
+// previous chunk is being parsed.
+//===========================================================================
+
+#ifndef BST_FILE_READER_HPP_
+#define BST_FILE_READER_HPP_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+#include <deque>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace rdf {
+
+//===========================================================================
+// Tuning knobs for file_reader. The defaults suit large sequential reads
+// on fast disks: 1MB chunks, four of them in flight. Files smaller than
+// two chunks are read inline into a buffer of their own size whatever
+// the options say, so small documents cost neither a thread nor
+// megabytes of buffers.
+//===========================================================================
+struct read_options
+{
+  read_options()
+    : buffer_size(1 << 20), buffer_count(4), direct_io(false), read_ahead(true)
+  {}
+
+  std::size_t buffer_size;   // bytes per chunk
+  std::size_t buffer_count;  // chunks in flight when reading ahead
+  bool direct_io;            // try to bypass the page cache (O_DIRECT)
+  bool read_ahead;           // read on a background thread
+};
+
+namespace {
+
+//----------------------------------------------------------------------
+// O_DIRECT needs the buffer, the file offset and the transfer size to be
+// aligned. A page is enough for every device we care about.
+//----------------------------------------------------------------------
+const std::size_t io_alignment = 4096;
+
+struct aligned_free
+{
+  void operator()(unsigned char* p) const { std::free(p); }
+};
+
+typedef std::unique_ptr<unsigned char, aligned_free> aligned_buffer;
+
+inline aligned_buffer make_aligned_buffer(std::size_t size)
+{
+  void* p = NULL;
+  if (::posix_memalign(&p, io_alignment, size) != 0)
+    throw std::bad_alloc();
+  return aligned_buffer(static_cast<unsigned char*>(p));
+}
+
+inline std::string errno_message(std::string const& what, std::string const& file_name)
+{
+  return what + " '" + file_name + "': " + std::generic_category().message(errno);
+}
+
+} // namespace
+
+//===========================================================================
+// Reads a whole file, handing each chunk to a callback. Opening the file
+// happens in the constructor, which throws std::domain_error if the file
+// cannot be opened.
+//===========================================================================
+class file_reader
+{
+public:
+  explicit file_reader(std::string const& file_name, read_options const& opts = read_options())
+    : file_name_(file_name), opts_(opts), fd_(-1)
+  {
+    if (opts_.buffer_size == 0)
+      opts_.buffer_size = read_options().buffer_size;
+    if (opts_.buffer_count < 2)
+      opts_.buffer_count = 2;
+
+    if (opts_.direct_io)
+    {
+      // Not every file system supports O_DIRECT; fall back to buffered
+      // reads when it is refused.
+      fd_ = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+      if (fd_ < 0 && errno != EINVAL)
+        throw std::domain_error(errno_message("Failed to open file", file_name));
+      opts_.direct_io = (fd_ >= 0);
+    }
+
+    if (fd_ < 0)
+      fd_ = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+      throw std::domain_error(errno_message("Failed to open file", file_name));
+
+    struct stat st;
+    if (::fstat(fd_, &st) == 0 && S_ISREG(st.st_mode)
+        && static_cast<std::uint64_t>(st.st_size) < 2 * static_cast<std::uint64_t>(opts_.buffer_size))
+    {
+      opts_.read_ahead = false;
+      opts_.buffer_size = std::max<std::size_t>(static_cast<std::size_t>(st.st_size), 1);
+    }
+
+    if (opts_.direct_io)
+      opts_.buffer_size = (opts_.buffer_size + io_alignment - 1) / io_alignment * io_alignment;
+    else
+      ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  ~file_reader()
+  {
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  std::string const& file_name() const { return file_name_; }
+  read_options const& options() const { return opts_; }
+
+  //----------------------------------------------------------------------
+  // Call f(unsigned char const* data, std::size_t size) for every chunk of
+  // the file, in order. Read errors throw std::domain_error; exceptions
+  // thrown by f stop the read and are propagated.
+  //----------------------------------------------------------------------
+  template <typename Func>
+  void for_each_chunk(Func f)
+  {
+    if (opts_.read_ahead)
+      read_ahead(f);
+    else
+      read_inline(f);
+  }
+
+private:
+  file_reader(file_reader const&);
+  file_reader& operator=(file_reader const&);
+
+  //----------------------------------------------------------------------
+  // Fill a buffer as far as possible. Returns the number of bytes read,
+  // which is less than the buffer size only at the end of the file.
+  //----------------------------------------------------------------------
+  std::size_t fill(unsigned char* buf)
+  {
+    std::size_t total = 0;
+    while (total < opts_.buffer_size)
+    {
+      ssize_t n = ::read(fd_, buf + total, opts_.buffer_size - total);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        throw std::domain_error(errno_message("Failed to read file", file_name_));
+      }
+      if (n == 0)
+        break;
+      total += static_cast<std::size_t>(n);
+
+      // A short read under O_DIRECT leaves us misaligned; it only
+      // happens at the end of the file anyway.
+      if (opts_.direct_io && total % io_alignment != 0)
+        break;
+    }
+    return total;
+  }
+
+  template <typename Func>
+  void read_inline(Func& f)
+  {
+    aligned_buffer buf = make_aligned_buffer(opts_.buffer_size);
+    for (std::size_t n = fill(buf.get()); n != 0; n = fill(buf.get()))
+      f(static_cast<unsigned char const*>(buf.get()), n);
+  }
+
+  //----------------------------------------------------------------------
+  // A background thread fills free buffers and queues them up; this
+  // thread parses them in order and hands them back. A chunk of size zero
+  // marks the end of the file.
+  //----------------------------------------------------------------------
+  template <typename Func>
+  void read_ahead(Func& f)
+  {
+    struct chunk
+    {
+      unsigned char* data;
+      std::size_t size;
+    };
+
+    std::vector<aligned_buffer> buffers;
+    std::vector<unsigned char*> free_list;
+    for (std::size_t i = 0; i < opts_.buffer_count; ++i)
+    {
+      buffers.push_back(make_aligned_buffer(opts_.buffer_size));
+      free_list.push_back(buffers.back().get());
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<chunk> ready;
+    std::exception_ptr error;
+    bool stop = false;
+
+    std::thread reader([&]() {
+        try
+        {
+          for (;;)
+          {
+            unsigned char* buf = NULL;
+            {
+              std::unique_lock<std::mutex> lock(mutex);
+              cond.wait(lock, [&]() { return stop || !free_list.empty(); });
+              if (stop)
+                return;
+              buf = free_list.back();
+              free_list.pop_back();
+            }
+
+            chunk c = { buf, fill(buf) };
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(c);
+            cond.notify_all();
+            if (c.size == 0)
+              return;
+          }
+        }
+        catch (...)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          error = std::current_exception();
+          chunk c = { NULL, 0 };
+          ready.push_back(c);
+          cond.notify_all();
+        }
+      });
+
+    // Make sure the reader is stopped and joined however we leave.
+    struct joiner
+    {
+      std::thread& t; std::mutex& m; std::condition_variable& c; bool& s;
+      ~joiner()
+      {
+        { std::lock_guard<std::mutex> lock(m); s = true; }
+        c.notify_all();
+        t.join();
+      }
+    } join_reader = { reader, mutex, cond, stop };
+
+    for (;;)
+    {
+      chunk c;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return !ready.empty(); });
+        c = ready.front();
+        ready.pop_front();
+        if (c.size == 0)
+        {
+          if (error)
+            std::rethrow_exception(error);
+          return;
+        }
+      }
+
+      f(static_cast<unsigned char const*>(c.data), c.size);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      free_list.push_back(c.data);
+      cond.notify_all();
+    }
+  }
+
+  std::string file_name_;
+  read_options opts_;
+  int fd_;
+};
+
+} // namespace rdf
+
+#endif
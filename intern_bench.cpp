@@ -0,0 +1,191 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// intern_bench: measure how term_dictionary interning scales with the
+// number of threads.
+//
+//   intern_bench [-n terms] [-d distinct] [-j max_threads] [-s seed]
+//
+// A stream of terms shaped like a crawl is generated up front: a few hot
+// vocabulary terms, uris sharing a handful of namespaces, and literals.
+// Then for 1, 2, 4, ... up to max_threads threads (64 by default), each
+// thread interns its own part of the stream into a fresh dictionary, once
+// through intern( ) and once through a per-thread cache. The throughput
+// of each is printed in millions of terms per second. Build with
+// -pthread -lraptor2.
+//===========================================================================
+
+#include "term_dictionary.hpp"
+#include "vocabulary.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace {
+
+int usage()
+{
+  std::cerr << "usage: intern_bench [-n terms] [-d distinct] [-j max_threads] [-s seed]\n";
+  return 2;
+}
+
+struct generated_term
+{
+  rdf::term_kind kind;
+  std::string value;
+};
+
+//----------------------------------------------------------------------
+// distinct different terms, and a stream of n of them in which a fifth
+// are hot vocabulary terms and the rest are drawn uniformly.
+//----------------------------------------------------------------------
+std::vector<rdf::term_view> make_stream(
+  std::size_t n, std::size_t distinct, unsigned seed, std::vector<generated_term>& terms)
+{
+  static char const* const namespaces[] = {
+    "http://schema.org/",
+    "http://xmlns.com/foaf/0.1/",
+    "http://dbpedia.org/resource/",
+    "http://www.wikidata.org/entity/Q",
+    "http://example.org/data/item/"
+  };
+  static const std::size_t namespace_count = sizeof(namespaces) / sizeof(namespaces[0]);
+
+  std::mt19937 rng(seed);
+  terms.clear();
+  terms.reserve(distinct);
+  for (std::size_t i = 0; i < distinct; ++i)
+  {
+    generated_term t;
+    if (i % 4 == 3)
+    {
+      t.kind = rdf::literal_term;
+      t.value = "Literal value number " + std::to_string(i);
+    }
+    else
+    {
+      t.kind = rdf::uri_term;
+      t.value = namespaces[rng() % namespace_count] + std::to_string(i);
+    }
+    terms.push_back(t);
+  }
+
+  std::vector<rdf::term_view> stream;
+  stream.reserve(n);
+  std::uniform_int_distribution<std::size_t> pick(0, distinct - 1);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    if (rng() % 5 == 0)
+    {
+      rdf::term_id id = rdf::vocab::well_known_terms[rng() % 8].id;
+      char const* iri = rdf::vocab::iri(id);
+      stream.push_back(rdf::term_view(rdf::uri_term, iri, std::strlen(iri)));
+    }
+    else
+    {
+      generated_term const& t = terms[pick(rng)];
+      stream.push_back(rdf::term_view(t.kind, t.value.data(), t.value.size()));
+    }
+  }
+  return stream;
+}
+
+//----------------------------------------------------------------------
+// Intern the stream into a fresh dictionary with the given number of
+// threads, each taking a contiguous part, and return the seconds taken.
+//----------------------------------------------------------------------
+double run(std::vector<rdf::term_view> const& stream, std::size_t threads, bool cached)
+{
+  rdf::term_dictionary dict;
+  std::vector<std::thread> workers;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < threads; ++i)
+  {
+    std::size_t begin = stream.size() * i / threads;
+    std::size_t end = stream.size() * (i + 1) / threads;
+    workers.push_back(std::thread([&dict, &stream, begin, end, cached]() {
+        rdf::term_dictionary::cache c;
+        for (std::size_t k = begin; k < end; ++k)
+          if (cached)
+            dict.intern(stream[k], c);
+          else
+            dict.intern(stream[k]);
+      }));
+  }
+  for (auto& t : workers)
+    t.join();
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double>(stop - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  std::size_t terms = 20000000;
+  std::size_t distinct = 2000000;
+  std::size_t max_threads = 64;
+  unsigned seed = 1;
+
+  int opt;
+  while ((opt = ::getopt(argc, argv, "n:d:j:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n': terms = static_cast<std::size_t>(std::atol(optarg)); break;
+    case 'd': distinct = static_cast<std::size_t>(std::atol(optarg)); break;
+    case 'j': max_threads = static_cast<std::size_t>(std::atol(optarg)); break;
+    case 's': seed = static_cast<unsigned>(std::atol(optarg)); break;
+    default: return usage();
+    }
+  }
+  if (argc != optind || terms == 0 || distinct == 0 || max_threads == 0)
+    return usage();
+
+  std::vector<generated_term> storage;
+  std::vector<rdf::term_view> stream = make_stream(terms, distinct, seed, storage);
+
+  std::cout << terms << " terms, " << distinct << " distinct, "
+            << std::thread::hardware_concurrency() << " hardware threads\n\n"
+            << "threads   intern Mterms/s   cached Mterms/s\n";
+  std::cout << std::fixed << std::setprecision(2);
+  for (std::size_t threads = 1; threads <= max_threads; threads *= 2)
+  {
+    double plain = run(stream, threads, false);
+    double cached = run(stream, threads, true);
+    std::cout << std::setw(7) << threads
+              << std::setw(18) << terms / plain / 1e6
+              << std::setw(18) << terms / cached / 1e6 << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,220 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains the IRI handling shared by the native parsers:
+// telling absolute IRIs from relative references, and resolving the
+// latter against a base IRI as RFC 3986 describes.
+//===========================================================================
+
+#ifndef BST_IRI_RESOLUTION_HPP_
+#define BST_IRI_RESOLUTION_HPP_
+
+#include <string>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace rdf {
+
+//----------------------------------------------------------------------
+// The length of the scheme of an absolute IRI, including the colon, or 0
+// for a relative reference.
+//----------------------------------------------------------------------
+inline std::size_t scheme_length(char const* iri, std::size_t size)
+{
+  if (size == 0 || !((iri[0] | 0x20) >= 'a' && (iri[0] | 0x20) <= 'z'))
+    return 0;
+  for (std::size_t i = 1; i < size; ++i)
+  {
+    char c = iri[i];
+    if (c == ':')
+      return i + 1;
+    if (!(((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || (c >= '0' && c <= '9')
+          || c == '+' || c == '-' || c == '.'))
+      return 0;
+  }
+  return 0;
+}
+
+//----------------------------------------------------------------------
+// remove_dot_segments from RFC 3986, section 5.2.4.
+//----------------------------------------------------------------------
+inline std::string remove_dot_segments(std::string in)
+{
+  std::string out;
+  while (!in.empty())
+  {
+    if (in.compare(0, 3, "../") == 0)
+      in.erase(0, 3);
+    else if (in.compare(0, 2, "./") == 0)
+      in.erase(0, 2);
+    else if (in.compare(0, 3, "/./") == 0)
+      in.erase(0, 2);
+    else if (in == "/.")
+      in = "/";
+    else if (in.compare(0, 4, "/../") == 0 || in == "/..")
+    {
+      in = "/" + in.substr(in.size() == 3 ? 3 : 4);
+      std::string::size_type slash = out.rfind('/');
+      out.erase(slash == std::string::npos ? 0 : slash);
+    }
+    else if (in == "." || in == "..")
+      in.clear();
+    else
+    {
+      std::string::size_type next = in.find('/', 1);
+      if (next == std::string::npos)
+        next = in.size();
+      out.append(in, 0, next);
+      in.erase(0, next);
+    }
+  }
+  return out;
+}
+
+//----------------------------------------------------------------------
+// A base IRI, split up for resolving references against it (RFC 3986,
+// section 5.2.2).
+//----------------------------------------------------------------------
+class base_iri
+{
+public:
+  base_iri() : has_authority_(false), has_query_(false) {}
+
+  explicit base_iri(std::string const& iri)
+    : has_authority_(false), has_query_(false)
+  {
+    std::string rest = iri.substr(0, iri.find('#'));
+    std::size_t n = scheme_length(rest.data(), rest.size());
+    scheme_ = rest.substr(0, n);
+    rest.erase(0, n);
+
+    if (rest.compare(0, 2, "//") == 0)
+    {
+      std::string::size_type end = rest.find_first_of("/?", 2);
+      if (end == std::string::npos)
+        end = rest.size();
+      authority_ = rest.substr(2, end - 2);
+      has_authority_ = true;
+      rest.erase(0, end);
+    }
+
+    std::string::size_type q = rest.find('?');
+    if (q != std::string::npos)
+    {
+      query_ = rest.substr(q + 1);
+      has_query_ = true;
+      rest.erase(q);
+    }
+    path_ = rest;
+  }
+
+  void resolve(char const* ref, std::size_t size, std::string& out) const
+  {
+    std::string r(ref, size);
+    std::string fragment;
+    std::string::size_type hash = r.find('#');
+    if (hash != std::string::npos)
+    {
+      fragment = r.substr(hash);
+      r.erase(hash);
+    }
+
+    std::string query;
+    bool has_query = false;
+    std::string::size_type q = r.find('?');
+    if (q != std::string::npos)
+    {
+      query = r.substr(q + 1);
+      has_query = true;
+      r.erase(q);
+    }
+
+    out = scheme_;
+    if (r.compare(0, 2, "//") == 0)
+    {
+      std::string::size_type end = r.find('/', 2);
+      if (end == std::string::npos)
+        end = r.size();
+      out += r.substr(0, end);
+      out += remove_dot_segments(r.substr(end));
+    }
+    else
+    {
+      if (has_authority_)
+        out += "//" + authority_;
+
+      if (r.empty())
+      {
+        out += path_;
+        if (!has_query && has_query_)
+        {
+          query = query_;
+          has_query = true;
+        }
+      }
+      else if (r[0] == '/')
+        out += remove_dot_segments(r);
+      else if (has_authority_ && path_.empty())
+        out += remove_dot_segments("/" + r);
+      else
+      {
+        std::string::size_type slash = path_.rfind('/');
+        std::string merged = (slash == std::string::npos) ? r : path_.substr(0, slash + 1) + r;
+        out += remove_dot_segments(merged);
+      }
+    }
+
+    if (has_query)
+      out += "?" + query;
+    out += fragment;
+  }
+
+private:
+  std::string scheme_;
+  std::string authority_;
+  std::string path_;
+  std::string query_;
+  bool has_authority_;
+  bool has_query_;
+};
+
+//----------------------------------------------------------------------
+// The base IRI of a document named name: the name itself if it is an
+// IRI, and a file: IRI otherwise.
+//----------------------------------------------------------------------
+inline std::string document_base(std::string const& name)
+{
+  if (scheme_length(name.data(), name.size()) > 1)
+    return name;
+  if (!name.empty() && name[0] == '/')
+    return "file://" + name;
+
+  char cwd[4096];
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    return "file:///" + name;
+  return "file://" + std::string(cwd) + "/" + name;
+}
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,1774 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains a native JSON-LD parser. raptor cannot read JSON-LD
+// at all, and more and more of the linked data we crawl is served as
+// JSON-LD, so the documents are turned into triples here and handed to
+// the same converters the other parsers use.
+//
+// Parsing happens in two stages. The first finds every structural
+// character of the document, 64 bytes at a time, without branching on
+// the input: quotes are matched (minding escapes) with a few bit
+// operations, and the characters inside strings masked out. The second
+// walks that index to build a flat tree of the document, whose strings
+// are left where they are in the input.
+//
+// Triples are then produced straight from the tree. Most documents are
+// compacted against a well-known remote context; remote contexts are
+// processed once and kept in a jsonld_context_cache shared by every
+// parse, so for those documents expanding a key is one table lookup.
+//===========================================================================
+
+#ifndef BST_JSONLD_PARSER_HPP_
+#define BST_JSONLD_PARSER_HPP_
+
+#include "rdf_parser.hpp"
+#include "ntriples_parser.hpp"
+#include "term_id.hpp"
+#include "term_validation.hpp"
+#include "vocabulary.hpp"
+#include "iri_resolution.hpp"
+#include "file_reader.hpp"
+
+#include <unordered_map>
+#include <functional>
+#include <stdexcept>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <utility>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__PCLMUL__)
+#include <wmmintrin.h>
+#endif
+
+namespace rdf {
+
+//===========================================================================
+// Thrown for documents that are not well-formed JSON, or not JSON-LD the
+// parser can make sense of.
+//===========================================================================
+struct jsonld_error : std::domain_error
+{
+  explicit jsonld_error(std::string const& what)
+    : std::domain_error(what)
+  {}
+};
+
+namespace {
+
+//----------------------------------------------------------------------
+// The characters of one 64-byte block the structural index cares about.
+//----------------------------------------------------------------------
+struct json_block_masks
+{
+  std::uint64_t quote;
+  std::uint64_t backslash;
+  std::uint64_t op;
+  std::uint64_t space;
+};
+
+inline void json_classify_scalar(char const* p, json_block_masks& m)
+{
+  m.quote = m.backslash = m.op = m.space = 0;
+  for (unsigned i = 0; i < 64; ++i)
+  {
+    std::uint64_t bit = std::uint64_t(1) << i;
+    switch (p[i])
+    {
+    case '"':  m.quote |= bit; break;
+    case '\\': m.backslash |= bit; break;
+    case '{': case '}': case '[': case ']': case ':': case ',':
+      m.op |= bit;
+      break;
+    case ' ': case '\t': case '\n': case '\r':
+      m.space |= bit;
+      break;
+    }
+  }
+}
+
+#if defined(__SSE2__)
+
+inline void json_classify_64(char const* p, json_block_masks& m)
+{
+  m.quote = m.backslash = m.op = m.space = 0;
+  for (unsigned k = 0; k < 4; ++k)
+  {
+    __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + 16 * k));
+    __m128i op = _mm_cmpeq_epi8(b, _mm_set1_epi8('{'));
+    op = _mm_or_si128(op, _mm_cmpeq_epi8(b, _mm_set1_epi8('}')));
+    op = _mm_or_si128(op, _mm_cmpeq_epi8(b, _mm_set1_epi8('[')));
+    op = _mm_or_si128(op, _mm_cmpeq_epi8(b, _mm_set1_epi8(']')));
+    op = _mm_or_si128(op, _mm_cmpeq_epi8(b, _mm_set1_epi8(':')));
+    op = _mm_or_si128(op, _mm_cmpeq_epi8(b, _mm_set1_epi8(',')));
+    __m128i space = _mm_cmpeq_epi8(b, _mm_set1_epi8(' '));
+    space = _mm_or_si128(space, _mm_cmpeq_epi8(b, _mm_set1_epi8('\t')));
+    space = _mm_or_si128(space, _mm_cmpeq_epi8(b, _mm_set1_epi8('\n')));
+    space = _mm_or_si128(space, _mm_cmpeq_epi8(b, _mm_set1_epi8('\r')));
+
+    unsigned shift = 16 * k;
+    m.quote |= std::uint64_t(static_cast<unsigned>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(b, _mm_set1_epi8('"'))))) << shift;
+    m.backslash |= std::uint64_t(static_cast<unsigned>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(b, _mm_set1_epi8('\\'))))) << shift;
+    m.op |= std::uint64_t(static_cast<unsigned>(_mm_movemask_epi8(op))) << shift;
+    m.space |= std::uint64_t(static_cast<unsigned>(_mm_movemask_epi8(space))) << shift;
+  }
+}
+
+#else
+
+inline void json_classify_64(char const* p, json_block_masks& m)
+{
+  json_classify_scalar(p, m);
+}
+
+#endif
+
+//----------------------------------------------------------------------
+// Bit i of the result is the xor of bits 0..i of x: given the quotes of a
+// block, the bytes from each opening quote up to its closing one.
+//----------------------------------------------------------------------
+inline std::uint64_t prefix_xor(std::uint64_t x)
+{
+#if defined(__PCLMUL__)
+  __m128i r = _mm_clmulepi64_si128(
+    _mm_set_epi64x(0, static_cast<long long>(x)), _mm_set1_epi8(char(0xFF)), 0);
+  return static_cast<std::uint64_t>(_mm_cvtsi128_si64(r));
+#else
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+#endif
+}
+
+} // namespace
+
+//===========================================================================
+// The structural index of a JSON text: the positions of every { } [ ] : ,
+// outside strings, of every opening quote, and of the first character of
+// every other scalar, in order.
+//===========================================================================
+class json_index
+{
+public:
+  void build(char const* text, std::size_t size)
+  {
+    if (size >= 0xFFFFFFFFu)
+      throw jsonld_error("document too large");
+
+    positions_.clear();
+    positions_.reserve(size / 8);
+
+    const std::uint64_t odd_bits = 0xAAAAAAAAAAAAAAAAull;
+    std::uint64_t next_escaped = 0;
+    std::uint64_t prev_in_string = 0;
+    std::uint64_t prev_scalar = 0;
+
+    for (std::size_t base = 0; base < size; base += 64)
+    {
+      json_block_masks m;
+      if (size - base >= 64)
+        json_classify_64(text + base, m);
+      else
+      {
+        // The last block is padded with spaces, which never index.
+        char block[64];
+        std::memset(block, ' ', sizeof(block));
+        std::memcpy(block, text + base, size - base);
+        json_classify_64(block, m);
+      }
+
+      // Which bytes are escaped: the byte after each backslash that is
+      // itself not escaped.
+      std::uint64_t escaped;
+      if (m.backslash == 0)
+      {
+        escaped = next_escaped;
+        next_escaped = 0;
+      }
+      else
+      {
+        std::uint64_t potential = m.backslash & ~next_escaped;
+        std::uint64_t codes = (((potential << 1) | odd_bits) - potential) ^ odd_bits;
+        escaped = codes ^ (m.backslash | next_escaped);
+        next_escaped = (codes & m.backslash) >> 63;
+      }
+
+      std::uint64_t quote = m.quote & ~escaped;
+      std::uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+      prev_in_string = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+
+      std::uint64_t scalar = ~(m.op | m.space | quote | in_string);
+      std::uint64_t scalar_starts = scalar & ~((scalar << 1) | prev_scalar);
+      prev_scalar = scalar >> 63;
+
+      std::uint64_t bits = (m.op & ~in_string) | (quote & in_string) | scalar_starts;
+      while (bits != 0)
+      {
+        positions_.push_back(static_cast<std::uint32_t>(base + __builtin_ctzll(bits)));
+        bits &= bits - 1;
+      }
+    }
+
+    if (prev_in_string != 0)
+      throw jsonld_error("unterminated string");
+    positions_.push_back(static_cast<std::uint32_t>(size));
+  }
+
+  std::vector<std::uint32_t> const& positions() const { return positions_; }
+
+private:
+  std::vector<std::uint32_t> positions_;
+};
+
+//===========================================================================
+// A JSON document as a flat tree. An object's first child is its first
+// key, and each key's first child is its value; an array's first child
+// is its first element. Siblings are chained through next. Strings and
+// numbers are ranges of the text, which must outlive the document.
+//===========================================================================
+enum json_type
+{
+  json_null, json_true, json_false, json_number, json_string, json_array, json_object
+};
+
+const std::uint32_t json_none = 0xFFFFFFFFu;
+
+struct json_node
+{
+  json_type type;
+  std::uint32_t begin;
+  std::uint32_t end;
+  std::uint32_t first;
+  std::uint32_t next;
+};
+
+class json_document
+{
+public:
+  json_document()
+    : text_(NULL), size_(0)
+  {}
+
+  void parse(char const* text, std::size_t size)
+  {
+    text_ = text;
+    size_ = size;
+    nodes_.clear();
+    index_.build(text, size);
+
+    std::vector<std::uint32_t> const& pos = index_.positions();
+    if (pos.size() < 2)
+      throw jsonld_error("empty document");
+    nodes_.reserve(pos.size());
+
+    std::size_t k = 0;
+    parse_value(k, 0);
+    if (pos[k] != size)
+      throw jsonld_error(where("unexpected text after the document", pos[k]));
+  }
+
+  json_node const& operator[](std::uint32_t i) const { return nodes_[i]; }
+  std::uint32_t root() const { return 0; }
+  char const* text() const { return text_; }
+
+  //----------------------------------------------------------------------
+  // Whether a string node is exactly s (without decoding escapes, which
+  // keywords never need).
+  //----------------------------------------------------------------------
+  bool equals(std::uint32_t i, char const* s) const
+  {
+    json_node const& n = nodes_[i];
+    std::size_t len = std::strlen(s);
+    return n.type == json_string && n.end - n.begin == len
+      && std::memcmp(text_ + n.begin, s, len) == 0;
+  }
+
+  //----------------------------------------------------------------------
+  // The value of the member of an object with the given key, or
+  // json_none.
+  //----------------------------------------------------------------------
+  std::uint32_t member(std::uint32_t object, char const* key) const
+  {
+    if (nodes_[object].type != json_object)
+      return json_none;
+    for (std::uint32_t k = nodes_[object].first; k != json_none; k = nodes_[k].next)
+      if (equals(k, key))
+        return nodes_[k].first;
+    return json_none;
+  }
+
+  std::string where(char const* what, std::size_t offset) const
+  {
+    return std::string(what) + " at byte " + std::to_string(offset);
+  }
+
+private:
+  std::uint32_t add(json_type type, std::uint32_t begin, std::uint32_t end)
+  {
+    json_node n = { type, begin, end, json_none, json_none };
+    nodes_.push_back(n);
+    return static_cast<std::uint32_t>(nodes_.size() - 1);
+  }
+
+  //----------------------------------------------------------------------
+  // Where the token at index entry k ends: just before the next entry,
+  // less any whitespace.
+  //----------------------------------------------------------------------
+  std::uint32_t token_end(std::size_t k) const
+  {
+    std::uint32_t e = index_.positions()[k + 1];
+    while (e > index_.positions()[k]
+           && (text_[e - 1] == ' ' || text_[e - 1] == '\t'
+               || text_[e - 1] == '\n' || text_[e - 1] == '\r'))
+      --e;
+    return e;
+  }
+
+  std::uint32_t parse_string(std::size_t& k)
+  {
+    std::uint32_t begin = index_.positions()[k];
+    std::uint32_t end = token_end(k);
+    if (end < begin + 2 || text_[end - 1] != '"')
+      throw jsonld_error(where("bad string", begin));
+    ++k;
+    return add(json_string, begin + 1, end - 1);
+  }
+
+  std::uint32_t parse_value(std::size_t& k, unsigned depth)
+  {
+    std::vector<std::uint32_t> const& pos = index_.positions();
+    if (depth > max_depth)
+      throw jsonld_error("document nested too deeply");
+    if (pos[k] == size_)
+      throw jsonld_error("unexpected end of document");
+
+    std::uint32_t at = pos[k];
+    switch (text_[at])
+    {
+    case '{':
+    {
+      std::uint32_t object = add(json_object, at, at);
+      ++k;
+      if (pos[k] != size_ && text_[pos[k]] == '}')
+      {
+        ++k;
+        return object;
+      }
+
+      std::uint32_t last = json_none;
+      for (;;)
+      {
+        if (pos[k] == size_ || text_[pos[k]] != '"')
+          throw jsonld_error(where("expected a key", pos[k]));
+        std::uint32_t key = parse_string(k);
+        if (pos[k] == size_ || text_[pos[k]] != ':')
+          throw jsonld_error(where("expected ':'", pos[k]));
+        ++k;
+        std::uint32_t value = parse_value(k, depth + 1);
+        nodes_[key].first = value;
+
+        if (last == json_none)
+          nodes_[object].first = key;
+        else
+          nodes_[last].next = key;
+        last = key;
+
+        if (pos[k] != size_ && text_[pos[k]] == ',')
+          ++k;
+        else if (pos[k] != size_ && text_[pos[k]] == '}')
+        {
+          ++k;
+          return object;
+        }
+        else
+          throw jsonld_error(where("expected ',' or '}'", pos[k]));
+      }
+    }
+
+    case '[':
+    {
+      std::uint32_t array = add(json_array, at, at);
+      ++k;
+      if (pos[k] != size_ && text_[pos[k]] == ']')
+      {
+        ++k;
+        return array;
+      }
+
+      std::uint32_t last = json_none;
+      for (;;)
+      {
+        std::uint32_t value = parse_value(k, depth + 1);
+        if (last == json_none)
+          nodes_[array].first = value;
+        else
+          nodes_[last].next = value;
+        last = value;
+
+        if (pos[k] != size_ && text_[pos[k]] == ',')
+          ++k;
+        else if (pos[k] != size_ && text_[pos[k]] == ']')
+        {
+          ++k;
+          return array;
+        }
+        else
+          throw jsonld_error(where("expected ',' or ']'", pos[k]));
+      }
+    }
+
+    case '"':
+      return parse_string(k);
+
+    default:
+    {
+      std::uint32_t end = token_end(k);
+      ++k;
+      std::size_t n = end - at;
+      char const* t = text_ + at;
+      if (n == 4 && std::memcmp(t, "true", 4) == 0)
+        return add(json_true, at, end);
+      if (n == 5 && std::memcmp(t, "false", 5) == 0)
+        return add(json_false, at, end);
+      if (n == 4 && std::memcmp(t, "null", 4) == 0)
+        return add(json_null, at, end);
+      if (!is_number(t, n))
+        throw jsonld_error(where("bad value", at));
+      return add(json_number, at, end);
+    }
+    }
+  }
+
+  static bool is_number(char const* t, std::size_t n)
+  {
+    std::size_t i = 0;
+    if (i < n && t[i] == '-')
+      ++i;
+    std::size_t digits = i;
+    while (i < n && t[i] >= '0' && t[i] <= '9')
+      ++i;
+    if (i == digits)
+      return false;
+    if (i < n && t[i] == '.')
+    {
+      std::size_t fraction = ++i;
+      while (i < n && t[i] >= '0' && t[i] <= '9')
+        ++i;
+      if (i == fraction)
+        return false;
+    }
+    if (i < n && (t[i] == 'e' || t[i] == 'E'))
+    {
+      ++i;
+      if (i < n && (t[i] == '+' || t[i] == '-'))
+        ++i;
+      std::size_t exponent = i;
+      while (i < n && t[i] >= '0' && t[i] <= '9')
+        ++i;
+      if (i == exponent)
+        return false;
+    }
+    return i == n;
+  }
+
+  static const unsigned max_depth = 512;
+
+  char const* text_;
+  std::size_t size_;
+  json_index index_;
+  std::vector<json_node> nodes_;
+};
+
+namespace {
+
+//----------------------------------------------------------------------
+// Decode the escapes of a JSON string into out, which must have room for
+// end - p bytes. Returns the decoded size, or -1.
+//----------------------------------------------------------------------
+inline std::ptrdiff_t json_unescape(char const* p, char const* end, char* out)
+{
+  char* o = out;
+  while (p < end)
+  {
+    if (*p != '\\')
+    {
+      *o++ = *p++;
+      continue;
+    }
+    if (++p == end)
+      return -1;
+
+    switch (*p++)
+    {
+    case '"':  *o++ = '"';  break;
+    case '\\': *o++ = '\\'; break;
+    case '/':  *o++ = '/';  break;
+    case 'b':  *o++ = '\b'; break;
+    case 'f':  *o++ = '\f'; break;
+    case 'n':  *o++ = '\n'; break;
+    case 'r':  *o++ = '\r'; break;
+    case 't':  *o++ = '\t'; break;
+    case 'u':
+    {
+      std::uint32_t cp = 0;
+      for (int pass = 0; pass < 2; ++pass)
+      {
+        if (end - p < 4)
+          return -1;
+        std::uint32_t unit = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+          int h = hex_value(*p++);
+          if (h < 0)
+            return -1;
+          unit = (unit << 4) | static_cast<std::uint32_t>(h);
+        }
+
+        if (pass == 0 && unit >= 0xD800 && unit <= 0xDBFF)
+        {
+          // A high surrogate must be followed by an escaped low one.
+          if (end - p < 6 || p[0] != '\\' || p[1] != 'u')
+            return -1;
+          p += 2;
+          cp = unit;
+          continue;
+        }
+        if (pass == 1)
+        {
+          if (unit < 0xDC00 || unit > 0xDFFF)
+            return -1;
+          unit = 0x10000 + ((cp - 0xD800) << 10) + (unit - 0xDC00);
+        }
+        cp = unit;
+        break;
+      }
+      o += encode_utf8(cp, o);
+      break;
+    }
+    default:
+      return -1;
+    }
+  }
+  return o - out;
+}
+
+//----------------------------------------------------------------------
+// The canonical lexical form of an xsd:double, as JSON-LD wants numbers
+// with a fraction or exponent written: 1.5E0, 1.0E10.
+//----------------------------------------------------------------------
+inline std::string canonical_double(char const* text, std::size_t size)
+{
+  double d = std::strtod(std::string(text, size).c_str(), NULL);
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), "%.15E", d);
+
+  std::string s(buffer);
+  std::string::size_type e = s.find('E');
+  std::string mantissa = s.substr(0, e);
+  int exponent = std::atoi(s.c_str() + e + 1);
+
+  std::string::size_type last = mantissa.find_last_not_of('0');
+  if (mantissa[last] == '.')
+    ++last;
+  mantissa.erase(last + 1);
+  return mantissa + "E" + std::to_string(exponent);
+}
+
+} // namespace
+
+//===========================================================================
+// A processed JSON-LD context: what each term expands to, and how values
+// of the property it names are to be read.
+//===========================================================================
+struct jsonld_term_definition
+{
+  enum coercion_type { no_coercion, id_coercion, vocab_coercion, datatype_coercion };
+
+  jsonld_term_definition()
+    : null_mapping(false), coercion(no_coercion), has_language(false), list(false), reverse(false)
+  {}
+
+  std::string iri;
+  bool null_mapping;
+  coercion_type coercion;
+  std::string datatype;
+  std::string language;  // empty with has_language for "@language": null
+  bool has_language;
+  bool list;
+  bool reverse;
+};
+
+struct jsonld_context
+{
+  jsonld_context()
+    : has_vocab(false), has_language(false), has_base(false), null_base(false)
+  {}
+
+  bool empty() const { return terms.empty() && !has_vocab && !has_language && !has_base; }
+
+  //----------------------------------------------------------------------
+  // The base relative IRIs resolve against: the context's own @base if
+  // it has one, the document's otherwise. NULL after "@base": null.
+  //----------------------------------------------------------------------
+  base_iri const* base_for(base_iri const* document_base) const
+  {
+    if (!has_base)
+      return document_base;
+    return null_base ? NULL : &base;
+  }
+
+  jsonld_term_definition const* find(char const* s, std::size_t n) const
+  {
+    if (terms.empty())
+      return NULL;
+    std::unordered_map<std::string, jsonld_term_definition>::const_iterator i =
+      terms.find(std::string(s, n));
+    return i == terms.end() ? NULL : &i->second;
+  }
+
+  std::unordered_map<std::string, jsonld_term_definition> terms;
+  std::string vocab;
+  bool has_vocab;
+  std::string language;
+  bool has_language;
+  // Only what @base sets. The document's own base is kept by whoever
+  // processes the document, so contexts can be shared between documents.
+  base_iri base;
+  bool has_base;
+  bool null_base;
+};
+
+typedef std::shared_ptr<jsonld_context const> jsonld_context_ptr;
+
+//===========================================================================
+// Remote contexts, fetched and processed once and then shared by every
+// document that refers to them. Contexts may be added up front, or
+// fetched on demand by a loader:
+//
+//   loader(url, document) -> bool
+//
+// which stores the text of the context document and returns true. With
+// no loader, a context that was not added is an error. Thread-safe.
+//===========================================================================
+class jsonld_context_cache
+{
+public:
+  typedef std::function<bool(std::string const&, std::string&)> loader_type;
+
+  explicit jsonld_context_cache(loader_type loader = loader_type())
+    : loader_(loader)
+  {}
+
+  //----------------------------------------------------------------------
+  // Process a context document and keep it under url. Throws jsonld_error
+  // if it cannot be processed.
+  //----------------------------------------------------------------------
+  void add(std::string const& url, std::string const& document)
+  {
+    jsonld_context_ptr context = load(url, document, 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    contexts_[url] = context;
+  }
+
+  jsonld_context_ptr get(std::string const& url, unsigned depth = 0)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::unordered_map<std::string, jsonld_context_ptr>::const_iterator i = contexts_.find(url);
+      if (i != contexts_.end())
+        return i->second;
+    }
+
+    std::string document;
+    if (!loader_ || !loader_(url, document))
+      throw jsonld_error("remote context not available: " + url);
+
+    jsonld_context_ptr context = load(url, document, depth);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return contexts_.insert(std::make_pair(url, context)).first->second;
+  }
+
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return contexts_.size();
+  }
+
+private:
+  jsonld_context_ptr load(std::string const& url, std::string const& document, unsigned depth);
+
+  loader_type loader_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, jsonld_context_ptr> contexts_;
+};
+
+namespace {
+
+//----------------------------------------------------------------------
+// Expand a term, compact IRI or relative IRI (RFC 3986 and JSON-LD's IRI
+// expansion). vocab says whether terms and @vocab apply, as they do for
+// keys and types; relative says whether to resolve against the base,
+// which is document_base unless the context has an @base. Returns false
+// for things that expand to nothing, which are dropped.
+//----------------------------------------------------------------------
+inline bool expand_iri(
+  jsonld_context const& ctx, base_iri const* document_base,
+  char const* s, std::size_t n, bool vocab, bool relative,
+  term_arena& arena, term_view& out)
+{
+  if (n != 0 && s[0] == '@')
+  {
+    out = term_view(uri_term, s, n);
+    return true;
+  }
+
+  if (vocab)
+  {
+    if (jsonld_term_definition const* def = ctx.find(s, n))
+    {
+      if (def->null_mapping)
+        return false;
+      out = term_view(uri_term, def->iri.data(), def->iri.size());
+      return true;
+    }
+  }
+
+  char const* colon = static_cast<char const*>(std::memchr(s, ':', n));
+  if (colon != NULL)
+  {
+    std::size_t prefix = colon - s;
+    if (prefix == 1 && s[0] == '_')
+    {
+      // Generated labels are genid- followed by digits only; a document
+      // label starting with genid- gets another one in front, so the two
+      // can never meet.
+      if (n >= 8 && std::memcmp(s + 2, "genid-", 6) == 0)
+      {
+        char* label = arena.allocate(n + 4);
+        std::memcpy(label, "genid-", 6);
+        std::memcpy(label + 6, s + 2, n - 2);
+        out = term_view(blank_term, label, n + 4);
+      }
+      else
+        out = term_view(blank_term, s + 2, n - 2);
+      return true;
+    }
+    if (n - prefix < 3 || colon[1] != '/' || colon[2] != '/')
+    {
+      if (jsonld_term_definition const* def = ctx.find(s, prefix))
+      {
+        if (!def->null_mapping)
+        {
+          std::size_t size = def->iri.size() + n - prefix - 1;
+          char* buffer = arena.allocate(size);
+          std::memcpy(buffer, def->iri.data(), def->iri.size());
+          std::memcpy(buffer + def->iri.size(), colon + 1, n - prefix - 1);
+          out = term_view(uri_term, buffer, size);
+          return true;
+        }
+      }
+    }
+    if (scheme_length(s, n) != 0)
+    {
+      out = term_view(uri_term, s, n);
+      return true;
+    }
+  }
+
+  if (vocab && ctx.has_vocab)
+  {
+    char* buffer = arena.allocate(ctx.vocab.size() + n);
+    std::memcpy(buffer, ctx.vocab.data(), ctx.vocab.size());
+    std::memcpy(buffer + ctx.vocab.size(), s, n);
+    out = term_view(uri_term, buffer, ctx.vocab.size() + n);
+    return true;
+  }
+
+  base_iri const* base = relative ? ctx.base_for(document_base) : NULL;
+  if (base != NULL)
+  {
+    std::string resolved;
+    base->resolve(s, n, resolved);
+    char* buffer = arena.allocate(resolved.size());
+    std::memcpy(buffer, resolved.data(), resolved.size());
+    out = term_view(uri_term, buffer, resolved.size());
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------
+// The decoded value of a string node: a view of the text itself unless
+// it has escapes, in which case it is decoded into the arena.
+//----------------------------------------------------------------------
+inline void json_string_value(
+  json_document const& doc, std::uint32_t i, term_arena& arena,
+  char const*& data, std::size_t& size)
+{
+  json_node const& n = doc[i];
+  data = doc.text() + n.begin;
+  size = n.end - n.begin;
+
+  if (std::memchr(data, '\\', size) != NULL)
+  {
+    char* buffer = arena.allocate(size);
+    std::ptrdiff_t decoded = json_unescape(data, data + size, buffer);
+    if (decoded < 0)
+      throw jsonld_error(doc.where("bad escape", n.begin));
+    data = buffer;
+    size = static_cast<std::size_t>(decoded);
+  }
+  if (!validate_utf8(data, size))
+    throw jsonld_error(doc.where("bad UTF-8", n.begin));
+}
+
+inline std::string json_string_copy(json_document const& doc, std::uint32_t i, term_arena& arena)
+{
+  if (doc[i].type != json_string)
+    throw jsonld_error(doc.where("expected a string", doc[i].begin));
+  char const* data;
+  std::size_t size;
+  json_string_value(doc, i, arena, data, size);
+  return std::string(data, size);
+}
+
+//----------------------------------------------------------------------
+// JSON-LD's context processing, for the parts of it that bear on the
+// triples a document produces: term definitions with @id, @reverse,
+// @type coercion, @language and @list containers, and the context's
+// @vocab, @language and @base. The JSON-LD 1.1 protection and scoping
+// features are not needed for that and are ignored.
+//----------------------------------------------------------------------
+class context_processor
+{
+public:
+  context_processor(json_document const& doc, jsonld_context_cache& cache,
+                    term_arena& arena, base_iri const* document_base, unsigned depth)
+    : doc_(doc), cache_(cache), arena_(arena), document_base_(document_base), depth_(depth)
+  {}
+
+  jsonld_context_ptr process(jsonld_context_ptr active, std::uint32_t node)
+  {
+    json_node const& n = doc_[node];
+    switch (n.type)
+    {
+    case json_null:
+      // Back to the initial context, whose base is the document's.
+      return std::make_shared<jsonld_context>();
+
+    case json_array:
+      for (std::uint32_t k = n.first; k != json_none; k = doc_[k].next)
+        active = process(active, k);
+      return active;
+
+    case json_string:
+    {
+      if (depth_ > max_remote_depth)
+        throw jsonld_error("remote contexts nested too deeply");
+
+      std::string url = json_string_copy(doc_, node, arena_);
+      base_iri const* base = active->base_for(document_base_);
+      if (base != NULL && scheme_length(url.data(), url.size()) == 0)
+      {
+        std::string resolved;
+        base->resolve(url.data(), url.size(), resolved);
+        url = resolved;
+      }
+
+      // The common case, a document whose only context is a remote one,
+      // takes the cached context as it is.
+      jsonld_context_ptr remote = cache_.get(url, depth_ + 1);
+      if (active->empty())
+        return remote;
+
+      std::shared_ptr<jsonld_context> merged = std::make_shared<jsonld_context>(*active);
+      for (std::unordered_map<std::string, jsonld_term_definition>::const_iterator
+             i = remote->terms.begin(); i != remote->terms.end(); ++i)
+        merged->terms[i->first] = i->second;
+      if (remote->has_vocab)
+      {
+        merged->vocab = remote->vocab;
+        merged->has_vocab = true;
+      }
+      if (remote->has_language)
+      {
+        merged->language = remote->language;
+        merged->has_language = true;
+      }
+      return merged;
+    }
+
+    case json_object:
+      return define_all(active, node);
+
+    default:
+      throw jsonld_error(doc_.where("bad @context", n.begin));
+    }
+  }
+
+private:
+  jsonld_context_ptr define_all(jsonld_context_ptr active, std::uint32_t object)
+  {
+    result_ = std::make_shared<jsonld_context>(*active);
+    local_ = object;
+    defined_.clear();
+
+    std::uint32_t base = doc_.member(object, "@base");
+    if (base != json_none)
+    {
+      result_->has_base = true;
+      result_->null_base = doc_[base].type == json_null;
+      if (!result_->null_base)
+      {
+        std::string iri = json_string_copy(doc_, base, arena_);
+        base_iri const* current = active->base_for(document_base_);
+        if (current != NULL && scheme_length(iri.data(), iri.size()) == 0)
+        {
+          std::string resolved;
+          current->resolve(iri.data(), iri.size(), resolved);
+          iri = resolved;
+        }
+        result_->base = base_iri(iri);
+      }
+    }
+
+    std::uint32_t vocab = doc_.member(object, "@vocab");
+    if (vocab != json_none)
+    {
+      if (doc_[vocab].type == json_null)
+        result_->has_vocab = false;
+      else
+      {
+        std::string iri = json_string_copy(doc_, vocab, arena_);
+        term_view v;
+        if (!expand_iri(*result_, document_base_, iri.data(), iri.size(), true, true, arena_, v))
+          throw jsonld_error("bad @vocab");
+        result_->vocab = v.value();
+        result_->has_vocab = true;
+      }
+    }
+
+    std::uint32_t language = doc_.member(object, "@language");
+    if (language != json_none)
+    {
+      result_->has_language = doc_[language].type != json_null;
+      result_->language = result_->has_language ? json_string_copy(doc_, language, arena_) : "";
+    }
+
+    for (std::uint32_t k = doc_[object].first; k != json_none; k = doc_[k].next)
+    {
+      std::string term = json_string_copy(doc_, k, arena_);
+      if (term.empty() || term[0] != '@')
+        define(term);
+    }
+    return result_;
+  }
+
+  //----------------------------------------------------------------------
+  // Create the definition of one term of the local context, first
+  // defining any other term of it that the definition refers to.
+  //----------------------------------------------------------------------
+  void define(std::string const& term)
+  {
+    std::unordered_map<std::string, bool>::iterator state = defined_.find(term);
+    if (state != defined_.end())
+    {
+      if (!state->second)
+        throw jsonld_error("cyclic term definition: " + term);
+      return;
+    }
+
+    std::uint32_t value = member(term);
+    if (value == json_none)
+      return;
+    defined_[term] = false;
+
+    jsonld_term_definition def;
+    json_node const& v = doc_[value];
+    bool has_id = false;
+
+    if (v.type == json_null)
+    {
+      def.null_mapping = true;
+      has_id = true;
+    }
+    else if (v.type == json_string)
+    {
+      def.null_mapping = !expand_reference(json_string_copy(doc_, value, arena_), def.iri);
+      has_id = true;
+    }
+    else if (v.type == json_object)
+    {
+      std::uint32_t id = doc_.member(value, "@id");
+      std::uint32_t reverse = doc_.member(value, "@reverse");
+      if (reverse != json_none)
+      {
+        def.reverse = true;
+        def.null_mapping = !expand_reference(json_string_copy(doc_, reverse, arena_), def.iri);
+        has_id = true;
+      }
+      else if (id != json_none)
+      {
+        if (doc_[id].type == json_null)
+          def.null_mapping = true;
+        else
+          def.null_mapping = !expand_reference(json_string_copy(doc_, id, arena_), def.iri);
+        has_id = true;
+      }
+
+      std::uint32_t type = doc_.member(value, "@type");
+      if (type != json_none)
+      {
+        std::string t = json_string_copy(doc_, type, arena_);
+        if (t == "@id")
+          def.coercion = jsonld_term_definition::id_coercion;
+        else if (t == "@vocab")
+          def.coercion = jsonld_term_definition::vocab_coercion;
+        else if (expand_reference(t, def.datatype))
+          def.coercion = jsonld_term_definition::datatype_coercion;
+      }
+
+      std::uint32_t language = doc_.member(value, "@language");
+      if (language != json_none)
+      {
+        def.has_language = true;
+        if (doc_[language].type != json_null)
+          def.language = json_string_copy(doc_, language, arena_);
+      }
+
+      std::uint32_t container = doc_.member(value, "@container");
+      if (container != json_none)
+      {
+        if (doc_[container].type == json_array)
+        {
+          for (std::uint32_t k = doc_[container].first; k != json_none; k = doc_[k].next)
+            if (doc_.equals(k, "@list"))
+              def.list = true;
+        }
+        else
+          def.list = doc_.equals(container, "@list");
+      }
+    }
+    else
+      throw jsonld_error(doc_.where("bad term definition", v.begin));
+
+    if (!has_id)
+      def.null_mapping = !expand_reference(term, def.iri, false);
+
+    result_->terms[term] = def;
+    defined_[term] = true;
+  }
+
+  //----------------------------------------------------------------------
+  // Expand an IRI in a definition, defining what it depends on first.
+  //----------------------------------------------------------------------
+  bool expand_reference(std::string const& value, std::string& out, bool allow_term = true)
+  {
+    if (!value.empty() && value[0] == '@')
+    {
+      out = value;
+      return true;
+    }
+
+    std::string::size_type colon = value.find(':');
+    if (colon != std::string::npos)
+      define(value.substr(0, colon));
+    else if (allow_term)
+      define(value);
+
+    term_view v;
+    if (!expand_iri(*result_, document_base_, value.data(), value.size(),
+                    allow_term || colon == std::string::npos, false, arena_, v))
+      return false;
+    out = v.value();
+    return true;
+  }
+
+  std::uint32_t member(std::string const& key) const
+  {
+    for (std::uint32_t k = doc_[local_].first; k != json_none; k = doc_[k].next)
+    {
+      json_node const& n = doc_[k];
+      if (n.end - n.begin == key.size()
+          && std::memcmp(doc_.text() + n.begin, key.data(), key.size()) == 0)
+        return n.first;
+    }
+    return json_none;
+  }
+
+  static const unsigned max_remote_depth = 8;
+
+  json_document const& doc_;
+  jsonld_context_cache& cache_;
+  term_arena& arena_;
+  base_iri const* document_base_;
+  unsigned depth_;
+
+  std::shared_ptr<jsonld_context> result_;
+  std::uint32_t local_;
+  std::unordered_map<std::string, bool> defined_;
+};
+
+} // namespace
+
+inline jsonld_context_ptr jsonld_context_cache::load(
+  std::string const& url, std::string const& document, unsigned depth)
+{
+  json_document doc;
+  doc.parse(document.data(), document.size());
+
+  std::uint32_t context = doc.member(doc.root(), "@context");
+  if (context == json_none)
+    throw jsonld_error("no @context in remote context " + url);
+
+  // Relative IRIs in the context resolve against its own URL, but that
+  // is not a base documents using the context get: the processed context
+  // carries no base, and JSON-LD ignores @base in remote contexts.
+  base_iri context_base(url);
+  term_arena arena;
+  context_processor processor(doc, *this, arena, &context_base, depth);
+  jsonld_context_ptr result = processor.process(std::make_shared<jsonld_context>(), context);
+  if (!result->has_base)
+    return result;
+
+  std::shared_ptr<jsonld_context> without_base = std::make_shared<jsonld_context>(*result);
+  without_base->has_base = false;
+  without_base->null_base = false;
+  without_base->base = base_iri();
+  return without_base;
+}
+
+//===========================================================================
+// Turns one parsed JSON-LD document into triples, node object by node
+// object, following JSON-LD's expansion and RDF serialization
+// algorithms without building the expanded document. Graph names are
+// not kept, as with N-Quads.
+//===========================================================================
+template <typename Iter, typename Converter>
+class jsonld_emitter
+{
+public:
+  jsonld_emitter(json_document const& doc, std::string const& name,
+                 jsonld_context_cache& cache, Iter dest, Converter conv)
+    : doc_(doc), cache_(cache), dest_(dest), conv_(conv), blank_count_(0),
+      base_(document_base(name)), initial_(std::make_shared<jsonld_context>()),
+      last_context_(NULL), last_context_size_(0)
+  {
+    rdf_type_ = vocabulary_view(vocab::rdf_type);
+    rdf_first_ = vocabulary_view(vocab::rdf_first);
+    rdf_rest_ = vocabulary_view(vocab::rdf_rest);
+    rdf_nil_ = vocabulary_view(vocab::rdf_nil);
+  }
+
+  void run()
+  {
+    std::uint32_t root = doc_.root();
+    if (doc_[root].type == json_array)
+    {
+      for (std::uint32_t k = doc_[root].first; k != json_none; k = doc_[k].next)
+        top_level(initial_, k);
+    }
+    else
+      top_level(initial_, root);
+  }
+
+  Iter dest() const { return dest_; }
+
+private:
+  static term_view vocabulary_view(term_id id)
+  {
+    char const* iri = vocab::iri(id);
+    return term_view(uri_term, iri, std::strlen(iri));
+  }
+
+  void top_level(jsonld_context_ptr ctx, std::uint32_t node)
+  {
+    if (doc_[node].type != json_object)
+      return;
+    term_view subject;
+    node_object(ctx, node, subject);
+  }
+
+  //----------------------------------------------------------------------
+  // Emit the triples of a node object. Returns false if the object is
+  // only a wrapper around @graph and so is not a node itself.
+  //----------------------------------------------------------------------
+  bool node_object(jsonld_context_ptr ctx, std::uint32_t object, term_view& subject)
+  {
+    std::uint32_t context = doc_.member(object, "@context");
+    if (context != json_none)
+      ctx = process_context(ctx, context);
+
+    // The subject has to be known before any of the properties.
+    bool has_id = false;
+    bool has_properties = false;
+    std::uint32_t graph = json_none;
+
+    for (std::uint32_t k = doc_[object].first; k != json_none; k = doc_[k].next)
+    {
+      term_view key;
+      jsonld_term_definition const* def;
+      if (!expand_key(*ctx, k, key, def))
+        continue;
+      if (is_keyword(key, "@id"))
+      {
+        std::uint32_t id = doc_[k].first;
+        if (doc_[id].type != json_string)
+          throw jsonld_error(doc_.where("@id must be a string", doc_[id].begin));
+        char const* data;
+        std::size_t size;
+        json_string_value(doc_, id, arena_, data, size);
+        if (!expand_iri(*ctx, &base_, data, size, false, true, arena_, subject))
+          subject = new_blank();
+        has_id = true;
+      }
+      else if (is_keyword(key, "@graph"))
+        graph = doc_[k].first;
+      else if (key.size == 0 || key.data[0] != '@' || is_keyword(key, "@type")
+               || is_keyword(key, "@reverse") || is_keyword(key, "@nest"))
+        has_properties = true;
+    }
+
+    if (!has_id)
+      subject = new_blank();
+
+    if (graph != json_none)
+      for_each_item(graph, [this, &ctx](std::uint32_t item) {
+          if (doc_[item].type == json_object)
+          {
+            term_view s;
+            node_object(ctx, item, s);
+          }
+        });
+
+    properties(ctx, object, subject);
+    return has_properties || has_id || graph == json_none;
+  }
+
+  //----------------------------------------------------------------------
+  // Documents made of many node objects tend to repeat the same @context
+  // in each; the last one processed is remembered.
+  //----------------------------------------------------------------------
+  jsonld_context_ptr process_context(jsonld_context_ptr const& active, std::uint32_t context)
+  {
+    json_node const& n = doc_[context];
+    char const* text = doc_.text() + n.begin;
+    std::size_t size = n.end - n.begin;
+    bool memo = n.type == json_string;
+
+    if (memo && active == last_active_ && last_context_size_ == size
+        && std::memcmp(last_context_, text, size) == 0)
+      return last_result_;
+
+    context_processor processor(doc_, cache_, arena_, &base_, 0);
+    jsonld_context_ptr result = processor.process(active, context);
+    if (memo)
+    {
+      last_active_ = active;
+      last_context_ = text;
+      last_context_size_ = size;
+      last_result_ = result;
+    }
+    return result;
+  }
+
+  void properties(jsonld_context_ptr const& ctx, std::uint32_t object, term_view const& subject)
+  {
+    for (std::uint32_t k = doc_[object].first; k != json_none; k = doc_[k].next)
+    {
+      term_view key;
+      jsonld_term_definition const* def;
+      if (!expand_key(*ctx, k, key, def))
+        continue;
+      std::uint32_t value = doc_[k].first;
+
+      if (key.size != 0 && key.data[0] == '@')
+      {
+        if (is_keyword(key, "@type"))
+          types(ctx, subject, value);
+        else if (is_keyword(key, "@reverse"))
+          reverse_properties(ctx, subject, value);
+        else if (is_keyword(key, "@nest"))
+          for_each_item(value, [this, &ctx, &subject](std::uint32_t item) {
+              if (doc_[item].type == json_object)
+                properties(ctx, item, subject);
+            });
+        else if (is_keyword(key, "@included"))
+          for_each_item(value, [this, &ctx](std::uint32_t item) {
+              if (doc_[item].type == json_object)
+              {
+                term_view s;
+                node_object(ctx, item, s);
+              }
+            });
+        continue;
+      }
+
+      if (key.kind != uri_term)
+        continue;
+      property_values(ctx, subject, key, def, value, def != NULL && def->reverse);
+    }
+  }
+
+  void types(jsonld_context_ptr const& ctx, term_view const& subject, std::uint32_t value)
+  {
+    for_each_item(value, [this, &ctx, &subject](std::uint32_t item) {
+        if (doc_[item].type != json_string)
+          throw jsonld_error(doc_.where("@type must be a string", doc_[item].begin));
+        char const* data;
+        std::size_t size;
+        json_string_value(doc_, item, arena_, data, size);
+        term_view type;
+        if (expand_iri(*ctx, &base_, data, size, true, true, arena_, type))
+          emit(subject, rdf_type_, type);
+      });
+  }
+
+  void reverse_properties(jsonld_context_ptr const& ctx, term_view const& subject, std::uint32_t object)
+  {
+    if (doc_[object].type != json_object)
+      throw jsonld_error(doc_.where("@reverse must be an object", doc_[object].begin));
+    for (std::uint32_t k = doc_[object].first; k != json_none; k = doc_[k].next)
+    {
+      term_view key;
+      jsonld_term_definition const* def;
+      if (!expand_key(*ctx, k, key, def) || key.kind != uri_term || key.data[0] == '@')
+        continue;
+      property_values(ctx, subject, key, def, doc_[k].first, !(def != NULL && def->reverse));
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // The values of one property.
+  //----------------------------------------------------------------------
+  void property_values(jsonld_context_ptr const& ctx, term_view const& subject,
+                       term_view const& predicate, jsonld_term_definition const* def,
+                       std::uint32_t value, bool reverse)
+  {
+    if (doc_[value].type == json_array && def != NULL && def->list)
+    {
+      term_view head = list(ctx, def, value);
+      emit_property(subject, predicate, head, reverse);
+      return;
+    }
+
+    for_each_item(value, [&](std::uint32_t item) {
+        if (doc_[item].type == json_object)
+        {
+          std::uint32_t set = doc_.member(item, "@set");
+          if (set != json_none)
+          {
+            property_values(ctx, subject, predicate, def, set, reverse);
+            return;
+          }
+        }
+        term_view object;
+        if (value_term(ctx, def, item, object))
+          emit_property(subject, predicate, object, reverse);
+      });
+  }
+
+  //----------------------------------------------------------------------
+  // The term a single value stands for: a literal, an IRI, a list, or
+  // the subject of a nested node object (whose triples are emitted on
+  // the way).
+  //----------------------------------------------------------------------
+  bool value_term(jsonld_context_ptr const& ctx, jsonld_term_definition const* def,
+                  std::uint32_t item, term_view& out)
+  {
+    json_node const& n = doc_[item];
+    switch (n.type)
+    {
+    case json_null:
+      return false;
+
+    case json_string:
+    {
+      char const* data;
+      std::size_t size;
+      json_string_value(doc_, item, arena_, data, size);
+      if (def != NULL && def->coercion == jsonld_term_definition::id_coercion)
+        return expand_iri(*ctx, &base_, data, size, false, true, arena_, out);
+      if (def != NULL && def->coercion == jsonld_term_definition::vocab_coercion)
+        return expand_iri(*ctx, &base_, data, size, true, true, arena_, out);
+      out = term_view(literal_term, data, size);
+      if (def != NULL && def->coercion == jsonld_term_definition::datatype_coercion)
+      {
+        out.datatype = def->datatype.data();
+        out.datatype_size = def->datatype.size();
+      }
+      else if (std::string const* language = default_language(*ctx, def))
+      {
+        out.language = language->data();
+        out.language_size = language->size();
+      }
+      return true;
+    }
+
+    case json_number:
+    case json_true:
+    case json_false:
+      out = native_literal(item, def != NULL && def->coercion == jsonld_term_definition::datatype_coercion
+                           ? &def->datatype : NULL);
+      return true;
+
+    case json_array:
+      throw jsonld_error(doc_.where("nested array", n.begin));
+
+    case json_object:
+    {
+      std::uint32_t value = doc_.member(item, "@value");
+      if (value != json_none)
+        return value_object(ctx, item, value, out);
+
+      std::uint32_t items = doc_.member(item, "@list");
+      if (items != json_none)
+      {
+        out = list(ctx, def, items);
+        return true;
+      }
+
+      node_object(ctx, item, out);
+      return true;
+    }
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------
+  // The language of a plain string value: the term's own @language if
+  // it has one, the context's default otherwise.
+  //----------------------------------------------------------------------
+  static std::string const* default_language(jsonld_context const& ctx,
+                                             jsonld_term_definition const* def)
+  {
+    if (def != NULL && def->has_language)
+      return def->language.empty() ? NULL : &def->language;
+    return ctx.has_language ? &ctx.language : NULL;
+  }
+
+  bool value_object(jsonld_context_ptr const& ctx, std::uint32_t object,
+                    std::uint32_t value, term_view& out)
+  {
+    std::string datatype_storage;
+    std::string const* datatype = NULL;
+
+    std::uint32_t type = doc_.member(object, "@type");
+    if (type != json_none)
+    {
+      char const* data;
+      std::size_t size;
+      json_string_value(doc_, type, arena_, data, size);
+      term_view dt;
+      if (expand_iri(*ctx, &base_, data, size, true, true, arena_, dt))
+      {
+        datatype_storage = dt.value();
+        datatype = &datatype_storage;
+      }
+    }
+
+    json_node const& v = doc_[value];
+    if (v.type == json_null)
+      return false;
+    if (v.type == json_string)
+    {
+      char const* data;
+      std::size_t size;
+      json_string_value(doc_, value, arena_, data, size);
+      out = term_view(literal_term, data, size);
+      std::uint32_t language = doc_.member(object, "@language");
+      if (datatype != NULL)
+        out = with_datatype(out, *datatype);
+      else if (language != json_none && doc_[language].type == json_string)
+        json_string_value(doc_, language, arena_, out.language, out.language_size);
+      return true;
+    }
+    if (v.type == json_number || v.type == json_true || v.type == json_false)
+    {
+      out = native_literal(value, datatype);
+      return true;
+    }
+    throw jsonld_error(doc_.where("bad @value", v.begin));
+  }
+
+  //----------------------------------------------------------------------
+  // Numbers and booleans. Integers keep their text; other numbers are
+  // written as canonical doubles, unless a datatype says otherwise.
+  //----------------------------------------------------------------------
+  term_view native_literal(std::uint32_t item, std::string const* datatype)
+  {
+    json_node const& n = doc_[item];
+    char const* text = doc_.text() + n.begin;
+    std::size_t size = n.end - n.begin;
+
+    term_id type = vocab::xsd_boolean;
+    if (n.type == json_number)
+    {
+      bool integral = true;
+      for (std::size_t i = 0; i < size; ++i)
+        if (text[i] == '.' || text[i] == 'e' || text[i] == 'E')
+          integral = false;
+      type = integral ? vocab::xsd_integer : vocab::xsd_double;
+      if (!integral && (datatype == NULL || *datatype == vocab::iri(vocab::xsd_double)))
+      {
+        std::string canonical = canonical_double(text, size);
+        char* buffer = arena_.allocate(canonical.size());
+        std::memcpy(buffer, canonical.data(), canonical.size());
+        text = buffer;
+        size = canonical.size();
+      }
+    }
+
+    term_view out(literal_term, text, size);
+    if (datatype != NULL)
+      return with_datatype(out, *datatype);
+    char const* dt = vocab::iri(type);
+    out.datatype = dt;
+    out.datatype_size = std::strlen(dt);
+    return out;
+  }
+
+  term_view with_datatype(term_view t, std::string const& datatype)
+  {
+    char* buffer = arena_.allocate(datatype.size());
+    std::memcpy(buffer, datatype.data(), datatype.size());
+    t.datatype = buffer;
+    t.datatype_size = datatype.size();
+    return t;
+  }
+
+  term_view list(jsonld_context_ptr const& ctx, jsonld_term_definition const* def, std::uint32_t items)
+  {
+    std::vector<term_view> members;
+    for_each_item(items, [&](std::uint32_t item) {
+        term_view t;
+        if (value_term(ctx, def, item, t))
+          members.push_back(t);
+      });
+    if (members.empty())
+      return rdf_nil_;
+
+    term_view head = new_blank();
+    term_view node = head;
+    for (std::size_t i = 0; i < members.size(); ++i)
+    {
+      emit(node, rdf_first_, members[i]);
+      term_view next = (i + 1 == members.size()) ? rdf_nil_ : new_blank();
+      emit(node, rdf_rest_, next);
+      node = next;
+    }
+    return head;
+  }
+
+  //----------------------------------------------------------------------
+  // Helpers.
+  //----------------------------------------------------------------------
+  template <typename F>
+  void for_each_item(std::uint32_t value, F f)
+  {
+    if (doc_[value].type == json_array)
+    {
+      for (std::uint32_t k = doc_[value].first; k != json_none; k = doc_[k].next)
+        f(k);
+    }
+    else
+      f(value);
+  }
+
+  //----------------------------------------------------------------------
+  // Expand a key, and find its term definition if it is a term.
+  //----------------------------------------------------------------------
+  bool expand_key(jsonld_context const& ctx, std::uint32_t key, term_view& out,
+                  jsonld_term_definition const*& def)
+  {
+    char const* data;
+    std::size_t size;
+    json_string_value(doc_, key, arena_, data, size);
+    def = NULL;
+    if (size != 0 && data[0] == '@')
+    {
+      out = term_view(uri_term, data, size);
+      return true;
+    }
+
+    def = ctx.find(data, size);
+    if (def != NULL)
+    {
+      if (def->null_mapping)
+        return false;
+      out = term_view(uri_term, def->iri.data(), def->iri.size());
+      return true;
+    }
+    return expand_iri(ctx, &base_, data, size, true, false, arena_, out);
+  }
+
+  static bool is_keyword(term_view const& t, char const* keyword)
+  {
+    std::size_t n = std::strlen(keyword);
+    return t.size == n && std::memcmp(t.data, keyword, n) == 0;
+  }
+
+  // Generated labels are genid- followed by digits; see expand_iri( ) for
+  // how document labels are kept clear of them.
+  term_view new_blank()
+  {
+    char* label = arena_.allocate(32);
+    int n = std::snprintf(label, 32, "genid-%lu", static_cast<unsigned long>(++blank_count_));
+    return term_view(blank_term, label, static_cast<std::size_t>(n));
+  }
+
+  void emit_property(term_view const& subject, term_view const& predicate,
+                     term_view const& object, bool reverse)
+  {
+    if (!reverse)
+      emit(subject, predicate, object);
+    else if (object.kind != literal_term)
+      emit(object, predicate, subject);
+  }
+
+  void emit(term_view const& s, term_view const& p, term_view const& o)
+  {
+    view_triple t = { s, p, o };
+    if (accept_statement(conv_, t))
+    {
+      *dest_ = conv_(t);
+      ++dest_;
+    }
+  }
+
+  json_document const& doc_;
+  jsonld_context_cache& cache_;
+  Iter dest_;
+  Converter conv_;
+  unsigned long blank_count_;
+  term_arena arena_;
+  base_iri base_;
+  jsonld_context_ptr initial_;
+
+  jsonld_context_ptr last_active_;
+  char const* last_context_;
+  std::size_t last_context_size_;
+  jsonld_context_ptr last_result_;
+
+  term_view rdf_type_;
+  term_view rdf_first_;
+  term_view rdf_rest_;
+  term_view rdf_nil_;
+};
+
+//===========================================================================
+// The JSON-LD parser, with the same interface as the other parsers.
+// Parsers share a context cache if they are given the same one; by
+// default each has its own.
+//===========================================================================
+class jsonld_parser
+{
+public:
+  explicit jsonld_parser(read_options const& opts = read_options())
+    : cache_(std::make_shared<jsonld_context_cache>()), opts_(opts)
+  {}
+
+  explicit jsonld_parser(
+    std::shared_ptr<jsonld_context_cache> cache,
+    read_options const& opts = read_options())
+    : cache_(std::move(cache)), opts_(opts)
+  {}
+
+  template <typename Iter>
+  bool operator()(std::string const& file_name, Iter dest) const
+  {
+    return (*this)(file_name, dest, rdf_triple_converter());
+  }
+
+  //----------------------------------------------------------------------
+  // Parse a file. Throws std::domain_error if the file cannot be opened
+  // or read.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  bool operator()(std::string const& file_name, Iter dest, Converter conv) const
+  {
+    file_reader reader(file_name, opts_);
+    std::string text;
+    reader.for_each_chunk([&text](unsigned char const* data, std::size_t size) {
+        text.append(reinterpret_cast<char const*>(data), size);
+      });
+    return parse_buffer(
+      file_name, reinterpret_cast<unsigned char const*>(text.data()), text.size(), dest, conv);
+  }
+
+  //----------------------------------------------------------------------
+  // Parse a document that is already in memory. name is its base IRI.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  bool parse_buffer(
+    std::string const& name, unsigned char const* data, std::size_t size,
+    Iter dest, Converter conv) const
+  {
+    try
+    {
+      json_document doc;
+      doc.parse(reinterpret_cast<char const*>(data), size);
+      jsonld_emitter<Iter, Converter> emitter(doc, name, *cache_, dest, conv);
+      emitter.run();
+      return true;
+    }
+    catch (jsonld_error const& e)
+    {
+      std::cerr << name << ": " << e.what() << std::endl;
+      return false;
+    }
+  }
+
+  template <typename Iter>
+  bool parse_buffer(
+    std::string const& name, unsigned char const* data, std::size_t size, Iter dest) const
+  {
+    return parse_buffer(name, data, size, dest, rdf_triple_converter());
+  }
+
+  std::shared_ptr<jsonld_context_cache> contexts() const { return cache_; }
+
+private:
+  std::shared_ptr<jsonld_context_cache> cache_;
+  read_options opts_;
+};
+
+} // namespace rdf
+
+#endif
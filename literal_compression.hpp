@@ -0,0 +1,344 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains a compressed store for literal values. Labels,
+// comments and descriptions make up most of the bytes of a crawl, and
+// they are highly repetitive text, so they compress well with a static
+// symbol table in the style of FSST: up to 255 symbols of 1 to 8 bytes,
+// each replaced by a one-byte code, with a 255 escape code for bytes that
+// no symbol covers.
+//
+// Because every literal is compressed on its own with the same table,
+// single literals can be decoded without touching their neighbours, and
+// two literals are equal exactly when their compressed bytes are equal.
+//===========================================================================
+
+#ifndef BST_LITERAL_COMPRESSION_HPP_
+#define BST_LITERAL_COMPRESSION_HPP_
+
+#include "term_dictionary.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+namespace rdf {
+
+//===========================================================================
+// A trained symbol table. Encoding takes the longest symbol that matches
+// at each position; decoding is a table lookup per code.
+//===========================================================================
+class symbol_table
+{
+public:
+  static const unsigned char escape = 255;
+  static const std::size_t max_symbols = 255;
+  static const std::size_t max_symbol_length = 8;
+
+  symbol_table()
+  {}
+
+  explicit symbol_table(std::vector<std::string> const& symbols)
+  {
+    for (auto const& s : symbols)
+      if (!s.empty() && s.size() <= max_symbol_length && symbols_.size() < max_symbols)
+        symbols_.push_back(s);
+    index();
+  }
+
+  //----------------------------------------------------------------------
+  // Train a table on a sample of strings. Each round compresses the
+  // sample with the current table, counts how often each symbol and each
+  // pair of adjacent symbols occurs, and keeps the 255 candidates (symbols
+  // or concatenated pairs) that would save the most bytes.
+  //----------------------------------------------------------------------
+  static symbol_table train(std::vector<std::string> const& sample, int rounds = 5)
+  {
+    symbol_table table;
+
+    // Tokens 0-255 are escaped raw bytes, 256 and up are symbol codes.
+    const std::size_t tokens = 256 + max_symbols;
+    std::vector<std::uint32_t> count1(tokens);
+    std::vector<std::uint32_t> count2(tokens * tokens);
+
+    for (int round = 0; round < rounds; ++round)
+    {
+      std::fill(std::begin(count1), std::end(count1), 0);
+      std::fill(std::begin(count2), std::end(count2), 0);
+
+      for (auto const& s : sample)
+      {
+        std::size_t prev = tokens;
+        for (std::size_t pos = 0; pos < s.size(); )
+        {
+          std::size_t len;
+          int code = table.match(s.data() + pos, s.size() - pos, len);
+          std::size_t token = code < 0 ? static_cast<unsigned char>(s[pos]) : 256 + code;
+          if (code < 0)
+            len = 1;
+
+          ++count1[token];
+          if (prev != tokens)
+            ++count2[prev * tokens + token];
+          prev = token;
+          pos += len;
+        }
+      }
+
+      std::map<std::string, std::uint64_t> gain;
+      for (std::size_t t = 0; t < tokens; ++t)
+      {
+        if (count1[t] == 0)
+          continue;
+        std::string s1 = table.token(t);
+        gain[s1] += static_cast<std::uint64_t>(count1[t]) * s1.size();
+
+        for (std::size_t u = 0; u < tokens; ++u)
+        {
+          std::uint32_t n = count2[t * tokens + u];
+          if (n == 0)
+            continue;
+          std::string s2 = table.token(u);
+          if (s1.size() + s2.size() <= max_symbol_length)
+            gain[s1 + s2] += static_cast<std::uint64_t>(n) * (s1.size() + s2.size());
+        }
+      }
+
+      std::vector<std::pair<std::uint64_t, std::string>> ranked;
+      for (auto const& g : gain)
+        ranked.push_back(std::make_pair(g.second, g.first));
+      std::sort(std::begin(ranked), std::end(ranked),
+        [](std::pair<std::uint64_t, std::string> const& a,
+           std::pair<std::uint64_t, std::string> const& b) {
+          return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+
+      std::vector<std::string> symbols;
+      for (std::size_t i = 0; i < ranked.size() && i < max_symbols; ++i)
+        symbols.push_back(ranked[i].second);
+      table = symbol_table(symbols);
+    }
+
+    return table;
+  }
+
+  std::size_t size() const { return symbols_.size(); }
+  std::string const& symbol(unsigned char code) const { return symbols_[code]; }
+
+  void compress(char const* data, std::size_t size, std::string& out) const
+  {
+    out.clear();
+    for (std::size_t pos = 0; pos < size; )
+    {
+      std::size_t len;
+      int code = match(data + pos, size - pos, len);
+      if (code < 0)
+      {
+        out.push_back(static_cast<char>(escape));
+        out.push_back(data[pos]);
+        ++pos;
+      }
+      else
+      {
+        out.push_back(static_cast<char>(code));
+        pos += len;
+      }
+    }
+  }
+
+  void decompress(char const* data, std::size_t size, std::string& out) const
+  {
+    out.clear();
+    for (std::size_t pos = 0; pos < size; ++pos)
+    {
+      unsigned char code = static_cast<unsigned char>(data[pos]);
+      if (code == escape)
+        out.push_back(data[++pos]);
+      else
+        out.append(symbols_[code]);
+    }
+  }
+
+private:
+  //----------------------------------------------------------------------
+  // The code of the longest symbol that prefixes data, or -1.
+  //----------------------------------------------------------------------
+  int match(char const* data, std::size_t size, std::size_t& len) const
+  {
+    if (symbols_.empty())
+      return -1;
+
+    std::vector<unsigned char> const& candidates = by_first_[static_cast<unsigned char>(*data)];
+    for (unsigned char code : candidates)
+    {
+      std::string const& s = symbols_[code];
+      if (s.size() <= size && std::memcmp(s.data(), data, s.size()) == 0)
+      {
+        len = s.size();
+        return code;
+      }
+    }
+    return -1;
+  }
+
+  std::string token(std::size_t t) const
+  {
+    return t < 256 ? std::string(1, static_cast<char>(t)) : symbols_[t - 256];
+  }
+
+  //----------------------------------------------------------------------
+  // Group the codes by first byte, longest symbol first.
+  //----------------------------------------------------------------------
+  void index()
+  {
+    by_first_.assign(256, std::vector<unsigned char>());
+    for (std::size_t code = 0; code < symbols_.size(); ++code)
+      by_first_[static_cast<unsigned char>(symbols_[code][0])].push_back(
+        static_cast<unsigned char>(code));
+
+    for (auto& codes : by_first_)
+      std::stable_sort(std::begin(codes), std::end(codes),
+        [this](unsigned char a, unsigned char b) {
+          return symbols_[a].size() > symbols_[b].size();
+        });
+  }
+
+  std::vector<std::string> symbols_;
+  std::vector<std::vector<unsigned char>> by_first_;
+};
+
+//===========================================================================
+// An append-only store of compressed literals, addressed by the index
+// add( ) returns. Literals are individually decodable and can be compared
+// for equality without decompressing them. Not safe for concurrent
+// writers.
+//===========================================================================
+class compressed_literal_store
+{
+public:
+  explicit compressed_literal_store(symbol_table table)
+    : table_(std::move(table))
+  {
+    offsets_.push_back(0);
+  }
+
+  std::uint32_t add(char const* data, std::size_t size)
+  {
+    table_.compress(data, size, buffer_);
+    bytes_.insert(std::end(bytes_), buffer_.begin(), buffer_.end());
+    offsets_.push_back(static_cast<std::uint64_t>(bytes_.size()));
+    return static_cast<std::uint32_t>(offsets_.size() - 2);
+  }
+
+  std::uint32_t add(std::string const& str)
+  {
+    return add(str.data(), str.size());
+  }
+
+  std::size_t size() const { return offsets_.size() - 1; }
+
+  void get(std::uint32_t index, std::string& out) const
+  {
+    check(index);
+    table_.decompress(bytes_.data() + offsets_[index], compressed_size(index), out);
+  }
+
+  std::string get(std::uint32_t index) const
+  {
+    std::string out;
+    get(index, out);
+    return out;
+  }
+
+  //----------------------------------------------------------------------
+  // Compare a stored literal with a string by compressing the string, or
+  // two stored literals directly.
+  //----------------------------------------------------------------------
+  bool equals(std::uint32_t index, char const* data, std::size_t size) const
+  {
+    check(index);
+    std::string probe;
+    table_.compress(data, size, probe);
+    return probe.size() == compressed_size(index)
+      && std::memcmp(probe.data(), bytes_.data() + offsets_[index], probe.size()) == 0;
+  }
+
+  bool equals(std::uint32_t a, std::uint32_t b) const
+  {
+    check(a);
+    check(b);
+    return compressed_size(a) == compressed_size(b)
+      && std::memcmp(bytes_.data() + offsets_[a], bytes_.data() + offsets_[b], compressed_size(a)) == 0;
+  }
+
+  symbol_table const& table() const { return table_; }
+
+  std::size_t memory_usage() const
+  {
+    return bytes_.capacity() + offsets_.capacity() * sizeof(std::uint64_t);
+  }
+
+private:
+  void check(std::uint32_t index) const
+  {
+    if (index >= size())
+      throw std::domain_error("literal index out of range");
+  }
+
+  std::size_t compressed_size(std::uint32_t index) const
+  {
+    return static_cast<std::size_t>(offsets_[index + 1] - offsets_[index]);
+  }
+
+  symbol_table table_;
+  std::vector<char> bytes_;
+  std::vector<std::uint64_t> offsets_;
+  std::string buffer_;
+};
+
+//===========================================================================
+// Train a symbol table on (up to max_bytes worth of) the literal values
+// held in a term dictionary.
+//===========================================================================
+inline symbol_table train_literal_table(
+  term_dictionary const& dict, std::size_t max_bytes = std::size_t(1) << 24)
+{
+  std::vector<std::string> sample;
+  std::size_t bytes = 0;
+  dict.for_each([&](term_id, term_view const& t) {
+      if (t.kind == literal_term && bytes < max_bytes)
+      {
+        sample.push_back(t.value());
+        bytes += t.size;
+      }
+    });
+  return symbol_table::train(sample);
+}
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,119 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines membership_index, which keeps for each predicate the
+// set of subjects using it, and for each class the set of its instances,
+// as roaring bitmaps of term ids.
+//===========================================================================
+
+#ifndef BST_MEMBERSHIP_INDEX_HPP_
+#define BST_MEMBERSHIP_INDEX_HPP_
+
+#include "term_id.hpp"
+#include "vocabulary.hpp"
+#include "roaring_bitmap.hpp"
+
+#include <vector>
+#include <unordered_map>
+
+namespace rdf {
+
+//===========================================================================
+// Queries such as "every owl:Class with an rdfs:label" become
+// intersections of these sets:
+//
+//   roaring_bitmap labelled = index.instances_of(vocab::owl_Class)
+//                           & index.subjects_of(vocab::rdfs_label);
+//
+// Adding triples is not thread-safe; triple_store keeps its index up to
+// date as triples are inserted.
+//===========================================================================
+class membership_index
+{
+public:
+  membership_index() {}
+
+  void add(id_triple const& t)
+  {
+    subjects_[t.predicate].add(t.subject);
+    if (t.predicate == vocab::rdf_type)
+      instances_[t.object].add(t.subject);
+  }
+
+  //----------------------------------------------------------------------
+  // Index a range of id_triples, a bitmap at a time.
+  //----------------------------------------------------------------------
+  template <typename Iter>
+  void add(Iter first, Iter last)
+  {
+    std::unordered_map<term_id, std::vector<term_id>> subjects;
+    std::unordered_map<term_id, std::vector<term_id>> instances;
+    for (; first != last; ++first)
+    {
+      subjects[first->predicate].push_back(first->subject);
+      if (first->predicate == vocab::rdf_type)
+        instances[first->object].push_back(first->subject);
+    }
+
+    for (auto const& s : subjects)
+      subjects_[s.first].add_many(s.second.begin(), s.second.end());
+    for (auto const& i : instances)
+      instances_[i.first].add_many(i.second.begin(), i.second.end());
+  }
+
+  void clear()
+  {
+    subjects_.clear();
+    instances_.clear();
+  }
+
+  //----------------------------------------------------------------------
+  // The subjects of some triple with the predicate, and the subjects
+  // typed with the class; empty if there are none.
+  //----------------------------------------------------------------------
+  roaring_bitmap const& subjects_of(term_id predicate) const
+  {
+    return lookup(subjects_, predicate);
+  }
+
+  roaring_bitmap const& instances_of(term_id cls) const
+  {
+    return lookup(instances_, cls);
+  }
+
+private:
+  typedef std::unordered_map<term_id, roaring_bitmap> bitmap_map;
+
+  static roaring_bitmap const& lookup(bitmap_map const& m, term_id id)
+  {
+    static roaring_bitmap const none;
+    auto it = m.find(id);
+    return it == m.end() ? none : it->second;
+  }
+
+  bitmap_map subjects_;
+  bitmap_map instances_;
+};
+
+} // namespace rdf
+
+#endif
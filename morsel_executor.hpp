@@ -0,0 +1,297 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines morsel_executor, a team of worker threads that splits
+// a range of work into small morsels and balances them by work stealing,
+// for the parallel query operators in parallel_query.hpp.
+//
+// When the library is built with BST_HAVE_NUMA defined (and linked
+// against libnuma), workers are spread over the NUMA nodes in blocks, run
+// on their node and allocate from it, and steal from workers on their own
+// node before going to others. Otherwise every worker counts as node 0.
+//===========================================================================
+
+#ifndef BST_MORSEL_EXECUTOR_HPP_
+#define BST_MORSEL_EXECUTOR_HPP_
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef BST_HAVE_NUMA
+#include <numa.h>
+#endif
+
+namespace rdf {
+
+static const std::size_t cache_line_size = 64;
+
+//===========================================================================
+// An allocator handing out storage aligned to a cache line, for vectors
+// of per-worker state declared alignas(cache_line_size): plain operator
+// new only promises the alignment of the fundamental types, so the
+// alignas alone would not keep the elements off each other's lines.
+//===========================================================================
+template <typename T>
+struct cache_line_allocator
+{
+  typedef T value_type;
+
+  cache_line_allocator() {}
+
+  template <typename U>
+  cache_line_allocator(cache_line_allocator<U> const&) {}
+
+  T* allocate(std::size_t n)
+  {
+    void* p = NULL;
+    if (::posix_memalign(&p, cache_line_size, n * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T*>(p);
+  }
+
+  void deallocate(T* p, std::size_t)
+  {
+    std::free(p);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(cache_line_allocator<T> const&, cache_line_allocator<U> const&)
+{
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(cache_line_allocator<T> const&, cache_line_allocator<U> const&)
+{
+  return false;
+}
+
+//===========================================================================
+// A job over [0, n) is cut into morsels of a fixed number of items. Each
+// worker starts with its own contiguous share of the morsels, so it
+// keeps to one part of the data, and takes them one by one from the
+// front; a worker done with its share steals single morsels from the
+// others, nearest node first, until none are left. Morsels are claimed
+// with one atomic increment, so stealing costs no more than local work.
+//
+// Jobs run one at a time: threads that start jobs together queue up, and
+// the calling thread waits for its own. f must not start another job on
+// the same executor. The first exception thrown by f is rethrown once the
+// job is over.
+//===========================================================================
+class morsel_executor
+{
+  // A worker's share of the morsels, on a cache line of its own.
+  struct alignas(cache_line_size) share
+  {
+    std::atomic<std::size_t> next;
+    std::size_t end;
+  };
+
+public:
+  explicit morsel_executor(std::size_t threads = std::thread::hardware_concurrency())
+    : shares_(threads == 0 ? 1 : threads), generation_(0), running_(0), stop_(false)
+  {
+    std::size_t n = shares_.size();
+    std::size_t nodes = 1;
+#ifdef BST_HAVE_NUMA
+    if (numa_available() >= 0)
+      nodes = static_cast<std::size_t>(numa_num_configured_nodes());
+#endif
+    for (std::size_t i = 0; i < n; ++i)
+      nodes_.push_back(static_cast<unsigned>(i * nodes / n));
+
+    // Steal from the same node first, nearest neighbours first.
+    victims_.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      for (std::size_t d = 1; d < n; ++d)
+        if (nodes_[(i + d) % n] == nodes_[i])
+          victims_[i].push_back((i + d) % n);
+      for (std::size_t d = 1; d < n; ++d)
+        if (nodes_[(i + d) % n] != nodes_[i])
+          victims_[i].push_back((i + d) % n);
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+      workers_.push_back(std::thread([this, i]() { run(i); }));
+  }
+
+  ~morsel_executor()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_cond_.notify_all();
+    for (auto& t : workers_)
+      t.join();
+  }
+
+  std::size_t size() const { return workers_.size(); }
+
+  //----------------------------------------------------------------------
+  // The NUMA node a worker runs on.
+  //----------------------------------------------------------------------
+  unsigned node_of(std::size_t worker) const { return nodes_[worker]; }
+
+  //----------------------------------------------------------------------
+  // Call f(worker, begin, end) over [0, n), a morsel at a time. worker is
+  // the number of the calling worker, in [0, size( )), for keeping
+  // per-worker state without locks.
+  //----------------------------------------------------------------------
+  template <typename Func>
+  void for_each_morsel(std::size_t n, Func f, std::size_t morsel_size = 16384)
+  {
+    if (n == 0)
+      return;
+    if (morsel_size == 0)
+      morsel_size = 1;
+
+    // The shares and the job belong to one job at a time.
+    std::lock_guard<std::mutex> job_lock(job_mutex_);
+
+    std::size_t morsels = (n + morsel_size - 1) / morsel_size;
+    std::size_t w = shares_.size();
+    for (std::size_t i = 0; i < w; ++i)
+    {
+      shares_[i].next.store(morsels * i / w, std::memory_order_relaxed);
+      shares_[i].end = morsels * (i + 1) / w;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = [this, &f, n, morsel_size](std::size_t worker) {
+      std::size_t m;
+      while (claim(worker, m))
+      {
+        std::size_t begin = m * morsel_size;
+        f(worker, begin, std::min(n, begin + morsel_size));
+      }
+    };
+    error_ = std::exception_ptr();
+    running_ = w;
+    ++generation_;
+    work_cond_.notify_all();
+    done_cond_.wait(lock, [this]() { return running_ == 0; });
+    job_ = nullptr;
+
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+
+private:
+  morsel_executor(morsel_executor const&);
+  morsel_executor& operator=(morsel_executor const&);
+
+  //----------------------------------------------------------------------
+  // Claim the next morsel of the worker's own share, or else of the
+  // nearest share with morsels left.
+  //----------------------------------------------------------------------
+  bool claim(std::size_t worker, std::size_t& m)
+  {
+    if (take(shares_[worker], m))
+      return true;
+    for (std::size_t v : victims_[worker])
+      if (take(shares_[v], m))
+        return true;
+    return false;
+  }
+
+  static bool take(share& s, std::size_t& m)
+  {
+    if (s.next.load(std::memory_order_relaxed) >= s.end)
+      return false;
+    m = s.next.fetch_add(1, std::memory_order_relaxed);
+    return m < s.end;
+  }
+
+  void run(std::size_t worker)
+  {
+#ifdef BST_HAVE_NUMA
+    if (numa_available() >= 0)
+    {
+      numa_run_on_node(static_cast<int>(nodes_[worker]));
+      numa_set_preferred(static_cast<int>(nodes_[worker]));
+    }
+#endif
+
+    std::uint64_t seen = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cond_.wait(lock, [this, seen]() { return stop_ || generation_ != seen; });
+        if (stop_)
+          return;
+        seen = generation_;
+      }
+
+      try
+      {
+        job_(worker);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_)
+          error_ = std::current_exception();
+        // Leave no morsels for anyone else.
+        for (auto& s : shares_)
+          s.next.store(s.end, std::memory_order_relaxed);
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--running_ == 0)
+        done_cond_.notify_all();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::vector<share, cache_line_allocator<share>> shares_;
+  std::vector<unsigned> nodes_;
+  std::vector<std::vector<std::size_t>> victims_;
+
+  std::function<void(std::size_t)> job_;
+  std::uint64_t generation_;
+  std::size_t running_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::mutex job_mutex_;
+  std::mutex mutex_;
+  std::condition_variable work_cond_;
+  std::condition_variable done_cond_;
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,728 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains a native parser for N-Triples and N-Quads that does
+// not go through raptor. Most bulk data arrives as N-Triples, where
+// raptor's general machinery costs far more than the format needs.
+//
+// The input is scanned 64 bytes at a time for the characters that matter
+// to the grammar (< > " \ and whitespace); everything in between, which
+// is the bulk of every IRI and literal, is skipped over a bit mask at a
+// time. Terms are handed to the converter as term_views pointing straight
+// into the input, so with an interning_converter a term goes from the
+// read buffer into the dictionary without being copied on the way. Only
+// terms containing escapes are decoded, into a small per-parser arena.
+//===========================================================================
+
+#ifndef BST_NTRIPLES_PARSER_HPP_
+#define BST_NTRIPLES_PARSER_HPP_
+
+#include "rdf_parser.hpp"
+#include "term_id.hpp"
+#include "term_validation.hpp"
+#include "file_reader.hpp"
+
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace rdf {
+
+namespace {
+
+//----------------------------------------------------------------------
+// What a scan of one block of up to 64 bytes finds out, as bit masks over
+// the bytes of the block: the structural characters < > " \ space tab
+// \r \n, the non-ASCII bytes, and the bytes an IRI may not contain
+// (non-ASCII ones included). The last two let a term made of plain
+// characters be validated without looking at it again.
+//----------------------------------------------------------------------
+struct block_masks
+{
+  std::uint64_t structural;
+  std::uint64_t non_ascii;
+  std::uint64_t not_iri;
+};
+
+inline void classify_scalar(char const* p, std::size_t n, block_masks& m)
+{
+  m.structural = m.non_ascii = m.not_iri = 0;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    unsigned char c = static_cast<unsigned char>(p[i]);
+    std::uint64_t bit = std::uint64_t(1) << i;
+    if (c == '<' || c == '>' || c == '"' || c == '\\'
+        || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+      m.structural |= bit;
+    if (c >= 0x80)
+      m.non_ascii |= bit;
+    if (c >= 0x80 || is_iri_forbidden(c))
+      m.not_iri |= bit;
+  }
+}
+
+#if defined(__SSE2__)
+
+//----------------------------------------------------------------------
+// With SSSE3 one nibble lookup answers both questions: the tables give
+// class bits for each byte's low and high nibble, and a byte belongs to
+// the classes its two nibbles share.
+//
+//   0x01: \t \n \r       0x02: space "      0x04: < >
+//   0x08: \\             0x10: ^            0x20: 0x00-0x1F
+//   0x40: `              0x80: { | }
+//
+// The first four make up the structural characters, and all but the
+// first the characters an IRI may not contain.
+//----------------------------------------------------------------------
+inline void classify_16(char const* p, unsigned shift, block_masks& m)
+{
+  __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+#if defined(__SSSE3__)
+  const __m128i low_classes = _mm_setr_epi8(
+    0x62, 0x20, 0x22, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x20, 0x21, 0x21, char(0xA0), char(0xAC), char(0xA1), 0x34, 0x20);
+  const __m128i high_classes = _mm_setr_epi8(
+    0x21, 0x20, 0x02, 0x04, 0x00, 0x18, 0x40, char(0x80),
+    0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i zero = _mm_setzero_si128();
+
+  __m128i lo = _mm_shuffle_epi8(low_classes, _mm_and_si128(b, nibble));
+  __m128i hi = _mm_shuffle_epi8(high_classes, _mm_and_si128(_mm_srli_epi16(b, 4), nibble));
+  __m128i hit = _mm_and_si128(lo, hi);
+
+  unsigned structural = 0xFFFF & ~static_cast<unsigned>(_mm_movemask_epi8(
+    _mm_cmpeq_epi8(_mm_and_si128(hit, _mm_set1_epi8(0x0F)), zero)));
+  unsigned not_iri = 0xFFFF & ~static_cast<unsigned>(_mm_movemask_epi8(
+    _mm_cmpeq_epi8(_mm_and_si128(hit, _mm_set1_epi8(char(0xFE))), zero)));
+#else
+  __m128i s = _mm_cmpeq_epi8(b, _mm_set1_epi8('<'));
+  s = _mm_or_si128(s, _mm_cmpeq_epi8(b, _mm_set1_epi8('>')));
+  s = _mm_or_si128(s, _mm_cmpeq_epi8(b, _mm_set1_epi8('"')));
+  s = _mm_or_si128(s, _mm_cmpeq_epi8(b, _mm_set1_epi8('\\')));
+  s = _mm_or_si128(s, _mm_cmpeq_epi8(b, _mm_set1_epi8(' ')));
+  s = _mm_or_si128(s, _mm_cmpeq_epi8(b, _mm_set1_epi8('\t')));
+  s = _mm_or_si128(s, _mm_cmpeq_epi8(b, _mm_set1_epi8('\r')));
+  s = _mm_or_si128(s, _mm_cmpeq_epi8(b, _mm_set1_epi8('\n')));
+
+  unsigned structural = static_cast<unsigned>(_mm_movemask_epi8(s));
+  unsigned not_iri = static_cast<unsigned>(iri_forbidden_mask(b));
+#endif
+
+  std::uint64_t high = static_cast<unsigned>(_mm_movemask_epi8(b));
+  m.structural |= std::uint64_t(structural) << shift;
+  m.non_ascii |= high << shift;
+  m.not_iri |= (high | not_iri) << shift;
+}
+
+inline void classify_64(char const* p, block_masks& m)
+{
+  m.structural = m.non_ascii = m.not_iri = 0;
+  classify_16(p, 0, m);
+  classify_16(p + 16, 16, m);
+  classify_16(p + 32, 32, m);
+  classify_16(p + 48, 48, m);
+}
+
+#else
+
+inline void classify_64(char const* p, block_masks& m)
+{
+  classify_scalar(p, 64, m);
+}
+
+#endif
+
+//----------------------------------------------------------------------
+// Finds the next structural character in [begin, end). The masks of the
+// current block are kept, so the several lookups made while parsing one
+// statement mostly come out of a single 64-byte scan.
+//
+// The scanner also remembers what it saw of the term begun by
+// start_term( ): as long as the term is then scanned straight through to
+// its end, term_is_plain( ) says whether it held only characters that
+// need no further validation.
+//----------------------------------------------------------------------
+class structural_scanner
+{
+public:
+  structural_scanner(char const* begin, char const* end)
+    : end_(end), block_(begin), block_end_(begin), term_(begin),
+      non_ascii_(0), not_iri_(0)
+  {
+    masks_.structural = masks_.non_ascii = masks_.not_iri = 0;
+  }
+
+  char const* next(char const* p)
+  {
+    if (p < block_ || p >= block_end_)
+      load(p);
+
+    std::uint64_t m = masks_.structural & (~std::uint64_t(0) << (p - block_));
+    while (m == 0)
+    {
+      if (block_end_ == end_)
+        return end_;
+      load(block_end_);
+      m = masks_.structural;
+    }
+    return block_ + __builtin_ctzll(m);
+  }
+
+  void start_term(char const* p)
+  {
+    term_ = p;
+    non_ascii_ = not_iri_ = 0;
+  }
+
+  bool term_is_plain(char const* last, bool iri)
+  {
+    fold(last);
+    return (iri ? not_iri_ : non_ascii_) == 0;
+  }
+
+private:
+  void load(char const* p)
+  {
+    if (p == block_end_)
+      fold(block_end_);
+
+    block_ = p;
+    if (end_ - p >= 64)
+    {
+      block_end_ = p + 64;
+      classify_64(p, masks_);
+    }
+    else
+    {
+      block_end_ = end_;
+      classify_scalar(p, end_ - p, masks_);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // Add what the current block holds of [term_, last) to the term.
+  //----------------------------------------------------------------------
+  void fold(char const* last)
+  {
+    if (last <= block_ || term_ >= block_end_)
+      return;
+
+    unsigned lo = term_ > block_ ? static_cast<unsigned>(term_ - block_) : 0;
+    unsigned hi = static_cast<unsigned>(std::min(last, block_end_) - block_);
+    if (lo >= hi)
+      return;
+
+    std::uint64_t range = (hi == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << hi) - 1)
+      & (~std::uint64_t(0) << lo);
+    non_ascii_ |= masks_.non_ascii & range;
+    not_iri_ |= masks_.not_iri & range;
+  }
+
+  char const* end_;
+  char const* block_;
+  char const* block_end_;
+  block_masks masks_;
+  char const* term_;
+  std::uint64_t non_ascii_;
+  std::uint64_t not_iri_;
+};
+
+//----------------------------------------------------------------------
+// Helpers for the escapes N-Triples allows.
+//----------------------------------------------------------------------
+inline int hex_value(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+inline std::size_t encode_utf8(std::uint32_t cp, char* out)
+{
+  if (cp < 0x80)
+  {
+    out[0] = static_cast<char>(cp);
+    return 1;
+  }
+  if (cp < 0x800)
+  {
+    out[0] = static_cast<char>(0xC0 | (cp >> 6));
+    out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000)
+  {
+    out[0] = static_cast<char>(0xE0 | (cp >> 12));
+    out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  out[0] = static_cast<char>(0xF0 | (cp >> 18));
+  out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+//----------------------------------------------------------------------
+// Decode the escapes in [p, end) into out, which must have room for
+// end - p bytes (an escape is never shorter than what it decodes to).
+// IRIs only allow \u and \U. Returns the decoded size, or -1.
+//----------------------------------------------------------------------
+inline std::ptrdiff_t unescape(char const* p, char const* end, char* out, bool iri)
+{
+  char* o = out;
+  while (p < end)
+  {
+    if (*p != '\\')
+    {
+      *o++ = *p++;
+      continue;
+    }
+    if (++p == end)
+      return -1;
+
+    char e = *p++;
+    if (e == 'u' || e == 'U')
+    {
+      int digits = (e == 'u') ? 4 : 8;
+      if (end - p < digits)
+        return -1;
+      std::uint32_t cp = 0;
+      for (int i = 0; i < digits; ++i)
+      {
+        int h = hex_value(*p++);
+        if (h < 0)
+          return -1;
+        cp = (cp << 4) | static_cast<std::uint32_t>(h);
+      }
+      if (cp > 0x10FFFF)
+        return -1;
+      o += encode_utf8(cp, o);
+      continue;
+    }
+    if (iri)
+      return -1;
+
+    switch (e)
+    {
+    case 't':  *o++ = '\t'; break;
+    case 'b':  *o++ = '\b'; break;
+    case 'n':  *o++ = '\n'; break;
+    case 'r':  *o++ = '\r'; break;
+    case 'f':  *o++ = '\f'; break;
+    case '"':  *o++ = '"';  break;
+    case '\'': *o++ = '\''; break;
+    case '\\': *o++ = '\\'; break;
+    default:
+      return -1;
+    }
+  }
+  return o - out;
+}
+
+inline bool is_inline_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool is_language_char(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-';
+}
+
+inline char const* skip_space(char const* p, char const* end)
+{
+  while (p != end && is_inline_space(*p))
+    ++p;
+  return p;
+}
+
+inline char const* line_end(char const* p, char const* end)
+{
+  char const* nl = static_cast<char const*>(std::memchr(p, '\n', end - p));
+  return nl == NULL ? end : nl;
+}
+
+} // namespace
+
+//===========================================================================
+// Parses statements out of a stretch of complete lines. One statement
+// parser is used per document; it owns the arena that escaped terms are
+// decoded into.
+//===========================================================================
+class ntriples_statement_parser
+{
+public:
+  explicit ntriples_statement_parser(std::string const& name)
+    : name_(name), line_(1), good_(true)
+  {}
+
+  //----------------------------------------------------------------------
+  // Parse every statement in [p, end), which must end at a line break or
+  // at the end of the document, and write what conv makes of each one
+  // through dest.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  Iter parse(char const* p, char const* end, Iter dest, Converter const& conv)
+  {
+    structural_scanner scan(p, end);
+
+    while (p != end)
+    {
+      p = skip_space(p, end);
+      if (p == end)
+        break;
+
+      if (*p == '\n')
+      {
+        ++line_;
+        ++p;
+        continue;
+      }
+      if (*p == '#')
+      {
+        p = line_end(p, end);
+        continue;
+      }
+
+      arena_.rewind();
+      view_triple t;
+      char const* q = parse_statement(scan, p, end, t);
+      if (q == NULL)
+      {
+        error();
+        p = line_end(p, end);
+        continue;
+      }
+
+      if (accept_statement(conv, t))
+      {
+        *dest = conv(t);
+        ++dest;
+      }
+      p = q;
+    }
+    return dest;
+  }
+
+  bool good() const { return good_; }
+
+private:
+  //----------------------------------------------------------------------
+  // subject predicate object [graph] . [# comment]
+  // Returns where the line break ending the statement is, or NULL.
+  //----------------------------------------------------------------------
+  char const* parse_statement(
+    structural_scanner& scan, char const* p, char const* end, view_triple& t)
+  {
+    if ((p = parse_subject(scan, p, end, t.subject)) == NULL)
+      return NULL;
+    if ((p = parse_iri(scan, skip_space(p, end), end, t.predicate)) == NULL)
+      return NULL;
+    if ((p = parse_object(scan, skip_space(p, end), end, t.object)) == NULL)
+      return NULL;
+
+    // An N-Quads graph label; the graph is not kept.
+    p = skip_space(p, end);
+    if (p != end && *p != '.')
+    {
+      term_view graph;
+      if ((p = parse_subject(scan, p, end, graph)) == NULL)
+        return NULL;
+      p = skip_space(p, end);
+    }
+
+    if (p == end || *p != '.')
+      return NULL;
+    p = skip_space(p + 1, end);
+
+    if (p != end && *p == '#')
+      p = line_end(p, end);
+    if (p != end && *p != '\n')
+      return NULL;
+    return p;
+  }
+
+  char const* parse_subject(
+    structural_scanner& scan, char const* p, char const* end, term_view& t)
+  {
+    if (p != end && *p == '_')
+      return parse_blank(scan, p, end, t);
+    return parse_iri(scan, p, end, t);
+  }
+
+  char const* parse_object(
+    structural_scanner& scan, char const* p, char const* end, term_view& t)
+  {
+    if (p != end && *p == '"')
+      return parse_literal(scan, p, end, t);
+    return parse_subject(scan, p, end, t);
+  }
+
+  char const* parse_iri(
+    structural_scanner& scan, char const* p, char const* end, term_view& t)
+  {
+    if (p == end || *p != '<')
+      return NULL;
+
+    char const* first = ++p;
+    bool escaped = false;
+    scan.start_term(first);
+    for (;;)
+    {
+      // Whitespace, < and " may not appear in an IRI, so the only
+      // structural characters allowed before the closing > are escapes.
+      p = scan.next(p);
+      if (p == end)
+        return NULL;
+      if (*p == '>')
+        break;
+      if (*p != '\\')
+        return NULL;
+      escaped = true;
+      ++p;
+    }
+
+    if (!make_view(scan, uri_term, first, p, escaped, t))
+      return NULL;
+    return p + 1;
+  }
+
+  char const* parse_blank(
+    structural_scanner& scan, char const* p, char const* end, term_view& t)
+  {
+    if (end - p < 3 || p[1] != ':')
+      return NULL;
+
+    char const* first = p + 2;
+    scan.start_term(first);
+    char const* last = scan.next(first);
+
+    // A label may contain dots but not end with one, so a statement
+    // written "_:b1." ends at the dot.
+    while (last != first && last[-1] == '.')
+      --last;
+    if (last == first || !make_view(scan, blank_term, first, last, false, t))
+      return NULL;
+    return last;
+  }
+
+  char const* parse_literal(
+    structural_scanner& scan, char const* p, char const* end, term_view& t)
+  {
+    char const* first = ++p;
+    bool escaped = false;
+    scan.start_term(first);
+    for (;;)
+    {
+      p = scan.next(p);
+      if (p == end || *p == '\n' || *p == '\r')
+        return NULL;
+      if (*p == '"')
+        break;
+      if (*p == '\\')
+      {
+        escaped = true;
+        ++p;
+        if (p == end)
+          return NULL;
+      }
+      ++p;
+    }
+
+    if (!make_view(scan, literal_term, first, p, escaped, t))
+      return NULL;
+    ++p;
+
+    if (p != end && *p == '^')
+    {
+      if (end - p < 2 || p[1] != '^')
+        return NULL;
+      term_view datatype;
+      if ((p = parse_iri(scan, p + 2, end, datatype)) == NULL)
+        return NULL;
+      t.datatype = datatype.data;
+      t.datatype_size = datatype.size;
+    }
+    else if (p != end && *p == '@')
+    {
+      char const* tag = ++p;
+      while (p != end && is_language_char(*p))
+        ++p;
+      if (p == tag)
+        return NULL;
+      t.language = tag;
+      t.language_size = p - tag;
+    }
+    return p;
+  }
+
+  //----------------------------------------------------------------------
+  // Validate the bytes of a term and point t at them, decoding them into
+  // the arena first if they contain escapes. The scanner has already seen
+  // every byte of the term, so unless it found something other than plain
+  // characters there is nothing left to check.
+  //----------------------------------------------------------------------
+  bool make_view(structural_scanner& scan, term_kind kind,
+                 char const* first, char const* last, bool escaped, term_view& t)
+  {
+    bool iri = (kind == uri_term);
+    std::size_t size = last - first;
+    bool ok = true;
+
+    if (escaped)
+    {
+      char* buffer = arena_.allocate(size);
+      std::ptrdiff_t n = unescape(first, last, buffer, iri);
+      if (n < 0)
+        return false;
+      first = buffer;
+      size = static_cast<std::size_t>(n);
+      ok = iri ? validate_iri(first, size) : validate_utf8(first, size);
+    }
+    else if (!scan.term_is_plain(last, iri))
+      ok = iri ? validate_iri(first, size) : validate_utf8(first, size);
+
+    t = term_view(kind, first, size);
+    return ok;
+  }
+
+  void error()
+  {
+    good_ = false;
+    std::cerr << name_ << ":" << line_ << ": bad N-Triples statement" << std::endl;
+  }
+
+  std::string name_;
+  std::size_t line_;
+  bool good_;
+  term_arena arena_;
+};
+
+//===========================================================================
+// The N-Triples / N-Quads parser. It has the same interface as rdf_parser:
+// parse a file or a buffer through an output iterator, optionally with a
+// converter, which here is called with view_triples. rdf_triple_converter,
+// interning_converter and filter_statements( ) all accept those.
+//
+// Malformed statements are reported on std::cerr and skipped; the parse
+// goes on, and the call returns false.
+//===========================================================================
+class ntriples_parser
+{
+public:
+  explicit ntriples_parser(read_options const& opts = read_options())
+    : opts_(opts)
+  {}
+
+  template <typename Iter>
+  bool operator()(std::string const& file_name, Iter dest) const
+  {
+    return (*this)(file_name, dest, rdf_triple_converter());
+  }
+
+  //----------------------------------------------------------------------
+  // Parse a file. Lines are parsed straight out of the read buffers; only
+  // a line split between two buffers is put back together in a copy.
+  // Throws std::domain_error if the file cannot be opened or read.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  bool operator()(std::string const& file_name, Iter dest, Converter conv) const
+  {
+    file_reader reader(file_name, opts_);
+    ntriples_statement_parser statements(file_name);
+    std::string partial;
+
+    reader.for_each_chunk([&](unsigned char const* data, std::size_t size) {
+        char const* p = reinterpret_cast<char const*>(data);
+        char const* end = p + size;
+
+        if (!partial.empty())
+        {
+          char const* nl = static_cast<char const*>(std::memchr(p, '\n', size));
+          if (nl == NULL)
+          {
+            partial.append(p, end);
+            return;
+          }
+          partial.append(p, nl + 1);
+          dest = statements.parse(partial.data(), partial.data() + partial.size(), dest, conv);
+          partial.clear();
+          p = nl + 1;
+        }
+
+        char const* last = end;
+        while (last != p && last[-1] != '\n')
+          --last;
+
+        dest = statements.parse(p, last, dest, conv);
+        partial.assign(last, end);
+      });
+
+    if (!partial.empty())
+      dest = statements.parse(partial.data(), partial.data() + partial.size(), dest, conv);
+    return statements.good();
+  }
+
+  //----------------------------------------------------------------------
+  // Parse a document that is already in memory. name is only used in
+  // error messages.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  bool parse_buffer(
+    std::string const& name, unsigned char const* data, std::size_t size,
+    Iter dest, Converter conv) const
+  {
+    ntriples_statement_parser statements(name);
+    char const* p = reinterpret_cast<char const*>(data);
+    statements.parse(p, p + size, dest, conv);
+    return statements.good();
+  }
+
+  template <typename Iter>
+  bool parse_buffer(
+    std::string const& name, unsigned char const* data, std::size_t size, Iter dest) const
+  {
+    return parse_buffer(name, data, size, dest, rdf_triple_converter());
+  }
+
+private:
+  read_options opts_;
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines a small thread-safe object pool. It is used to keep
+// expensive-to-construct objects (like raptor worlds and parsers) warm
+// between calls, so that parsing many small documents does not pay the
+// construction cost every time.
+//===========================================================================
+
+#ifndef BST_OBJECT_POOL_HPP_
+#define BST_OBJECT_POOL_HPP_
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <utility>
+#include <functional>
+
+namespace rdf {
+
+//===========================================================================
+// Objects are created on demand by a user-supplied factory and handed out
+// wrapped in a handle. When the handle goes out of scope the object has
+// its reset( ) member called and is put back in the pool for the next
+// caller. The pool must outlive every handle it hands out.
+//===========================================================================
+template <typename T>
+class object_pool
+{
+public:
+  typedef std::function<std::unique_ptr<T>()> factory_type;
+
+  //----------------------------------------------------------------------
+  // A handle gives exclusive access to a pooled object for as long as it
+  // is alive. Handles can be moved but not copied.
+  //----------------------------------------------------------------------
+  class handle
+  {
+  public:
+    handle(object_pool* pool, std::unique_ptr<T> obj)
+      : pool_(pool), obj_(std::move(obj))
+    {}
+
+    handle(handle&& rhs)
+      : pool_(rhs.pool_), obj_(std::move(rhs.obj_))
+    {}
+
+    ~handle()
+    {
+      if (obj_)
+        pool_->release(std::move(obj_));
+    }
+
+    T& operator*() const { return *obj_; }
+    T* operator->() const { return obj_.get(); }
+
+  private:
+    handle(handle const&);
+    handle& operator=(handle const&);
+
+    object_pool* pool_;
+    std::unique_ptr<T> obj_;
+  };
+
+  //----------------------------------------------------------------------
+  // max_idle bounds the number of objects kept around between calls;
+  // anything released beyond that is destroyed instead.
+  //----------------------------------------------------------------------
+  explicit object_pool(
+    factory_type factory,
+    std::size_t max_idle = std::numeric_limits<std::size_t>::max())
+    : factory_(std::move(factory)), max_idle_(max_idle)
+  {}
+
+  //----------------------------------------------------------------------
+  // Take an idle object from the pool, or create a new one if the pool is
+  // empty. Creation happens outside of the lock.
+  //----------------------------------------------------------------------
+  handle acquire()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!idle_.empty())
+      {
+        std::unique_ptr<T> obj = std::move(idle_.back());
+        idle_.pop_back();
+        return handle(this, std::move(obj));
+      }
+    }
+    return handle(this, factory_());
+  }
+
+  //----------------------------------------------------------------------
+  // Pre-construct objects so that the first n callers find them warm.
+  //----------------------------------------------------------------------
+  void reserve(std::size_t n)
+  {
+    std::vector<std::unique_ptr<T>> fresh;
+    for (std::size_t i = 0; i < n; ++i)
+      fresh.push_back(factory_());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& obj : fresh)
+      if (idle_.size() < max_idle_)
+        idle_.push_back(std::move(obj));
+  }
+
+  std::size_t idle() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+  }
+
+private:
+  object_pool(object_pool const&);
+  object_pool& operator=(object_pool const&);
+
+  void release(std::unique_ptr<T> obj)
+  {
+    obj->reset();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < max_idle_)
+      idle_.push_back(std::move(obj));
+  }
+
+  factory_type factory_;
+  std::size_t max_idle_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<T>> idle_;
+};
+
+} // namespace rdf
+
+#endif
@@ -28,10 +28,15 @@
 #define BST_ONTOLOGY_VISITORS_HPP_
 
 #include "rdf_parser.hpp"
+#include "sharded.hpp"
 
 #include <list>
+#include <mutex>
+#include <memory>
+#include <sstream>
 #include <utility>
 #include <iostream>
+#include <iterator>
 #include <algorithm>
 
 #include <boost/fusion/container/vector.hpp>
@@ -115,7 +120,7 @@ struct store_triples_if
 
 private:
   std::list<rdf::rdf_triple>& triple_store_;
-  Predicate&& pred_;
+  Predicate pred_;
 };
 
 namespace factories {
@@ -235,6 +240,164 @@ aggregate<Funcs...> make_aggregate(Funcs&&... funcs)
 
 } // namespace factories
 
+//===========================================================================
+// Thread-safe variants of the visitors above, for parallel walks and
+// batch parses. They hold their state by value instead of referring to
+// the caller's: every thread fills a shard of its own (a local list or
+// counter) without locking, and the shards are merged when the result is
+// asked for. Copies share their shards, so a visitor may be copied into
+// as many workers as needed. Read the results once the workers are done.
+//===========================================================================
+namespace concurrent {
+
+namespace {
+
+template <typename T>
+struct splice_shard
+{
+  void operator()(std::list<T>& merged, std::list<T>& shard) const
+  {
+    merged.splice(std::end(merged), shard);
+  }
+};
+
+template <typename T>
+struct add_shard
+{
+  void operator()(T& merged, T& shard) const
+  {
+    merged += shard;
+    shard = T();
+  }
+};
+
+} // namespace
+
+//----------------------------------------------------------------------
+// Write the triples of each node to a stream. The triples of one node
+// are formatted into a thread-local buffer and written in one go, so
+// the stream is locked once per node rather than once per triple.
+//----------------------------------------------------------------------
+struct output_triples
+{
+  explicit output_triples(std::ostream& os)
+    : os_(&os), mutex_(std::make_shared<std::mutex>())
+  {}
+
+  template <typename Iter>
+  void operator()(std::string const&, Iter first, Iter last) const
+  {
+    std::ostringstream buf;
+    std::copy(first, last, std::ostream_iterator<typename Iter::value_type>(buf, "\n"));
+
+    std::lock_guard<std::mutex> lock(*mutex_);
+    *os_ << buf.str();
+  }
+
+private:
+  std::ostream* os_;
+  std::shared_ptr<std::mutex> mutex_;
+};
+
+//----------------------------------------------------------------------
+// Store the triples.
+//----------------------------------------------------------------------
+struct store_triples
+{
+  template <typename Iter>
+  void operator()(std::string const&, Iter first, Iter last) const
+  {
+    std::copy(first, last, std::back_inserter(triples_.local()));
+  }
+
+  std::list<rdf::rdf_triple>& triples() const
+  {
+    return triples_.merge(splice_shard<rdf::rdf_triple>());
+  }
+
+private:
+  sharded<std::list<rdf::rdf_triple>> triples_;
+};
+
+//----------------------------------------------------------------------
+// Store the triples if they match a given predicate. The predicate is
+// held by value and must be safe to call from several threads.
+//----------------------------------------------------------------------
+template <typename Predicate>
+struct store_triples_if
+{
+  explicit store_triples_if(Predicate pred)
+    : pred_(std::move(pred))
+  {}
+
+  template <typename Iter>
+  void operator()(std::string const&, Iter first, Iter last) const
+  {
+    std::copy_if(first, last, std::back_inserter(triples_.local()), pred_);
+  }
+
+  std::list<rdf::rdf_triple>& triples() const
+  {
+    return triples_.merge(splice_shard<rdf::rdf_triple>());
+  }
+
+private:
+  Predicate pred_;
+  sharded<std::list<rdf::rdf_triple>> triples_;
+};
+
+namespace factories {
+
+template <typename Predicate>
+rdf::visitors::concurrent::store_triples_if<Predicate>
+store_triples_if(Predicate pred)
+{
+  return rdf::visitors::concurrent::store_triples_if<Predicate>(std::move(pred));
+}
+
+} // namespace factories
+
+//----------------------------------------------------------------------
+// Store the uri's visited.
+//----------------------------------------------------------------------
+struct store_uris
+{
+  template <typename Iter>
+  void operator()(std::string const& str, Iter, Iter) const
+  {
+    uris_.local().push_back(str);
+  }
+
+  std::list<std::string>& uris() const
+  {
+    return uris_.merge(splice_shard<std::string>());
+  }
+
+private:
+  sharded<std::list<std::string>> uris_;
+};
+
+//----------------------------------------------------------------------
+// Count the number of nodes visited.
+//----------------------------------------------------------------------
+template <typename T = std::size_t>
+struct count_nodes
+{
+  template <typename Iter>
+  void operator()(std::string const&, Iter, Iter) const
+  { ++size_.local(); }
+
+  T count() const
+  {
+    return size_.merge(add_shard<T>());
+  }
+
+private:
+  sharded<T> size_;
+};
+
+} // namespace concurrent
+
 } // namespace visitors
 } // namespace rdf
 
@@ -31,6 +31,8 @@
 #define BST_ONTOLOGY_WALKER_HPP_
 
 #include "rdf_parser.hpp"
+#include "document_link_graph.hpp"
+#include "crawl_frontier.hpp"
 
 #include <list>
 #include <set>
@@ -38,7 +40,7 @@
 #include <utility>
 #include <iostream>
 #include <unordered_set>
-#include <queue>
+#include <vector>
 
 namespace rdf {
 
@@ -46,36 +48,72 @@ namespace rdf {
 // This function object walks an ontology, applying a function-type at each
 // node it encounters. Typical of graph walking algorithms, it keeps a
 // closed list of nodes (in this case uri's) that have already been visited.
+// The order nodes are visited in is up to the Frontier policy (see
+// crawl_frontier.hpp): breadth-first by default, or most important first
+// with an opic_frontier.
 //===========================================================================
-template <typename Function, typename Predicate>
+template <typename Function, typename Predicate, typename Frontier = bfs_frontier>
 class ontology_walker
 {
   Function func_;
   Predicate pred_;
+  Frontier frontier_;
+  rdf_web_parser parser_;
 
 public:
-  ontology_walker(Function&& func, Predicate&& pred)
-    : func_(std::forward<Function>(func)), pred_(std::forward<Predicate>(pred))
+  ontology_walker(Function&& func, Predicate&& pred, Frontier frontier = Frontier())
+    : func_(std::forward<Function>(func)), pred_(std::forward<Predicate>(pred)),
+      frontier_(std::move(frontier))
   {}
 
   //----------------------------------------------------------------------
   // Given a uri string as a starting point, walk the graph created by
   // the rdf documents. Each time a URI appears as the object of a
-  // triple, attempt to parse it and contine walking. The walking order
-  // is breadth-first-search (it uses a queue) but this may be changed
-  // via a tag class or something later on...
+  // triple, attempt to parse it and contine walking. Each walk starts
+  // from a copy of the frontier the walker was made with.
   //----------------------------------------------------------------------
   void operator()(std::string uri) const
+  {
+    Frontier fringe(frontier_);
+    walk(uri, fringe, NULL);
+  }
+
+  //----------------------------------------------------------------------
+  // Walk as above, and record in links which document linked to which:
+  // every uri put on the fringe is a link from the document it was found
+  // in, through the predicate of its triple.
+  //----------------------------------------------------------------------
+  void operator()(std::string uri, document_link_graph& links) const
+  {
+    Frontier fringe(frontier_);
+    walk(uri, fringe, &links);
+  }
+
+  //----------------------------------------------------------------------
+  // Walk with the caller's frontier, which can be looked at afterwards
+  // (for an opic_frontier's importance estimates, say), or kept to carry
+  // on from where a walk left off.
+  //----------------------------------------------------------------------
+  void operator()(std::string uri, Frontier& fringe) const
+  {
+    walk(uri, fringe, NULL);
+  }
+
+  void operator()(std::string uri, Frontier& fringe, document_link_graph& links) const
+  {
+    walk(uri, fringe, &links);
+  }
+
+private:
+  void walk(std::string const& uri, Frontier& fringe, document_link_graph* links) const
   {
     std::unordered_set<std::string> closed_list;
-    std::queue<std::string> fringe;
     fringe.push(uri);
 
     while (!fringe.empty())
     {
       // Get the next element and remove it from the fringe.
-      std::string current_uri = fringe.front();
-      fringe.pop();
+      std::string current_uri = fringe.pop();
 
       if (closed_list.find(current_uri) == closed_list.end())
       {
@@ -83,15 +121,22 @@ public:
         closed_list.insert(current_uri);
 
         // Parse the uri into triples.
-        rdf_web_parser p;
         std::list<rdf_triple> triples;
-        bool good_rdf = p(current_uri, std::back_inserter(triples));
+        std::vector<std::string> found;
+        bool good_rdf = parser_(current_uri, std::back_inserter(triples));
+
+        document_link_graph::document current_doc = document_link_graph::no_document;
+        if (links != NULL)
+        {
+          current_doc = links->add_document(current_uri);
+          links->mark_visited(current_doc);
+        }
 
         if (good_rdf)
         {
           // Remove the triples that do not match the supplied predicate.
           auto new_end =
-            std::remove_if(std::begin(triples), std::end(triples), [&pred_](rdf_triple const& t)
+            std::remove_if(std::begin(triples), std::end(triples), [this](rdf_triple const& t)
               {
                 return !pred_(t);
               });
@@ -102,17 +147,26 @@ public:
           // Add those triples that are uris to the fringe.
           std::for_each(
             std::begin(triples), new_end,
-            [&fringe, &pred_](rdf_triple t)
+            [&found, links, current_doc](rdf_triple t)
             {
               // If the triple matches the predicate, add it to the fringe.
               auto obj = t.object();
               if (is_uri(obj))
               {
                 auto next_uri = term_cast<rdf_uri>(obj);
-                fringe.push(to_std_string(next_uri.uri()));
+                found.push_back(to_std_string(next_uri.uri()));
+
+                if (links != NULL)
+                  links->add_link(
+                    current_doc, links->add_document(found.back()),
+                    links->add_predicate(
+                      to_std_string(term_cast<rdf_uri>(t.predicate()).uri())));
               }
             });
         }
+
+        // Let the frontier know what was found, to choose what is next.
+        fringe.fetched(current_uri, found);
       }
     }
   }
@@ -146,6 +200,14 @@ make_ontology_walker(Function&& func)
     std::forward<Function>(func), true_const_pred());
 }
 
+template <typename Function, typename Predicate, typename Frontier>
+ontology_walker<Function, Predicate, Frontier>
+make_ontology_walker(Function&& func, Predicate&& pred, Frontier frontier)
+{
+  return ontology_walker<Function, Predicate, Frontier>(
+    std::forward<Function>(func), std::forward<Predicate>(pred), std::move(frontier));
+}
+
 } // namespace factories
 } // namespace rdf
 
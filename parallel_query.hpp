@@ -0,0 +1,316 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines parallel query execution over permutation_indexes:
+// groups of triple patterns matched by every worker of a morsel_executor
+// at once, with filters and per-worker aggregation.
+//===========================================================================
+
+#ifndef BST_PARALLEL_QUERY_HPP_
+#define BST_PARALLEL_QUERY_HPP_
+
+#include "term_id.hpp"
+#include "simd_filter.hpp"
+#include "triple_pattern.hpp"
+#include "morsel_executor.hpp"
+#include "permutation_index.hpp"
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+namespace rdf {
+
+//===========================================================================
+// A query: patterns to match, column tests on the triples of some of the
+// patterns (pattern number, test), evaluated with the simd filter kernels
+// over whole index ranges, and a test on complete matches.
+//===========================================================================
+struct parallel_query
+{
+  std::vector<triple_pattern> patterns;
+  std::vector<std::pair<std::size_t, simd::column_test>> triple_filters;
+  std::function<bool(binding const&)> filter;
+};
+
+//----------------------------------------------------------------------
+// The order the patterns are matched in and the column tests of each.
+// The pattern with the fewest triples for its terms drives the scan;
+// the others follow greedily, each time one sharing a bound variable,
+// with the most positions known and then the fewest triples.
+//----------------------------------------------------------------------
+struct query_plan
+{
+  std::vector<triple_pattern> patterns;
+  std::vector<std::vector<simd::column_test>> tests;
+  unsigned variables;
+};
+
+inline query_plan plan_query(permutation_indexes const& indexes, parallel_query const& q)
+{
+  if (q.patterns.empty())
+    throw std::invalid_argument("query without patterns");
+
+  unsigned variables = variable_count(q.patterns);
+  binding unbound(variables, invalid_term_id);
+  std::vector<std::size_t> sizes;
+  for (auto const& p : q.patterns)
+    sizes.push_back(indexes.lookup(p, unbound).size());
+
+  query_plan plan;
+  plan.variables = variables;
+  std::vector<char> used(q.patterns.size(), 0);
+  std::vector<char> bound(variables, 0);
+  for (std::size_t step = 0; step < q.patterns.size(); ++step)
+  {
+    std::size_t best = q.patterns.size();
+    bool best_connected = false;
+    unsigned best_known = 0;
+    for (std::size_t k = 0; k < q.patterns.size(); ++k)
+    {
+      if (used[k])
+        continue;
+      bool connected = false;
+      unsigned known = 0;
+      for (unsigned i = 0; i < 3; ++i)
+      {
+        pattern_term const& t = q.patterns[k][i];
+        bool is_bound = t.is_variable() && bound[t.variable_number()];
+        connected = connected || is_bound;
+        known += !t.is_variable() || is_bound;
+      }
+
+      // The driver is simply the smallest range. After it, a pattern
+      // that shares no bound variable would multiply the matches, so it
+      // comes only when nothing connected is left.
+      bool better;
+      if (best == q.patterns.size())
+        better = true;
+      else if (step == 0)
+        better = sizes[k] < sizes[best];
+      else if (connected != best_connected)
+        better = connected;
+      else
+        better = known > best_known || (known == best_known && sizes[k] < sizes[best]);
+      if (better)
+      {
+        best = k;
+        best_connected = connected;
+        best_known = known;
+      }
+    }
+
+    used[best] = 1;
+    plan.patterns.push_back(q.patterns[best]);
+    plan.tests.push_back(std::vector<simd::column_test>());
+    for (auto const& f : q.triple_filters)
+      if (f.first == best)
+        plan.tests.back().push_back(f.second);
+    for (unsigned i = 0; i < 3; ++i)
+      if (q.patterns[best][i].is_variable())
+        bound[q.patterns[best][i].variable_number()] = 1;
+  }
+  return plan;
+}
+
+//----------------------------------------------------------------------
+// The pipeline each worker runs over its morsels of the driving range:
+// filter the morsel, then extend each surviving triple's binding through
+// the other patterns by index lookups, filtering each range the same
+// way, and hand complete matches to the sink.
+//----------------------------------------------------------------------
+template <typename Sink>
+class match_pipeline
+{
+  static const std::size_t block_size = 4096;
+
+  struct worker_state
+  {
+    std::vector<binding> bindings;
+    std::vector<std::vector<std::uint32_t>> selections;
+  };
+
+public:
+  match_pipeline(permutation_indexes const& indexes, query_plan const& plan,
+                 std::function<bool(binding const&)> const& filter,
+                 Sink& sink, std::size_t workers)
+    : indexes_(indexes), plan_(plan), filter_(filter), sink_(sink), states_(workers)
+  {
+    for (auto& s : states_)
+    {
+      s.bindings.assign(plan.patterns.size() + 1, binding(plan.variables, invalid_term_id));
+      s.selections.assign(plan.patterns.size(), std::vector<std::uint32_t>(block_size));
+    }
+    driving_ = indexes.lookup(plan.patterns[0], states_[0].bindings[0]);
+  }
+
+  std::size_t size() const { return driving_.size(); }
+
+  void operator()(std::size_t worker, std::size_t begin, std::size_t end)
+  {
+    worker_state& s = states_[worker];
+    for (; begin < end; begin += block_size)
+      match_block(worker, s, 0, driving_.first + begin,
+                  std::min(end - begin, std::size_t(block_size)));
+  }
+
+private:
+  //----------------------------------------------------------------------
+  // Match the pattern at depth against a block of at most block_size
+  // candidate triples, under the binding at that depth.
+  //----------------------------------------------------------------------
+  void match_block(std::size_t worker, worker_state& s, std::size_t depth,
+                   id_triple const* triples, std::size_t n)
+  {
+    std::vector<simd::column_test> const& tests = plan_.tests[depth];
+    std::uint32_t* sel = s.selections[depth].data();
+    std::size_t count = n;
+    if (!tests.empty())
+    {
+      count = simd::select(triples, n, tests[0], sel);
+      for (std::size_t i = 1; i < tests.size(); ++i)
+        count = simd::refine(triples, tests[i], sel, count);
+    }
+
+    triple_pattern const& p = plan_.patterns[depth];
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      id_triple const& t = triples[tests.empty() ? i : sel[i]];
+      if (!matches(p, t))
+        continue;
+      binding& b = s.bindings[depth + 1];
+      b = s.bindings[depth];
+      bind_variables(p, t, b);
+      extend(worker, s, depth + 1);
+    }
+  }
+
+  void extend(std::size_t worker, worker_state& s, std::size_t depth)
+  {
+    binding const& b = s.bindings[depth];
+    if (depth == plan_.patterns.size())
+    {
+      if (!filter_ || filter_(b))
+        sink_(worker, b);
+      return;
+    }
+
+    triple_range r = indexes_.lookup(plan_.patterns[depth], b);
+    for (id_triple const* t = r.first; t < r.last; t += block_size)
+      match_block(worker, s, depth, t, std::min(std::size_t(r.last - t), std::size_t(block_size)));
+  }
+
+  permutation_indexes const& indexes_;
+  query_plan const& plan_;
+  std::function<bool(binding const&)> const& filter_;
+  Sink& sink_;
+  std::vector<worker_state> states_;
+  triple_range driving_;
+};
+
+//===========================================================================
+// Call sink(worker, binding) for every match of the query. The sink is
+// called from all the executor's workers at once; worker tells them
+// apart.
+//===========================================================================
+template <typename Sink>
+void parallel_for_each_match(morsel_executor& executor, permutation_indexes const& indexes,
+                             parallel_query const& q, Sink sink,
+                             std::size_t morsel_size = 16384)
+{
+  query_plan plan = plan_query(indexes, q);
+  match_pipeline<Sink> pipeline(indexes, plan, q.filter, sink, executor.size());
+  executor.for_each_morsel(pipeline.size(), [&pipeline](std::size_t w, std::size_t b, std::size_t e) {
+      pipeline(w, b, e);
+    }, morsel_size);
+}
+
+//===========================================================================
+// Aggregate the matches of the query: each worker folds the matches it
+// finds into its own copy of init with accumulate(state, binding), and
+// the copies are folded together at the end with combine(state, other).
+//===========================================================================
+template <typename State, typename Accumulate, typename Combine>
+State parallel_aggregate(morsel_executor& executor, permutation_indexes const& indexes,
+                         parallel_query const& q, State init,
+                         Accumulate accumulate, Combine combine)
+{
+  // Each on lines of its own, so workers updating small states do not
+  // share them.
+  struct alignas(cache_line_size) slot
+  {
+    State state;
+  };
+
+  std::vector<slot, cache_line_allocator<slot>> slots(executor.size(), slot{ init });
+  parallel_for_each_match(executor, indexes, q,
+    [&slots, &accumulate](std::size_t worker, binding const& b) {
+      accumulate(slots[worker].state, b);
+    });
+
+  State result = init;
+  for (auto const& s : slots)
+    combine(result, s.state);
+  return result;
+}
+
+inline std::uint64_t parallel_count(morsel_executor& executor,
+                                    permutation_indexes const& indexes,
+                                    parallel_query const& q)
+{
+  return parallel_aggregate(executor, indexes, q, std::uint64_t(0),
+    [](std::uint64_t& n, binding const&) { ++n; },
+    [](std::uint64_t& n, std::uint64_t m) { n += m; });
+}
+
+//----------------------------------------------------------------------
+// The number of matches for each term a variable takes.
+//----------------------------------------------------------------------
+inline std::unordered_map<term_id, std::uint64_t> parallel_group_count(
+  morsel_executor& executor, permutation_indexes const& indexes,
+  parallel_query const& q, unsigned variable)
+{
+  typedef std::unordered_map<term_id, std::uint64_t> counts;
+  return parallel_aggregate(executor, indexes, q, counts(),
+    [variable](counts& c, binding const& b) { ++c[b[variable]]; },
+    [](counts& c, counts const& other) {
+      for (auto const& e : other)
+        c[e.first] += e.second;
+    });
+}
+
+inline std::vector<binding> parallel_collect(morsel_executor& executor,
+                                             permutation_indexes const& indexes,
+                                             parallel_query const& q)
+{
+  typedef std::vector<binding> rows;
+  return parallel_aggregate(executor, indexes, q, rows(),
+    [](rows& r, binding const& b) { r.push_back(b); },
+    [](rows& r, rows const& other) { r.insert(r.end(), other.begin(), other.end()); });
+}
+
+} // namespace rdf
+
+#endif
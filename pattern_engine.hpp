@@ -0,0 +1,273 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines the pattern engine: matching groups of triple
+// patterns against a triple_store, using its membership_index to narrow
+// down the terms each variable can take before any triple is joined.
+//===========================================================================
+
+#ifndef BST_PATTERN_ENGINE_HPP_
+#define BST_PATTERN_ENGINE_HPP_
+
+#include "term_id.hpp"
+#include "vocabulary.hpp"
+#include "triple_store.hpp"
+#include "triple_pattern.hpp"
+#include "roaring_bitmap.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+
+namespace rdf {
+
+namespace {
+
+//----------------------------------------------------------------------
+// The index sets a variable must be in: the subjects of each known
+// predicate it is the subject of, or the instances of the class, for an
+// rdf:type with a known class. Smallest first.
+//----------------------------------------------------------------------
+inline std::vector<roaring_bitmap const*> constraint_sets(
+  triple_store const& store, std::vector<triple_pattern> const& patterns,
+  unsigned variable)
+{
+  std::vector<roaring_bitmap const*> sets;
+  for (auto const& p : patterns)
+  {
+    if (!p.subject.is_variable() || p.subject.variable_number() != variable
+        || p.predicate.is_variable())
+      continue;
+    if (p.predicate.id() == vocab::rdf_type && !p.object.is_variable())
+      sets.push_back(&store.index().instances_of(p.object.id()));
+    else
+      sets.push_back(&store.index().subjects_of(p.predicate.id()));
+  }
+
+  std::vector<std::pair<std::uint64_t, roaring_bitmap const*>> sized;
+  for (roaring_bitmap const* s : sets)
+    sized.push_back(std::make_pair(s->cardinality(), s));
+  std::sort(sized.begin(), sized.end());
+  for (std::size_t i = 0; i < sized.size(); ++i)
+    sets[i] = sized[i].second;
+  return sets;
+}
+
+//----------------------------------------------------------------------
+// Whether the index sets alone decide which terms the variable matches:
+// every pattern is about it as a subject and is either an rdf:type with
+// a known class or a known predicate with an object nothing else uses.
+//----------------------------------------------------------------------
+inline bool is_star(std::vector<triple_pattern> const& patterns, unsigned variable)
+{
+  std::vector<unsigned> uses(variable_count(patterns), 0);
+  for (auto const& p : patterns)
+    for (unsigned i = 0; i < 3; ++i)
+      if (p[i].is_variable())
+        ++uses[p[i].variable_number()];
+
+  for (auto const& p : patterns)
+  {
+    if (!p.subject.is_variable() || p.subject.variable_number() != variable
+        || p.predicate.is_variable())
+      return false;
+    bool typed = p.predicate.id() == vocab::rdf_type && !p.object.is_variable();
+    bool any_object = p.object.is_variable() && uses[p.object.variable_number()] == 1;
+    if (!typed && !any_object)
+      return false;
+  }
+  return !patterns.empty();
+}
+
+} // namespace
+
+//===========================================================================
+// The terms a variable can take in a match of the patterns, as far as the
+// store's membership index can tell. Returns false, leaving out alone, if
+// no pattern constrains the variable that way.
+//===========================================================================
+inline bool candidates(triple_store const& store, std::vector<triple_pattern> const& patterns,
+                       unsigned variable, roaring_bitmap& out)
+{
+  std::vector<roaring_bitmap const*> sets = constraint_sets(store, patterns, variable);
+  if (sets.empty())
+    return false;
+
+  out = *sets[0];
+  for (std::size_t i = 1; i < sets.size() && !out.empty(); ++i)
+    out &= *sets[i];
+  return true;
+}
+
+//===========================================================================
+// Call f(binding) for every match of the patterns in the store; a triple
+// in the store more than once matches more than once.
+//
+// Variables with index sets are restricted to them first, and a single
+// scan collects each pattern's triples among those allowed. The patterns
+// are then hash joined, smallest first and then always the smallest one
+// sharing a variable with those joined so far.
+//===========================================================================
+template <typename Func>
+void for_each_match(triple_store const& store, std::vector<triple_pattern> const& patterns,
+                    Func f)
+{
+  unsigned variables = variable_count(patterns);
+  std::vector<roaring_bitmap> allowed(variables);
+  std::vector<char> restricted(variables, 0);
+  for (unsigned v = 0; v < variables; ++v)
+  {
+    restricted[v] = candidates(store, patterns, v, allowed[v]);
+    if (restricted[v] && allowed[v].empty())
+      return;
+  }
+
+  std::vector<std::vector<id_triple>> found(patterns.size());
+  for (id_triple const& t : store.triples())
+    for (std::size_t k = 0; k < patterns.size(); ++k)
+    {
+      triple_pattern const& p = patterns[k];
+      if (!matches(p, t))
+        continue;
+      bool keep = true;
+      for (unsigned i = 0; i < 3 && keep; ++i)
+        if (p[i].is_variable() && restricted[p[i].variable_number()])
+          keep = allowed[p[i].variable_number()].contains(term_at(t, i));
+      if (keep)
+        found[k].push_back(t);
+    }
+
+  std::vector<char> joined(patterns.size(), 0);
+  std::vector<char> bound(variables, 0);
+  std::vector<binding> rows(1, binding(variables, invalid_term_id));
+  for (std::size_t step = 0; step < patterns.size(); ++step)
+  {
+    // Pick the next pattern.
+    std::size_t next = patterns.size();
+    bool next_shares = false;
+    for (std::size_t k = 0; k < patterns.size(); ++k)
+    {
+      if (joined[k])
+        continue;
+      bool shares = false;
+      for (unsigned i = 0; i < 3; ++i)
+        shares = shares || (patterns[k][i].is_variable() && bound[patterns[k][i].variable_number()]);
+      if (next == patterns.size() || (shares && !next_shares)
+          || (shares == next_shares && found[k].size() < found[next].size()))
+      {
+        next = k;
+        next_shares = shares;
+      }
+    }
+
+    // Hash its triples on the variables already bound, and extend every
+    // row with the triples agreeing with it.
+    triple_pattern const& p = patterns[next];
+    std::vector<unsigned> key_variables;
+    std::vector<unsigned> key_positions;
+    for (unsigned i = 0; i < 3; ++i)
+      if (p[i].is_variable() && bound[p[i].variable_number()]
+          && std::find(key_variables.begin(), key_variables.end(),
+                       p[i].variable_number()) == key_variables.end())
+      {
+        key_variables.push_back(p[i].variable_number());
+        key_positions.push_back(i);
+      }
+
+    std::unordered_multimap<join_key, std::size_t, join_key_hash> table;
+    table.reserve(found[next].size());
+    for (std::size_t j = 0; j < found[next].size(); ++j)
+    {
+      join_key k = { { invalid_term_id, invalid_term_id, invalid_term_id } };
+      for (std::size_t i = 0; i < key_positions.size(); ++i)
+        k.values[i] = term_at(found[next][j], key_positions[i]);
+      table.insert(std::make_pair(k, j));
+    }
+
+    std::vector<binding> extended;
+    for (binding const& row : rows)
+    {
+      join_key k = { { invalid_term_id, invalid_term_id, invalid_term_id } };
+      for (std::size_t i = 0; i < key_variables.size(); ++i)
+        k.values[i] = row[key_variables[i]];
+      auto range = table.equal_range(k);
+      for (auto it = range.first; it != range.second; ++it)
+      {
+        extended.push_back(row);
+        bind_variables(p, found[next][it->second], extended.back());
+      }
+    }
+    rows.swap(extended);
+    if (rows.empty())
+      return;
+
+    joined[next] = 1;
+    for (unsigned i = 0; i < 3; ++i)
+      if (p[i].is_variable())
+        bound[p[i].variable_number()] = 1;
+  }
+
+  for (binding const& row : rows)
+    f(row);
+}
+
+inline std::uint64_t count_matches(triple_store const& store,
+                                   std::vector<triple_pattern> const& patterns)
+{
+  std::uint64_t n = 0;
+  for_each_match(store, patterns, [&n](binding const&) { ++n; });
+  return n;
+}
+
+//===========================================================================
+// The number of distinct terms a variable takes over the matches. When
+// the patterns only ask which predicates and classes the variable has,
+// this is the size of the intersection of their index sets, counted
+// without touching a triple.
+//===========================================================================
+inline std::uint64_t count_distinct(triple_store const& store,
+                                    std::vector<triple_pattern> const& patterns,
+                                    unsigned variable)
+{
+  if (is_star(patterns, variable))
+  {
+    std::vector<roaring_bitmap const*> sets = constraint_sets(store, patterns, variable);
+    if (sets.size() == 1)
+      return sets[0]->cardinality();
+
+    roaring_bitmap common(*sets[0]);
+    for (std::size_t i = 1; i + 1 < sets.size(); ++i)
+      common &= *sets[i];
+    return roaring_bitmap::and_cardinality(common, *sets.back());
+  }
+
+  roaring_bitmap values;
+  for_each_match(store, patterns, [&values, variable](binding const& b) {
+      values.add(b[variable]);
+    });
+  return values.cardinality();
+}
+
+} // namespace rdf
+
+#endif
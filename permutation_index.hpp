@@ -0,0 +1,177 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines permutation_indexes: a store's triples sorted three
+// ways, SPO, POS and OSP, so that the triples matching any combination of
+// known subject, predicate and object are one contiguous range.
+//===========================================================================
+
+#ifndef BST_PERMUTATION_INDEX_HPP_
+#define BST_PERMUTATION_INDEX_HPP_
+
+#include "term_id.hpp"
+#include "thread_pool.hpp"
+#include "triple_pattern.hpp"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace rdf {
+
+//===========================================================================
+// A range of triples, as laid out in memory by one of the orders. The
+// triples keep their subject, predicate, object layout whatever the
+// order, so the simd filter kernels apply to any range.
+//===========================================================================
+struct triple_range
+{
+  id_triple const* first;
+  id_triple const* last;
+
+  std::size_t size() const { return last - first; }
+  bool empty() const { return first == last; }
+};
+
+//===========================================================================
+// Each order is a full copy of the triples, sorted in parallel. Lookups
+// use the order whose prefix covers the known positions:
+//
+//   S, SP, SPO -> SPO     P, PO -> POS     O, OS -> OSP
+//
+// The indexes are a snapshot; rebuild them after changing the store.
+//===========================================================================
+class permutation_indexes
+{
+public:
+  enum order { spo, pos, osp };
+
+  permutation_indexes(std::vector<id_triple> const& triples, thread_pool& workers)
+  {
+    for (int o = spo; o <= osp; ++o)
+    {
+      std::vector<id_triple>& sorted = sorted_[o];
+      sorted = triples;
+      parallel_sort(workers, sorted.begin(), sorted.end(), order_less(static_cast<order>(o)));
+    }
+  }
+
+  std::size_t size() const { return sorted_[spo].size(); }
+
+  triple_range all(order o = spo) const
+  {
+    triple_range r = { sorted_[o].data(), sorted_[o].data() + sorted_[o].size() };
+    return r;
+  }
+
+  //----------------------------------------------------------------------
+  // The triples with the given terms; invalid_term_id leaves a position
+  // open.
+  //----------------------------------------------------------------------
+  triple_range lookup(term_id s, term_id p, term_id o) const
+  {
+    bool has_s = s != invalid_term_id;
+    bool has_p = p != invalid_term_id;
+    bool has_o = o != invalid_term_id;
+
+    if (has_s && (has_p || !has_o))
+      return range(spo, s, has_p ? p : invalid_term_id, has_p ? o : invalid_term_id);
+    if (has_p)
+      return range(pos, p, o, invalid_term_id);
+    if (has_o)
+      return range(osp, o, s, invalid_term_id);
+    return all();
+  }
+
+  //----------------------------------------------------------------------
+  // The triples that can match a pattern under a partial binding: those
+  // with its terms and the values of its bound variables.
+  //----------------------------------------------------------------------
+  triple_range lookup(triple_pattern const& pattern, binding const& b) const
+  {
+    term_id terms[3];
+    for (unsigned i = 0; i < 3; ++i)
+      terms[i] = pattern[i].is_variable() ? b[pattern[i].variable_number()] : pattern[i].id();
+    return lookup(terms[0], terms[1], terms[2]);
+  }
+
+private:
+  //----------------------------------------------------------------------
+  // The key of a triple in an order: its terms, most significant first.
+  //----------------------------------------------------------------------
+  static id_triple key(id_triple const& t, order o)
+  {
+    id_triple k = t;
+    if (o == pos)
+    {
+      k.subject = t.predicate; k.predicate = t.object; k.object = t.subject;
+    }
+    else if (o == osp)
+    {
+      k.subject = t.object; k.predicate = t.subject; k.object = t.predicate;
+    }
+    return k;
+  }
+
+  struct order_less
+  {
+    explicit order_less(order o) : o_(o) {}
+    bool operator()(id_triple const& a, id_triple const& b) const
+    {
+      return key(a, o_) < key(b, o_);
+    }
+    order o_;
+  };
+
+  //----------------------------------------------------------------------
+  // The triples of an order whose key starts with the known terms; the
+  // unknown ones, invalid_term_id, come last.
+  //----------------------------------------------------------------------
+  triple_range range(order o, term_id a, term_id b, term_id c) const
+  {
+    std::vector<id_triple> const& v = sorted_[o];
+    auto compare_prefix = [o, a, b, c](id_triple const& t) {
+      id_triple k = key(t, o);
+      if (k.subject != a) return k.subject < a ? -1 : 1;
+      if (b == invalid_term_id) return 0;
+      if (k.predicate != b) return k.predicate < b ? -1 : 1;
+      if (c == invalid_term_id) return 0;
+      if (k.object != c) return k.object < c ? -1 : 1;
+      return 0;
+    };
+
+    auto first = std::partition_point(v.begin(), v.end(), [&](id_triple const& t) {
+        return compare_prefix(t) < 0;
+      });
+    auto last = std::partition_point(first, v.end(), [&](id_triple const& t) {
+        return compare_prefix(t) == 0;
+      });
+    triple_range r = { v.data() + (first - v.begin()), v.data() + (last - v.begin()) };
+    return r;
+  }
+
+  std::vector<id_triple> sorted_[3];
+};
+
+} // namespace rdf
+
+#endif
@@ -46,9 +46,14 @@
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
+#include <mutex>
 
 #include <cstdio>
 
+#include "object_pool.hpp"
+#include "file_reader.hpp"
+#include "term_id.hpp"
+
 namespace rdf {
 
 //===========================================================================
@@ -89,7 +94,11 @@ struct rdf_uri
     : uri_(uri == NULL ? unsigned_string() : raptor_uri_as_string(uri))
   {}
 
-  unsigned_string uri() const { return uri_; }
+  rdf_uri(char const* data, std::size_t size)
+    : uri_(reinterpret_cast<unsigned char const*>(data), size)
+  {}
+
+  unsigned_string const& uri() const { return uri_; }
 
 private:
   unsigned_string uri_;
@@ -105,6 +114,11 @@ struct rdf_literal
       literal_uri_(lit.datatype)
   {}
 
+  rdf_literal(char const* data, std::size_t size, rdf_uri const& datatype)
+    : literal_(reinterpret_cast<unsigned char const*>(data), size),
+      literal_uri_(datatype)
+  {}
+
   unsigned_string value() const { return literal_; }
   rdf_uri uri() const { return literal_uri_; }
 
@@ -122,6 +136,10 @@ struct rdf_blank
     : str_(blnk.string, blnk.string_len)
   {}
 
+  rdf_blank(char const* data, std::size_t size)
+    : str_(reinterpret_cast<unsigned char const*>(data), size)
+  {}
+
   unsigned_string value() const { return str_; }
 
 private:
@@ -161,17 +179,17 @@ struct is_blank_pred_visitor : boost::static_visitor<bool>
 
 } // namespace
 
-inline bool is_uri(rdf_term& t)
+inline bool is_uri(rdf_term const& t)
 {
   return boost::apply_visitor(is_uri_pred_visitor(), t);
 }
 
-inline bool is_literal(rdf_term& t)
+inline bool is_literal(rdf_term const& t)
 {
   return boost::apply_visitor(is_literal_pred_visitor(), t);
 }
 
-inline bool is_blank(rdf_term& t)
+inline bool is_blank(rdf_term const& t)
 {
   return boost::apply_visitor(is_blank_pred_visitor(), t);
 }
@@ -180,9 +198,9 @@ inline bool is_blank(rdf_term& t)
 // term_cast casts rdf_term types into their underlying types.
 //----------------------------------------------------------------------
 
-template <typename T> inline T term_cast(rdf_term&);
+template <typename T> inline T term_cast(rdf_term const&);
 
-template <> inline rdf_uri term_cast<rdf_uri>(rdf_term& t)
+template <> inline rdf_uri term_cast<rdf_uri>(rdf_term const& t)
 {
   if (is_uri(t))
     return boost::get<rdf_uri>(t);
@@ -190,7 +208,7 @@ template <> inline rdf_uri term_cast<rdf_uri>(rdf_term& t)
     throw std::domain_error("bad cast");
 }
 
-template <> inline rdf_literal term_cast<rdf_literal>(rdf_term& t)
+template <> inline rdf_literal term_cast<rdf_literal>(rdf_term const& t)
 {
   if (is_literal(t))
     return boost::get<rdf_literal>(t);
@@ -198,7 +216,7 @@ template <> inline rdf_literal term_cast<rdf_literal>(rdf_term& t)
     throw std::domain_error("bad cast");
 }
 
-template <> inline rdf_blank term_cast<rdf_blank>(rdf_term& t)
+template <> inline rdf_blank term_cast<rdf_blank>(rdf_term const& t)
 {
   if (is_blank(t))
     return boost::get<rdf_blank>(t);
@@ -221,6 +239,25 @@ rdf_term make_rdf_term(raptor_term* const rterm)
   }
 }
 
+//----------------------------------------------------------------------
+// Build an rdf_term from a term view, as handed out by the native
+// parsers.
+//----------------------------------------------------------------------
+inline rdf_term make_rdf_term(term_view const& t)
+{
+  switch (t.kind)
+  {
+  case uri_term:
+    return rdf_uri(t.data, t.size);
+  case literal_term:
+    return rdf_literal(t.data, t.size, rdf_uri(t.datatype, t.datatype_size));
+  case blank_term:
+    return rdf_blank(t.data, t.size);
+  default:
+    throw std::domain_error("bad rdf data");
+  }
+}
+
 namespace {
 
 struct rdf_term_print_visitor : public boost::static_visitor<void>
@@ -268,9 +305,9 @@ public:
     : subject_(s), predicate_(p), object_(o)
   {}
 
-  rdf_term subject() const { return subject_; }
-  rdf_term predicate() const { return predicate_; }
-  rdf_term object() const { return object_; }
+  rdf_term const& subject() const { return subject_; }
+  rdf_term const& predicate() const { return predicate_; }
+  rdf_term const& object() const { return object_; }
 
 private:
   rdf_term subject_;
@@ -285,132 +322,412 @@ std::ostream& operator<<(std::ostream& os, rdf_triple const& t)
 }
 
 //===========================================================================
-// This object parses an rdf document from a local file.
+// Converters turn the statements raptor reports into whatever triple
+// representation the caller wants. rdf_triple_converter is the default
+// and builds rdf_triples. Converters that also take a view_triple work
+// with the native parsers (ntriples_parser.hpp) too.
 //===========================================================================
+struct rdf_triple_converter
+{
+  typedef rdf_triple result_type;
+
+  rdf_triple operator()(raptor_statement* statement) const
+  {
+    return rdf_triple(
+      make_rdf_term(statement->subject),
+      make_rdf_term(statement->predicate),
+      make_rdf_term(statement->object)
+    );
+  }
 
-// TODO: Need to work on this.
+  rdf_triple operator()(view_triple const& t) const
+  {
+    return rdf_triple(
+      make_rdf_term(t.subject),
+      make_rdf_term(t.predicate),
+      make_rdf_term(t.object)
+    );
+  }
+};
 
-class rdf_parser
+//----------------------------------------------------------------------
+// Converters may also reject statements before they are converted, by
+// providing an overload of accept_statement( ) found by argument
+// dependent lookup. By default every statement is accepted.
+//----------------------------------------------------------------------
+template <typename Converter>
+inline bool accept_statement(Converter const&, raptor_statement*)
+{
+  return true;
+}
+
+template <typename Converter>
+inline bool accept_statement(Converter const&, view_triple const&)
+{
+  return true;
+}
+
+//===========================================================================
+// The glue between raptor's C callbacks and the caller's output iterator.
+// A statement_handler is instantiated for each iterator and converter
+// type, so the conversion and the store through the iterator are inlined
+// into the very function raptor calls back, and triples go straight to
+// their destination without an intermediate container.
+//===========================================================================
+template <typename Iter, typename Converter>
+class statement_handler
 {
 public:
-  rdf_parser()
-    : world_(raptor_new_world(), raptor_free_world),
-      rdf_parser_(
-        raptor_new_parser(world_.get(), "rdfxml"),
-        raptor_free_parser
-      )
+  statement_handler(Iter dest, Converter conv)
+    : dest_(dest), conv_(conv)
   {}
 
-  template <typename Iter>
-  bool operator()(std::string const& file_name, Iter dest) const
+  void install(raptor_parser* parser)
   {
-    std::cout << "top" << std::endl;
+    raptor_parser_set_statement_handler(
+      parser, static_cast<void*>(this), &statement_handler::handle);
+  }
 
+  Iter dest() const { return dest_; }
 
-    std::vector<rdf_triple> triples;
-    raptor_parser_set_statement_handler(
-      rdf_parser_.get(),
-      static_cast<void*>(&triples),
-      &rdf_parser::handle_statement
-    );
+private:
+  static void handle(void* data, raptor_statement* statement)
+  {
+    statement_handler* self = static_cast<statement_handler*>(data);
+    if (!accept_statement(self->conv_, statement))
+      return;
+    *self->dest_ = self->conv_(statement);
+    ++self->dest_;
+  }
 
-    bool good_parse = true;
+  Iter dest_;
+  Converter conv_;
+};
+
+//----------------------------------------------------------------------
+// Records whether raptor reported an error or fatal error during a
+// parse, and echoes those messages to std::cerr. Once an error has been
+// seen the parse stays bad, whatever is logged afterwards.
+//----------------------------------------------------------------------
+class log_handler
+{
+public:
+  log_handler() : good_(true)
+  {}
+
+  void install(raptor_world* world)
+  {
     raptor_world_set_log_handler(
-      world_.get(),
-      static_cast<void*>(&good_parse),
-      &rdf_parser::handle_log_messages
-    );
+      world, static_cast<void*>(this), &log_handler::handle);
+  }
 
+  bool good() const { return good_; }
 
-      std::FILE* stream = std::fopen(file_name.c_str(), "rb");
-      int x = raptor_parser_parse_file_stream(rdf_parser_.get(), stream, file_name.c_str(), NULL);
-      std::fclose(stream);
+private:
+  static void handle(void* data, raptor_log_message* message)
+  {
+    if (message->level == RAPTOR_LOG_LEVEL_ERROR
+        || message->level == RAPTOR_LOG_LEVEL_FATAL)
+    {
+      static_cast<log_handler*>(data)->good_ = false;
+      std::cerr << message->text << std::endl;
+    }
+  }
 
+  bool good_;
+};
 
-      std::cout << x << std::endl;
+//===========================================================================
+// A raptor_context bundles together the raptor objects needed to parse
+// a document: a world and a parser for a given syntax. Contexts are
+// expensive to create, so they are meant to be kept warm in a pool and
+// reused from call to call.
+//===========================================================================
+class raptor_context
+{
+public:
+  explicit raptor_context(std::string const& syntax = "rdfxml")
+    : world_(raptor_new_world(), raptor_free_world),
+      parser_(NULL, raptor_free_parser)
+  {
+    if (world_.get() == NULL)
+      throw std::domain_error("Failed to initialize raptor world");
 
-      std::cout << "bottom" << std::endl;
+    parser_.reset(raptor_new_parser(world_.get(), syntax.c_str()));
+    if (parser_.get() == NULL)
+      throw std::domain_error("Failed to initialize raptor parser");
+  }
 
-      std::copy(std::begin(triples), std::end(triples), dest);
+  raptor_world* world() const { return world_.get(); }
+  raptor_parser* parser() const { return parser_.get(); }
 
-      return good_parse;
+  //----------------------------------------------------------------------
+  // Detach any handlers installed for the last parse. The handler data
+  // usually points at locals of the caller, so it must not outlive the
+  // call that installed it.
+  //----------------------------------------------------------------------
+  void reset()
+  {
+    raptor_parser_set_statement_handler(parser_.get(), NULL, NULL);
+    raptor_world_set_log_handler(world_.get(), NULL, NULL);
   }
 
-protected:
+private:
+  raptor_context(raptor_context const&);
+  raptor_context& operator=(raptor_context const&);
+
+  std::unique_ptr<raptor_world, void(*)(raptor_world*)> world_;
+  std::unique_ptr<raptor_parser, void(*)(raptor_parser*)> parser_;
+};
+
+typedef object_pool<raptor_context> raptor_context_pool;
+
+inline std::shared_ptr<raptor_context_pool>
+make_raptor_context_pool(std::string const& syntax = "rdfxml")
+{
+  return std::make_shared<raptor_context_pool>([syntax]() {
+      return std::unique_ptr<raptor_context>(new raptor_context(syntax));
+    });
+}
+
+//===========================================================================
+// This object parses an rdf document from a local file.
+//
+// Each call borrows a warm raptor_context from a pool and hands it back
+// (with its handlers detached) once the parse is done, so repeated calls
+// do not pay for a new world and parser every time. A pool may be shared
+// between several parsers, and calls may be made from several threads
+// at once: each one gets a context of its own.
+//
+// Every entry point optionally takes a converter, which decides what is
+// written to the output iterator (rdf_triples by default).
+//===========================================================================
+class rdf_parser
+{
+public:
+  explicit rdf_parser(read_options const& opts = read_options())
+    : pool_(make_raptor_context_pool()), opts_(opts)
+  {}
+
+  explicit rdf_parser(
+    std::shared_ptr<raptor_context_pool> pool,
+    read_options const& opts = read_options())
+    : pool_(std::move(pool)), opts_(opts)
+  {}
+
+  template <typename Iter>
+  bool operator()(std::string const& file_name, Iter dest) const
+  {
+    return (*this)(file_name, dest, rdf_triple_converter());
+  }
+
+  template <typename Iter, typename Converter>
+  bool operator()(std::string const& file_name, Iter dest, Converter conv) const
+  {
+    raptor_context_pool::handle context = pool_->acquire();
+    return parse(*context, file_name, dest, conv, opts_);
+  }
+
+  //----------------------------------------------------------------------
+  // Parse a file using the given context. The context is used exclusively
+  // for the duration of the call. Throws std::domain_error if the file
+  // cannot be opened or read.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  static bool parse(
+    raptor_context& context, std::string const& file_name, Iter dest,
+    Converter conv, read_options const& opts = read_options())
+  {
+    file_reader reader(file_name, opts);
+    return parse_chunks(context, file_name, dest, conv, [&reader](raptor_parser* parser) {
+        reader.for_each_chunk([parser](unsigned char const* data, std::size_t size) {
+            raptor_parser_parse_chunk(parser, data, size, 0);
+          });
+      });
+  }
+
+  template <typename Iter>
+  static bool parse(
+    raptor_context& context, std::string const& file_name, Iter dest,
+    read_options const& opts = read_options())
+  {
+    return parse(context, file_name, dest, rdf_triple_converter(), opts);
+  }
 
-  static void handle_statement(void* data, raptor_statement* statement)
+  //----------------------------------------------------------------------
+  // Parse a document that is already in memory. name is used to build
+  // the base uri, just as the file name is for files.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  static bool parse_buffer(
+    raptor_context& context, std::string const& name,
+    unsigned char const* data, std::size_t size, Iter dest, Converter conv)
   {
-    std::cout << "statement handler" << std::endl;
-
-    std::vector<rdf_triple>* triples = static_cast<std::vector<rdf_triple>*>(data);
-    triples->push_back(rdf_triple(
-        make_rdf_term(statement->subject),
-        make_rdf_term(statement->predicate),
-        make_rdf_term(statement->object)
-      ));
+    return parse_chunks(context, name, dest, conv, [data, size](raptor_parser* parser) {
+        raptor_parser_parse_chunk(parser, data, size, 0);
+      });
   }
 
-  static void handle_log_messages(void* data, raptor_log_message* message)
+  template <typename Iter, typename Converter>
+  bool parse_buffer(
+    std::string const& name, unsigned char const* data, std::size_t size,
+    Iter dest, Converter conv) const
   {
-    bool* good_parse = static_cast<bool*>(data);
-    *good_parse = (
-      message->level != RAPTOR_LOG_LEVEL_ERROR
-      && message->level != RAPTOR_LOG_LEVEL_FATAL
+    raptor_context_pool::handle context = pool_->acquire();
+    return parse_buffer(*context, name, data, size, dest, conv);
+  }
+
+  template <typename Iter>
+  bool parse_buffer(
+    std::string const& name, unsigned char const* data, std::size_t size, Iter dest) const
+  {
+    return parse_buffer(name, data, size, dest, rdf_triple_converter());
+  }
+
+  std::shared_ptr<raptor_context_pool> pool() const { return pool_; }
+
+protected:
+
+  //----------------------------------------------------------------------
+  // Install the handlers, start the parse and let feed(parser) push the
+  // document through raptor_parser_parse_chunk. The name of the document
+  // doubles as its base uri.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter, typename Feed>
+  static bool parse_chunks(
+    raptor_context& context, std::string const& name, Iter dest,
+    Converter conv, Feed feed)
+  {
+    statement_handler<Iter, Converter> statements(dest, conv);
+    statements.install(context.parser());
+
+    log_handler log;
+    log.install(context.world());
+
+    std::unique_ptr<raptor_uri, void(*)(raptor_uri*)> base_uri(
+      raptor_new_uri_from_uri_or_file_string(
+        context.world(), NULL, (unsigned char const*)name.c_str()),
+      raptor_free_uri
     );
 
-    //if (!(*good_parse))
-      std::cerr << message->text << std::endl;
+    if (base_uri.get() == NULL)
+      throw std::domain_error("Failed to initialize raptor uri");
+
+    if (raptor_parser_parse_start(context.parser(), base_uri.get()) != 0)
+      return false;
+
+    feed(context.parser());
+    raptor_parser_parse_chunk(context.parser(), NULL, 0, 1);
+
+    return log.good();
   }
 
 private:
-  std::shared_ptr<raptor_world> world_;
-  std::shared_ptr<raptor_parser> rdf_parser_;
+  std::shared_ptr<raptor_context_pool> pool_;
+  read_options opts_;
 };
 
+//===========================================================================
+// A raptor_web_context is a raptor_context plus the curl connection used
+// to fetch documents. Keeping the connection with the context lets curl
+// reuse open connections between calls.
+//===========================================================================
+class raptor_web_context : public raptor_context
+{
+public:
+  explicit raptor_web_context(std::string const& syntax = "rdfxml")
+    : raptor_context(syntax),
+      curl_conn_((init_curl(), curl_easy_init()), curl_easy_cleanup)
+  {
+    if (curl_conn_.get() == NULL)
+      throw std::domain_error("Failed to initialize curl connection");
+  }
+
+  CURL* connection() const { return curl_conn_.get(); }
+
+private:
+  //----------------------------------------------------------------------
+  // curl_easy_init( ) initializes curl globally on first use, which is
+  // not thread-safe. Do it exactly once, up front.
+  //----------------------------------------------------------------------
+  static void init_curl()
+  {
+    static std::once_flag flag;
+    std::call_once(flag, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+  }
+
+  std::unique_ptr<CURL, void(*)(CURL*)> curl_conn_;
+};
+
+typedef object_pool<raptor_web_context> raptor_web_context_pool;
+
+inline std::shared_ptr<raptor_web_context_pool>
+make_raptor_web_context_pool(std::string const& syntax = "rdfxml")
+{
+  return std::make_shared<raptor_web_context_pool>([syntax]() {
+      return std::unique_ptr<raptor_web_context>(new raptor_web_context(syntax));
+    });
+}
+
 //===========================================================================
 // This object encapsulates an rdf web parser from Raptor. Calling the
-// member function parse( ) will download the rdf file and parse it into
-// a vector of rdf triples.
+// function call operator will download the rdf file and parse it into
+// triples, which are written to the output iterator.
+//
+// The concurrency model is the same as for rdf_parser: every call works
+// on a context it has borrowed exclusively from the pool, all handler
+// data lives on the stack of that call, and copies of the parser only
+// share the pool. A single parser may therefore be called from any
+// number of threads at once without external locking.
 //===========================================================================
 class rdf_web_parser
 {
 public:
   rdf_web_parser()
-    : world_(raptor_new_world(), raptor_free_world),
-      rdf_parser_(
-        raptor_new_parser(world_.get(), "rdfxml"),
-        raptor_free_parser
-      ),
-      curl_conn_(curl_easy_init(), curl_easy_cleanup)
+    : pool_(make_raptor_web_context_pool())
+  {}
+
+  explicit rdf_web_parser(std::shared_ptr<raptor_web_context_pool> pool)
+    : pool_(std::move(pool))
   {}
 
   template <typename Iter>
   bool operator()(std::string const& uri, Iter dest) const
+  {
+    return (*this)(uri, dest, rdf_triple_converter());
+  }
+
+  template <typename Iter, typename Converter>
+  bool operator()(std::string const& uri, Iter dest, Converter conv) const
+  {
+    raptor_web_context_pool::handle context = pool_->acquire();
+    return parse(*context, uri, dest, conv);
+  }
+
+  //----------------------------------------------------------------------
+  // Fetch and parse a uri using the given context. The context is used
+  // exclusively for the duration of the call.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  static bool parse(
+    raptor_web_context& context, std::string const& uri, Iter dest, Converter conv)
   {
     //----------------------------------------------------
     // Set up the event handlers.
     //----------------------------------------------------
 
-    std::vector<rdf_triple> triples;
-    raptor_parser_set_statement_handler(
-      rdf_parser_.get(),
-      static_cast<void*>(&triples),
-      &rdf_web_parser::handle_statement
-    );
+    statement_handler<Iter, Converter> statements(dest, conv);
+    statements.install(context.parser());
 
-    bool good_parse = true;
-    raptor_world_set_log_handler(
-      world_.get(),
-      static_cast<void*>(&good_parse),
-      &rdf_web_parser::handle_log_messages
-    );
+    log_handler log;
+    log.install(context.world());
 
     //----------------------------------------------------
     // Create the uri object and perform the parse.
     //----------------------------------------------------
 
-    std::shared_ptr<raptor_uri> r_uri(
-      raptor_new_uri(world_.get(), (unsigned char*)uri.c_str()),
+    std::unique_ptr<raptor_uri, void(*)(raptor_uri*)> r_uri(
+      raptor_new_uri(context.world(), (unsigned char const*)uri.c_str()),
       raptor_free_uri
     );
 
@@ -420,41 +737,22 @@ public:
     // TODO: Check out the kinds of error codes this can create and
     // throw exceptions accordingly.
     /*int result = */raptor_parser_parse_uri_with_connection(
-      rdf_parser_.get(), r_uri.get(), NULL, curl_conn_.get()
+      context.parser(), r_uri.get(), NULL, context.connection()
     );
 
-    std::copy(std::begin(triples), std::end(triples), dest);
-
-    return good_parse;
+    return log.good();
   }
 
-protected:
-  static void handle_statement(void* data, raptor_statement* statement)
+  template <typename Iter>
+  static bool parse(raptor_web_context& context, std::string const& uri, Iter dest)
   {
-    std::vector<rdf_triple>* triples = static_cast<std::vector<rdf_triple>*>(data);
-    triples->push_back(rdf_triple(
-        make_rdf_term(statement->subject),
-        make_rdf_term(statement->predicate),
-        make_rdf_term(statement->object)
-      ));
+    return parse(context, uri, dest, rdf_triple_converter());
   }
 
-  static void handle_log_messages(void* data, raptor_log_message* message)
-  {
-    bool* good_parse = static_cast<bool*>(data);
-    *good_parse = (
-      message->level != RAPTOR_LOG_LEVEL_ERROR
-      && message->level != RAPTOR_LOG_LEVEL_FATAL
-    );
-
-    if (!(*good_parse))
-      std::cerr << message->text << std::endl;
-  }
+  std::shared_ptr<raptor_web_context_pool> pool() const { return pool_; }
 
 private:
-  std::shared_ptr<raptor_world> world_;
-  std::shared_ptr<raptor_parser> rdf_parser_;
-  std::shared_ptr<CURL> curl_conn_;
+  std::shared_ptr<raptor_web_context_pool> pool_;
 };
 
 } // namespace rdf
@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// recompress: convert an RDF dump, plain or gzip-compressed, to BGZF or
+// seekable zstd so it can be decompressed and parsed in parallel.
+//
+//   recompress [-z] [-l level] [-j threads] [-b block_size] input output
+//
+// BGZF is written by default, with a bgzip-compatible output.gzi index
+// next to it; -z writes seekable zstd instead. Build with -lz, and with
+// -DBST_HAVE_ZSTD -lzstd for zstd output.
+//===========================================================================
+
+#include "block_compression.hpp"
+#include "thread_pool.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+int usage()
+{
+  std::cerr << "usage: recompress [-z] [-l level] [-j threads] [-b block_size] input output\n";
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  rdf::block_format format = rdf::bgzf_format;
+  int level = -1;
+  std::size_t threads = 0;
+  std::size_t block_size = 0;
+
+  int opt;
+  while ((opt = ::getopt(argc, argv, "zl:j:b:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'z': format = rdf::seekable_zstd_format; break;
+    case 'l': level = std::atoi(optarg); break;
+    case 'j': threads = static_cast<std::size_t>(std::atol(optarg)); break;
+    case 'b': block_size = static_cast<std::size_t>(std::atol(optarg)); break;
+    default: return usage();
+    }
+  }
+  if (argc - optind != 2)
+    return usage();
+
+  std::string input = argv[optind];
+  std::string output = argv[optind + 1];
+
+  // gzread reads plain files as they are, and concatenated gzip members
+  // (which includes BGZF) one after another.
+  gzFile in = ::gzopen(input.c_str(), "rb");
+  if (in == NULL)
+  {
+    std::cerr << "recompress: cannot open '" << input << "'\n";
+    return 1;
+  }
+  ::gzbuffer(in, 1 << 20);
+
+  try
+  {
+    rdf::thread_pool workers(threads != 0 ? threads : std::thread::hardware_concurrency());
+    rdf::block_compressed_writer writer(output, format, level, &workers, block_size);
+
+    std::vector<char> buffer(4 << 20);
+    for (;;)
+    {
+      int n = ::gzread(in, buffer.data(), static_cast<unsigned>(buffer.size()));
+      if (n < 0)
+      {
+        int err;
+        std::cerr << "recompress: " << input << ": " << ::gzerror(in, &err) << "\n";
+        ::gzclose(in);
+        return 1;
+      }
+      if (n == 0)
+        break;
+      writer.write(buffer.data(), static_cast<std::size_t>(n));
+    }
+    ::gzclose(in);
+    writer.finish();
+
+    if (format == rdf::bgzf_format)
+      rdf::block_compressed_file::save_gzi(writer.blocks(), output + ".gzi");
+  }
+  catch (std::exception const& e)
+  {
+    std::cerr << "recompress: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
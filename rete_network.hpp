@@ -0,0 +1,395 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines rete_network, which matches queries and rules over
+// triples as they arrive instead of after the fact, so a crawl can report
+// results as soon as the triples completing them are discovered.
+//===========================================================================
+
+#ifndef BST_RETE_NETWORK_HPP_
+#define BST_RETE_NETWORK_HPP_
+
+#include "term_id.hpp"
+#include "term_dictionary.hpp"
+#include "triple_pattern.hpp"
+
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace rdf {
+
+//===========================================================================
+// A query is a list of triple patterns; each time the triples inserted so
+// far first complete a match, its handler is called with the binding. A
+// rule is a query with a head of patterns, instantiated on every match
+// and inserted back into the network as derived triples.
+//
+// Each query compiles to a chain of join nodes, one per pattern, in the
+// order given, so the most selective patterns should come first. A join
+// node keeps the triples matching its pattern and the partial matches of
+// the patterns before it, both hashed on the variables they share; a new
+// triple is stored and joined against the partial matches, and a new
+// partial match is stored and joined against the triples, so every
+// combination is found exactly once, by whichever part arrived last.
+// Triples reach the join nodes by their predicate.
+//
+// Triples are kept as a set, so a triple found again is ignored. The
+// network is guarded by one lock; handlers are called after it is
+// released, and may insert triples themselves. Queries added once
+// triples are in are matched against those triples as well.
+//===========================================================================
+class rete_network
+{
+public:
+  typedef std::function<void(binding const&)> match_handler;
+  typedef std::function<void(id_triple const&)> derivation_handler;
+
+  rete_network() {}
+
+  //----------------------------------------------------------------------
+  // Register a query; returns its number.
+  //----------------------------------------------------------------------
+  std::size_t add_query(std::vector<triple_pattern> const& patterns, match_handler on_match)
+  {
+    return add(patterns, std::vector<triple_pattern>(), std::move(on_match),
+               derivation_handler());
+  }
+
+  //----------------------------------------------------------------------
+  // Register a rule deriving the head from the body; on_derived, if
+  // given, is called for each triple it derives that was not in yet.
+  // Every variable of the head must appear in the body.
+  //----------------------------------------------------------------------
+  std::size_t add_rule(std::vector<triple_pattern> const& body,
+                       std::vector<triple_pattern> const& head,
+                       derivation_handler on_derived = derivation_handler())
+  {
+    for (auto const& p : head)
+      for (unsigned i = 0; i < 3; ++i)
+        if (p[i].is_variable() && !binds(body, p[i].variable_number(), body.size()))
+          throw std::invalid_argument("rule head variable not bound by its body");
+    return add(body, head, match_handler(), std::move(on_derived));
+  }
+
+  void insert(id_triple const& t)
+  {
+    insert(&t, &t + 1);
+  }
+
+  template <typename Iter>
+  void insert(Iter first, Iter last)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (; first != last; ++first)
+      work_.push_back(std::make_pair(std::size_t(no_query), id_triple(*first)));
+    drain();
+    notify(lock);
+  }
+
+  //----------------------------------------------------------------------
+  // The number of distinct triples inserted or derived.
+  //----------------------------------------------------------------------
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return seen_.size();
+  }
+
+  //----------------------------------------------------------------------
+  // A visitor, for parse_files( ) or the ontology walker, that inserts the
+  // triples it sees. The walker's rdf_triples are interned into a
+  // dictionary first; id_triples go in as they are. Copies may be used
+  // from any number of threads.
+  //----------------------------------------------------------------------
+  class feeder
+  {
+  public:
+    explicit feeder(rete_network& net)
+      : net_(&net)
+    {}
+
+    feeder(rete_network& net, term_dictionary& dict)
+      : net_(&net), convert_(std::make_shared<interning_converter>(dict))
+    {}
+
+    template <typename Iter>
+    void operator()(std::string const&, Iter first, Iter last) const
+    {
+      std::vector<id_triple> triples;
+      for (; first != last; ++first)
+        triples.push_back(convert(*first));
+      net_->insert(triples.begin(), triples.end());
+    }
+
+  private:
+    id_triple convert(id_triple const& t) const { return t; }
+
+    id_triple convert(rdf_triple const& t) const
+    {
+      if (!convert_)
+        throw std::domain_error("rdf_triples fed to a rete_network without a dictionary");
+      return (*convert_)(t);
+    }
+
+    rete_network* net_;
+    std::shared_ptr<interning_converter> convert_;
+  };
+
+  feeder make_feeder() { return feeder(*this); }
+  feeder make_feeder(term_dictionary& dict) { return feeder(*this, dict); }
+
+private:
+  rete_network(rete_network const&);
+  rete_network& operator=(rete_network const&);
+
+  static const std::size_t no_query = std::size_t(-1);
+
+  typedef std::unordered_multimap<join_key, std::size_t, join_key_hash> join_index;
+
+  struct join_node
+  {
+    std::size_t query;
+    bool first;
+    bool last;
+    triple_pattern pattern;
+
+    // The shared variables, and where each first appears in the pattern.
+    std::vector<unsigned> key_variables;
+    std::vector<unsigned> key_positions;
+
+    // Partial matches, variables() terms each, and the matching triples.
+    std::vector<term_id> tokens;
+    join_index token_index;
+    std::vector<id_triple> triples;
+    join_index triple_index;
+  };
+
+  struct query
+  {
+    unsigned variables;
+    std::vector<triple_pattern> head;
+    match_handler on_match;
+    derivation_handler on_derived;
+  };
+
+  static bool binds(std::vector<triple_pattern> const& patterns, unsigned variable,
+                    std::size_t count)
+  {
+    for (std::size_t k = 0; k < count && k < patterns.size(); ++k)
+      for (unsigned i = 0; i < 3; ++i)
+        if (patterns[k][i].is_variable() && patterns[k][i].variable_number() == variable)
+          return true;
+    return false;
+  }
+
+  std::size_t add(std::vector<triple_pattern> const& patterns,
+                  std::vector<triple_pattern> const& head,
+                  match_handler on_match, derivation_handler on_derived)
+  {
+    if (patterns.empty())
+      throw std::invalid_argument("query without patterns");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::size_t number = queries_.size();
+    query q = { variable_count(patterns), head, std::move(on_match), std::move(on_derived) };
+    queries_.push_back(std::move(q));
+
+    std::size_t first_join = joins_.size();
+    for (std::size_t k = 0; k < patterns.size(); ++k)
+    {
+      joins_.push_back(join_node());
+      join_node& j = joins_.back();
+      j.query = number;
+      j.first = k == 0;
+      j.last = k + 1 == patterns.size();
+      j.pattern = patterns[k];
+      for (unsigned i = 0; i < 3; ++i)
+      {
+        pattern_term const& term = patterns[k][i];
+        if (term.is_variable() && binds(patterns, term.variable_number(), k)
+            && std::find(j.key_variables.begin(), j.key_variables.end(),
+                         term.variable_number()) == j.key_variables.end())
+        {
+          j.key_variables.push_back(term.variable_number());
+          j.key_positions.push_back(i);
+        }
+      }
+
+      if (j.pattern.predicate.is_variable())
+        any_predicate_.push_back(joins_.size() - 1);
+      else
+        by_predicate_[j.pattern.predicate.id()].push_back(joins_.size() - 1);
+    }
+
+    // Catch the new joins up with the triples already in.
+    if (!seen_.empty())
+    {
+      std::vector<id_triple> old(seen_.begin(), seen_.end());
+      for (auto const& t : old)
+        for (std::size_t j = first_join; j < joins_.size(); ++j)
+          right_activate(j, t);
+      drain();
+    }
+
+    notify(lock);
+    return number;
+  }
+
+  //----------------------------------------------------------------------
+  // Insert the triples waiting, and the ones their matches derive, until
+  // there are no more.
+  //----------------------------------------------------------------------
+  void drain()
+  {
+    while (!work_.empty())
+    {
+      std::pair<std::size_t, id_triple> w = work_.front();
+      work_.pop_front();
+      if (!seen_.insert(w.second).second)
+        continue;
+
+      if (w.first != no_query && queries_[w.first].on_derived)
+        derived_.push_back(std::make_pair(&queries_[w.first], w.second));
+
+      auto found = by_predicate_.find(w.second.predicate);
+      if (found != by_predicate_.end())
+        for (std::size_t j : found->second)
+          right_activate(j, w.second);
+      for (std::size_t j : any_predicate_)
+        right_activate(j, w.second);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // A triple arrives at a join node.
+  //----------------------------------------------------------------------
+  void right_activate(std::size_t n, id_triple const& t)
+  {
+    join_node& j = joins_[n];
+    if (!matches(j.pattern, t))
+      return;
+
+    unsigned variables = queries_[j.query].variables;
+    if (j.first)
+    {
+      binding b(variables, invalid_term_id);
+      bind_variables(j.pattern, t, b);
+      propagate(n, b);
+      return;
+    }
+
+    join_key k = { { invalid_term_id, invalid_term_id, invalid_term_id } };
+    for (std::size_t i = 0; i < j.key_positions.size(); ++i)
+      k.values[i] = term_at(t, j.key_positions[i]);
+    j.triple_index.insert(std::make_pair(k, j.triples.size()));
+    j.triples.push_back(t);
+
+    auto range = j.token_index.equal_range(k);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      term_id const* token = &j.tokens[it->second];
+      binding b(token, token + variables);
+      bind_variables(j.pattern, t, b);
+      propagate(n, b);
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // A partial match arrives at a join node.
+  //----------------------------------------------------------------------
+  void left_activate(std::size_t n, binding const& b)
+  {
+    join_node& j = joins_[n];
+    join_key k = { { invalid_term_id, invalid_term_id, invalid_term_id } };
+    for (std::size_t i = 0; i < j.key_variables.size(); ++i)
+      k.values[i] = b[j.key_variables[i]];
+    j.token_index.insert(std::make_pair(k, j.tokens.size()));
+    j.tokens.insert(j.tokens.end(), b.begin(), b.end());
+
+    auto range = j.triple_index.equal_range(k);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      binding extended(b);
+      bind_variables(j.pattern, j.triples[it->second], extended);
+      propagate(n, extended);
+    }
+  }
+
+  void propagate(std::size_t n, binding const& b)
+  {
+    if (!joins_[n].last)
+    {
+      left_activate(n + 1, b);
+      return;
+    }
+
+    std::size_t number = joins_[n].query;
+    query const& q = queries_[number];
+    for (auto const& h : q.head)
+      work_.push_back(std::make_pair(number, instantiate(h, b)));
+    if (q.on_match)
+      matches_.push_back(std::make_pair(&q, b));
+  }
+
+  //----------------------------------------------------------------------
+  // Release the lock and call the handlers of the matches and derivations
+  // made under it.
+  //----------------------------------------------------------------------
+  void notify(std::unique_lock<std::mutex>& lock)
+  {
+    std::vector<std::pair<query const*, binding>> matches;
+    std::vector<std::pair<query const*, id_triple>> derived;
+    matches.swap(matches_);
+    derived.swap(derived_);
+    lock.unlock();
+
+    // Queries are never removed, and a deque does not move them.
+    for (auto const& m : matches)
+      m.first->on_match(m.second);
+    for (auto const& d : derived)
+      d.first->on_derived(d.second);
+  }
+
+  mutable std::mutex mutex_;
+  std::deque<query> queries_;
+  std::vector<join_node> joins_;
+  std::unordered_map<term_id, std::vector<std::size_t>> by_predicate_;
+  std::vector<std::size_t> any_predicate_;
+  std::unordered_set<id_triple, id_triple_hash> seen_;
+
+  std::deque<std::pair<std::size_t, id_triple>> work_;
+  std::vector<std::pair<query const*, binding>> matches_;
+  std::vector<std::pair<query const*, id_triple>> derived_;
+};
+
+} // namespace rdf
+
+#endif
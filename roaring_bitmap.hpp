@@ -0,0 +1,432 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines roaring_bitmap, a compressed set of 32-bit integers
+// with fast intersections, unions and counts, used for the term indexes.
+//===========================================================================
+
+#ifndef BST_ROARING_BITMAP_HPP_
+#define BST_ROARING_BITMAP_HPP_
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <initializer_list>
+#include <cstdint>
+
+namespace rdf {
+
+//===========================================================================
+// The set is split by the high 16 bits of its elements into containers,
+// kept sorted by those bits. A container holding at most 4096 elements is
+// a sorted array of their low 16 bits; a fuller one is a 65536-bit
+// bitmap. Term ids keep a stripe's terms in neighbouring containers, so
+// the sets of terms the indexes build compress well.
+//===========================================================================
+class roaring_bitmap
+{
+  static const std::size_t array_limit = 4096;
+  static const std::size_t bitmap_words = 1024;
+
+  struct container
+  {
+    container() : key(0), cardinality(0) {}
+    explicit container(std::uint16_t k) : key(k), cardinality(0) {}
+
+    bool is_bitmap() const { return !bits.empty(); }
+
+    bool contains(std::uint16_t low) const
+    {
+      if (is_bitmap())
+        return (bits[low >> 6] >> (low & 63)) & 1;
+      return std::binary_search(array.begin(), array.end(), low);
+    }
+
+    std::uint16_t key;
+    std::uint32_t cardinality;
+    std::vector<std::uint16_t> array;
+    std::vector<std::uint64_t> bits;
+  };
+
+public:
+  roaring_bitmap() {}
+
+  bool empty() const { return containers_.empty(); }
+
+  std::uint64_t cardinality() const
+  {
+    std::uint64_t n = 0;
+    for (auto const& c : containers_)
+      n += c.cardinality;
+    return n;
+  }
+
+  bool contains(std::uint32_t x) const
+  {
+    container const* c = find(static_cast<std::uint16_t>(x >> 16));
+    return c != nullptr && c->contains(static_cast<std::uint16_t>(x));
+  }
+
+  void add(std::uint32_t x)
+  {
+    container& c = find_or_insert(static_cast<std::uint16_t>(x >> 16));
+    std::uint16_t low = static_cast<std::uint16_t>(x);
+    if (c.is_bitmap())
+    {
+      std::uint64_t& w = c.bits[low >> 6];
+      std::uint64_t bit = std::uint64_t(1) << (low & 63);
+      if (!(w & bit))
+      {
+        w |= bit;
+        ++c.cardinality;
+      }
+      return;
+    }
+
+    auto it = std::lower_bound(c.array.begin(), c.array.end(), low);
+    if (it != c.array.end() && *it == low)
+      return;
+    c.array.insert(it, low);
+    ++c.cardinality;
+    if (c.cardinality > array_limit)
+      to_bitmap(c);
+  }
+
+  //----------------------------------------------------------------------
+  // Add many elements at once, a container at a time; much faster than
+  // add( ) for large batches.
+  //----------------------------------------------------------------------
+  template <typename Iter>
+  void add_many(Iter first, Iter last)
+  {
+    std::vector<std::uint32_t> xs(first, last);
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    if (xs.size() <= 64)
+    {
+      for (std::uint32_t x : xs)
+        add(x);
+      return;
+    }
+
+    roaring_bitmap batch;
+    for (std::size_t i = 0; i < xs.size(); )
+    {
+      std::size_t j = i;
+      container c(static_cast<std::uint16_t>(xs[i] >> 16));
+      while (j < xs.size() && (xs[j] >> 16) == c.key)
+        c.array.push_back(static_cast<std::uint16_t>(xs[j++]));
+      c.cardinality = static_cast<std::uint32_t>(j - i);
+      if (c.cardinality > array_limit)
+        to_bitmap(c);
+      batch.containers_.push_back(std::move(c));
+      i = j;
+    }
+    *this |= batch;
+  }
+
+  //----------------------------------------------------------------------
+  // Call f(x) for every element, in increasing order.
+  //----------------------------------------------------------------------
+  template <typename Func>
+  void for_each(Func f) const
+  {
+    for (auto const& c : containers_)
+    {
+      std::uint32_t high = static_cast<std::uint32_t>(c.key) << 16;
+      if (!c.is_bitmap())
+      {
+        for (std::uint16_t low : c.array)
+          f(high | low);
+        continue;
+      }
+      for (std::size_t w = 0; w < bitmap_words; ++w)
+        for (std::uint64_t bits = c.bits[w]; bits != 0; bits &= bits - 1)
+          f(high | static_cast<std::uint32_t>(w * 64 + __builtin_ctzll(bits)));
+    }
+  }
+
+  std::vector<std::uint32_t> to_vector() const
+  {
+    std::vector<std::uint32_t> v;
+    v.reserve(cardinality());
+    for_each([&v](std::uint32_t x) { v.push_back(x); });
+    return v;
+  }
+
+  roaring_bitmap& operator&=(roaring_bitmap const& r)
+  {
+    std::vector<container> out;
+    common_keys(r, [&out](container const& a, container const& b) {
+        container c = intersect(a, b);
+        if (c.cardinality != 0)
+          out.push_back(std::move(c));
+      });
+    containers_.swap(out);
+    return *this;
+  }
+
+  roaring_bitmap& operator|=(roaring_bitmap const& r)
+  {
+    // Containers only here are moved over rather than copied.
+    std::vector<container> out;
+    out.reserve(containers_.size() + r.containers_.size());
+    auto a = containers_.begin();
+    auto b = r.containers_.begin();
+    while (a != containers_.end() || b != r.containers_.end())
+    {
+      if (b == r.containers_.end() || (a != containers_.end() && a->key < b->key))
+        out.push_back(std::move(*a++));
+      else if (a == containers_.end() || b->key < a->key)
+        out.push_back(*b++);
+      else
+        out.push_back(unite(*a++, *b++));
+    }
+    containers_.swap(out);
+    return *this;
+  }
+
+  //----------------------------------------------------------------------
+  // The size of the intersection, without building it.
+  //----------------------------------------------------------------------
+  static std::uint64_t and_cardinality(roaring_bitmap const& a, roaring_bitmap const& b)
+  {
+    std::uint64_t n = 0;
+    a.common_keys(b, [&n](container const& x, container const& y) {
+        n += intersect_count(x, y);
+      });
+    return n;
+  }
+
+  friend bool operator==(roaring_bitmap const& a, roaring_bitmap const& b)
+  {
+    return a.to_vector() == b.to_vector();
+  }
+
+private:
+  container const* find(std::uint16_t key) const
+  {
+    auto it = lower_bound(key);
+    return it != containers_.end() && it->key == key ? &*it : nullptr;
+  }
+
+  std::vector<container>::const_iterator lower_bound(std::uint16_t key) const
+  {
+    return std::lower_bound(containers_.begin(), containers_.end(), key,
+                            [](container const& c, std::uint16_t k) { return c.key < k; });
+  }
+
+  container& find_or_insert(std::uint16_t key)
+  {
+    auto it = containers_.begin() + (lower_bound(key) - containers_.begin());
+    if (it == containers_.end() || it->key != key)
+      it = containers_.insert(it, container(key));
+    return *it;
+  }
+
+  //----------------------------------------------------------------------
+  // Call f(a, b) for the containers of both bitmaps with the same key.
+  //----------------------------------------------------------------------
+  template <typename Func>
+  void common_keys(roaring_bitmap const& r, Func f) const
+  {
+    auto a = containers_.begin();
+    auto b = r.containers_.begin();
+    while (a != containers_.end() && b != r.containers_.end())
+    {
+      if (a->key < b->key)
+        ++a;
+      else if (b->key < a->key)
+        ++b;
+      else
+        f(*a++, *b++);
+    }
+  }
+
+  static void to_bitmap(container& c)
+  {
+    c.bits.assign(bitmap_words, 0);
+    for (std::uint16_t low : c.array)
+      c.bits[low >> 6] |= std::uint64_t(1) << (low & 63);
+    std::vector<std::uint16_t>().swap(c.array);
+  }
+
+  static void to_array(container& c)
+  {
+    c.array.clear();
+    c.array.reserve(c.cardinality);
+    for (std::size_t w = 0; w < bitmap_words; ++w)
+      for (std::uint64_t bits = c.bits[w]; bits != 0; bits &= bits - 1)
+        c.array.push_back(static_cast<std::uint16_t>(w * 64 + __builtin_ctzll(bits)));
+    std::vector<std::uint64_t>().swap(c.bits);
+  }
+
+  //----------------------------------------------------------------------
+  // Intersect a small sorted array with a larger one by galloping, or
+  // merge them if their sizes are close.
+  //----------------------------------------------------------------------
+  template <typename Out>
+  static void intersect_arrays(std::vector<std::uint16_t> const& a,
+                               std::vector<std::uint16_t> const& b, Out out)
+  {
+    std::vector<std::uint16_t> const& small = a.size() <= b.size() ? a : b;
+    std::vector<std::uint16_t> const& large = a.size() <= b.size() ? b : a;
+    if (small.size() * 32 < large.size())
+    {
+      auto lo = large.begin();
+      for (std::uint16_t x : small)
+      {
+        std::size_t step = 1;
+        auto hi = lo;
+        while (hi != large.end() && *hi < x)
+        {
+          lo = hi;
+          hi = static_cast<std::size_t>(large.end() - hi) > step ? hi + step : large.end();
+          step *= 2;
+        }
+        lo = std::lower_bound(lo, hi, x);
+        if (lo == large.end())
+          return;
+        if (*lo == x)
+          out(x);
+      }
+      return;
+    }
+
+    auto i = a.begin();
+    auto j = b.begin();
+    while (i != a.end() && j != b.end())
+    {
+      if (*i < *j)
+        ++i;
+      else if (*j < *i)
+        ++j;
+      else
+      {
+        out(*i);
+        ++i;
+        ++j;
+      }
+    }
+  }
+
+  static container intersect(container const& a, container const& b)
+  {
+    container c(a.key);
+    if (a.is_bitmap() && b.is_bitmap())
+    {
+      c.bits.resize(bitmap_words);
+      std::uint32_t n = 0;
+      for (std::size_t w = 0; w < bitmap_words; ++w)
+      {
+        c.bits[w] = a.bits[w] & b.bits[w];
+        n += static_cast<std::uint32_t>(__builtin_popcountll(c.bits[w]));
+      }
+      c.cardinality = n;
+      if (n <= array_limit)
+        to_array(c);
+      return c;
+    }
+
+    if (a.is_bitmap() || b.is_bitmap())
+    {
+      container const& arr = a.is_bitmap() ? b : a;
+      container const& bmp = a.is_bitmap() ? a : b;
+      for (std::uint16_t x : arr.array)
+        if (bmp.contains(x))
+          c.array.push_back(x);
+    }
+    else
+      intersect_arrays(a.array, b.array, [&c](std::uint16_t x) { c.array.push_back(x); });
+    c.cardinality = static_cast<std::uint32_t>(c.array.size());
+    return c;
+  }
+
+  static std::uint64_t intersect_count(container const& a, container const& b)
+  {
+    std::uint64_t n = 0;
+    if (a.is_bitmap() && b.is_bitmap())
+    {
+      for (std::size_t w = 0; w < bitmap_words; ++w)
+        n += static_cast<std::uint64_t>(__builtin_popcountll(a.bits[w] & b.bits[w]));
+    }
+    else if (a.is_bitmap() || b.is_bitmap())
+    {
+      container const& arr = a.is_bitmap() ? b : a;
+      container const& bmp = a.is_bitmap() ? a : b;
+      for (std::uint16_t x : arr.array)
+        n += bmp.contains(x);
+    }
+    else
+      intersect_arrays(a.array, b.array, [&n](std::uint16_t) { ++n; });
+    return n;
+  }
+
+  static container unite(container const& a, container const& b)
+  {
+    container c(a.key);
+    if (!a.is_bitmap() && !b.is_bitmap())
+    {
+      std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                     std::back_inserter(c.array));
+      c.cardinality = static_cast<std::uint32_t>(c.array.size());
+      if (c.cardinality > array_limit)
+        to_bitmap(c);
+      return c;
+    }
+
+    c.bits.assign(bitmap_words, 0);
+    for (container const* x : { &a, &b })
+    {
+      if (x->is_bitmap())
+        for (std::size_t w = 0; w < bitmap_words; ++w)
+          c.bits[w] |= x->bits[w];
+      else
+        for (std::uint16_t low : x->array)
+          c.bits[low >> 6] |= std::uint64_t(1) << (low & 63);
+    }
+    std::uint32_t n = 0;
+    for (std::size_t w = 0; w < bitmap_words; ++w)
+      n += static_cast<std::uint32_t>(__builtin_popcountll(c.bits[w]));
+    c.cardinality = n;
+    return c;
+  }
+
+  std::vector<container> containers_;
+};
+
+inline roaring_bitmap operator&(roaring_bitmap a, roaring_bitmap const& b)
+{
+  a &= b;
+  return a;
+}
+
+inline roaring_bitmap operator|(roaring_bitmap a, roaring_bitmap const& b)
+{
+  a |= b;
+  return a;
+}
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines sharded<T>, per-thread state that is merged on demand.
+// It is the building block of the thread-safe visitors: each thread that
+// touches a sharded<T> gets a private T it can update without locking,
+// and the shards are combined once the threads are done.
+//===========================================================================
+
+#ifndef BST_SHARDED_HPP_
+#define BST_SHARDED_HPP_
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace rdf {
+
+//===========================================================================
+// Copies of a sharded<T> are handles to the same set of shards, so a
+// visitor holding one can be copied freely and handed to any number of
+// threads. Looking up the calling thread's shard takes a lock only the
+// first time a thread sees a given set of shards; after that the shard
+// is found through a small thread-local cache keyed by set.
+//===========================================================================
+template <typename T>
+class sharded
+{
+  struct state
+  {
+    explicit state(std::uint64_t i) : id(i) {}
+
+    std::uint64_t id;
+    std::mutex mutex;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<T>>> shards;
+    T merged;
+  };
+
+public:
+  sharded()
+    : state_(std::make_shared<state>(next_id()))
+  {}
+
+  //----------------------------------------------------------------------
+  // The calling thread's shard.
+  //----------------------------------------------------------------------
+  T& local() const
+  {
+    thread_cache& cache = this_thread_cache();
+    std::uint64_t id = state_->id;
+    for (std::size_t i = 0; i < cache_size; ++i)
+      if (cache.entries[i].id == id)
+        return *cache.entries[i].shard;
+
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    std::thread::id self = std::this_thread::get_id();
+
+    T* shard = nullptr;
+    for (auto& s : state_->shards)
+      if (s.first == self)
+        shard = s.second.get();
+
+    if (shard == nullptr)
+    {
+      state_->shards.push_back(std::make_pair(self, std::unique_ptr<T>(new T())));
+      shard = state_->shards.back().second.get();
+    }
+
+    cache_entry& victim = cache.entries[cache.next++ % cache_size];
+    victim.id = id;
+    victim.shard = shard;
+    return *shard;
+  }
+
+  //----------------------------------------------------------------------
+  // Fold every shard into the merged result with merge(merged, shard),
+  // which is expected to leave the shard empty, and return the result.
+  // Only call this once the threads using the shards are done with them.
+  //----------------------------------------------------------------------
+  template <typename Merge>
+  T& merge(Merge merge) const
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    for (auto& s : state_->shards)
+      merge(state_->merged, *s.second);
+    return state_->merged;
+  }
+
+private:
+  //----------------------------------------------------------------------
+  // Each thread remembers its shards of the last few sets it used, keyed
+  // by set id, so several live sharded<T>s of the same T (the visitors of
+  // one walk, say) each keep hitting the cache instead of evicting one
+  // another. Entries are replaced round robin.
+  //----------------------------------------------------------------------
+  static const std::size_t cache_size = 8;
+
+  struct cache_entry
+  {
+    std::uint64_t id;
+    T* shard;
+  };
+
+  struct thread_cache
+  {
+    cache_entry entries[cache_size];
+    std::size_t next;
+  };
+
+  static thread_cache& this_thread_cache()
+  {
+    static thread_local thread_cache cache = {};
+    return cache;
+  }
+
+  //----------------------------------------------------------------------
+  // Ids are never reused, so a stale cache entry left behind by a
+  // destroyed set of shards can never match a new one.
+  //----------------------------------------------------------------------
+  static std::uint64_t next_id()
+  {
+    static std::atomic<std::uint64_t> counter(0);
+    return ++counter;
+  }
+
+  std::shared_ptr<state> state_;
+};
+
+} // namespace rdf
+
+#endif
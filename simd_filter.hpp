@@ -0,0 +1,479 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains vectorized filter kernels over arrays of id_triples.
+// A kernel evaluates one column test (a term position compared with an
+// id, a small set of ids, or a term kind) over thousands of triples and
+// writes a selection vector: the indices of the triples that pass.
+//
+// Kernels exist for AVX-512, AVX2 and plain C++. The best one the CPU
+// supports is picked at run time, once, so a single binary runs well
+// everywhere. On top of the kernels, select_matching( ) evaluates the
+// predicate DSL of triple_predicates.hpp over a whole array, using the
+// kernels for the parts of the expression they can handle.
+//===========================================================================
+
+#ifndef BST_SIMD_FILTER_HPP_
+#define BST_SIMD_FILTER_HPP_
+
+#include "term_id.hpp"
+#include "triple_predicates.hpp"
+
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BST_SIMD_FILTER_X86
+#include <immintrin.h>
+#endif
+
+namespace rdf { namespace simd {
+
+//===========================================================================
+// A test on one column of an id_triple array: the triple passes when
+//
+//   ((id >> shift) & mask) is one of values[0 .. count)
+//
+// which covers equality (shift 0, one value), small sets (up to eight
+// values) and term kinds (shift 30, mask 3).
+//===========================================================================
+struct column_test
+{
+  static const unsigned max_values = 8;
+
+  unsigned position;      // 0 = subject, 1 = predicate, 2 = object
+  unsigned shift;
+  std::uint32_t mask;
+  std::uint32_t values[max_values];
+  unsigned count;
+
+  bool operator()(std::uint32_t id) const
+  {
+    std::uint32_t v = (id >> shift) & mask;
+    for (unsigned i = 0; i < count; ++i)
+      if (v == values[i])
+        return true;
+    return false;
+  }
+};
+
+inline column_test test_equal(unsigned position, term_id id)
+{
+  column_test t = { position, 0, 0xFFFFFFFFu, { id }, 1 };
+  return t;
+}
+
+inline column_test test_kind(unsigned position, term_kind kind)
+{
+  column_test t = { position, term_kind_shift, 3u, { static_cast<std::uint32_t>(kind) }, 1 };
+  return t;
+}
+
+template <typename Iter>
+column_test test_in(unsigned position, Iter first, Iter last)
+{
+  column_test t = { position, 0, 0xFFFFFFFFu, { 0 }, 0 };
+  for (; first != last; ++first)
+  {
+    if (t.count == column_test::max_values)
+      throw std::domain_error("too many values for a column test");
+    t.values[t.count++] = *first;
+  }
+  return t;
+}
+
+namespace {
+
+inline std::uint32_t const* column_base(id_triple const* triples, unsigned position)
+{
+  static_assert(sizeof(id_triple) == 3 * sizeof(std::uint32_t), "id_triple must be packed");
+  return reinterpret_cast<std::uint32_t const*>(triples) + position;
+}
+
+//----------------------------------------------------------------------
+// Plain C++ kernels.
+//----------------------------------------------------------------------
+inline std::size_t select_scalar(
+  id_triple const* triples, std::size_t n, column_test const& test, std::uint32_t* sel)
+{
+  std::uint32_t const* col = column_base(triples, test.position);
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    sel[count] = static_cast<std::uint32_t>(i);
+    count += test(col[3 * i]);
+  }
+  return count;
+}
+
+inline std::size_t refine_scalar(
+  id_triple const* triples, column_test const& test, std::uint32_t* sel, std::size_t n)
+{
+  std::uint32_t const* col = column_base(triples, test.position);
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    std::uint32_t idx = sel[i];
+    sel[count] = idx;
+    count += test(col[3 * idx]);
+  }
+  return count;
+}
+
+#ifdef BST_SIMD_FILTER_X86
+
+//----------------------------------------------------------------------
+// AVX2 kernels: gather eight ids of the column, compare them with every
+// value of the test, and append the indices of the matching lanes.
+//----------------------------------------------------------------------
+__attribute__((target("avx2")))
+inline __m256i match_avx2(__m256i ids, column_test const& test)
+{
+  __m256i v = _mm256_and_si256(
+    _mm256_srli_epi32(ids, static_cast<int>(test.shift)),
+    _mm256_set1_epi32(static_cast<int>(test.mask)));
+
+  __m256i m = _mm256_setzero_si256();
+  for (unsigned k = 0; k < test.count; ++k)
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi32(v, _mm256_set1_epi32(static_cast<int>(test.values[k]))));
+  return m;
+}
+
+__attribute__((target("avx2,bmi")))
+inline std::size_t append_lanes(unsigned bits, __m256i indices, std::uint32_t* out)
+{
+  alignas(32) std::uint32_t lanes[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), indices);
+
+  std::size_t count = 0;
+  while (bits != 0)
+  {
+    out[count++] = lanes[_tzcnt_u32(bits)];
+    bits &= bits - 1;
+  }
+  return count;
+}
+
+__attribute__((target("avx2,bmi")))
+inline std::size_t select_avx2(
+  id_triple const* triples, std::size_t n, column_test const& test, std::uint32_t* sel)
+{
+  std::uint32_t const* col = column_base(triples, test.position);
+  __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+  __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+  std::size_t count = 0, i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i ids = _mm256_i32gather_epi32(
+      reinterpret_cast<int const*>(col + 3 * i), stride, 4);
+    unsigned bits = static_cast<unsigned>(
+      _mm256_movemask_ps(_mm256_castsi256_ps(match_avx2(ids, test))));
+    if (bits != 0)
+      count += append_lanes(bits,
+        _mm256_add_epi32(lane, _mm256_set1_epi32(static_cast<int>(i))), sel + count);
+  }
+
+  for (; i < n; ++i)
+  {
+    sel[count] = static_cast<std::uint32_t>(i);
+    count += test(col[3 * i]);
+  }
+  return count;
+}
+
+__attribute__((target("avx2,bmi")))
+inline std::size_t refine_avx2(
+  id_triple const* triples, column_test const& test, std::uint32_t* sel, std::size_t n)
+{
+  std::uint32_t const* col = column_base(triples, test.position);
+  __m256i three = _mm256_set1_epi32(3);
+
+  std::size_t count = 0, i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i idx = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(sel + i));
+    __m256i ids = _mm256_i32gather_epi32(
+      reinterpret_cast<int const*>(col), _mm256_mullo_epi32(idx, three), 4);
+    unsigned bits = static_cast<unsigned>(
+      _mm256_movemask_ps(_mm256_castsi256_ps(match_avx2(ids, test))));
+    count += append_lanes(bits, idx, sel + count);
+  }
+
+  for (; i < n; ++i)
+  {
+    std::uint32_t idx = sel[i];
+    sel[count] = idx;
+    count += test(col[3 * idx]);
+  }
+  return count;
+}
+
+//----------------------------------------------------------------------
+// AVX-512 kernels: the same, sixteen lanes at a time, with the matching
+// indices written out by a compress store.
+//----------------------------------------------------------------------
+__attribute__((target("avx512f")))
+inline __mmask16 match_avx512(__m512i ids, column_test const& test)
+{
+  __m512i v = _mm512_and_si512(
+    _mm512_maskz_srli_epi32(0xFFFF, ids, test.shift),
+    _mm512_set1_epi32(static_cast<int>(test.mask)));
+
+  __mmask16 m = 0;
+  for (unsigned k = 0; k < test.count; ++k)
+    m |= _mm512_cmpeq_epi32_mask(v, _mm512_set1_epi32(static_cast<int>(test.values[k])));
+  return m;
+}
+
+__attribute__((target("avx512f,popcnt")))
+inline std::size_t select_avx512(
+  id_triple const* triples, std::size_t n, column_test const& test, std::uint32_t* sel)
+{
+  std::uint32_t const* col = column_base(triples, test.position);
+  __m512i stride = _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45);
+  __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+  std::size_t count = 0, i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m512i ids = _mm512_mask_i32gather_epi32(
+      _mm512_setzero_si512(), 0xFFFF, stride, col + 3 * i, 4);
+    __mmask16 m = match_avx512(ids, test);
+    _mm512_mask_compressstoreu_epi32(sel + count, m,
+      _mm512_add_epi32(lane, _mm512_set1_epi32(static_cast<int>(i))));
+    count += static_cast<std::size_t>(_mm_popcnt_u32(m));
+  }
+
+  for (; i < n; ++i)
+  {
+    sel[count] = static_cast<std::uint32_t>(i);
+    count += test(col[3 * i]);
+  }
+  return count;
+}
+
+__attribute__((target("avx512f,popcnt")))
+inline std::size_t refine_avx512(
+  id_triple const* triples, column_test const& test, std::uint32_t* sel, std::size_t n)
+{
+  std::uint32_t const* col = column_base(triples, test.position);
+  __m512i three = _mm512_set1_epi32(3);
+
+  std::size_t count = 0, i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m512i idx = _mm512_loadu_si512(sel + i);
+    __m512i ids = _mm512_mask_i32gather_epi32(
+      _mm512_setzero_si512(), 0xFFFF, _mm512_mullo_epi32(idx, three), col, 4);
+    __mmask16 m = match_avx512(ids, test);
+    _mm512_mask_compressstoreu_epi32(sel + count, m, idx);
+    count += static_cast<std::size_t>(_mm_popcnt_u32(m));
+  }
+
+  for (; i < n; ++i)
+  {
+    std::uint32_t idx = sel[i];
+    sel[count] = idx;
+    count += test(col[3 * idx]);
+  }
+  return count;
+}
+
+#endif // BST_SIMD_FILTER_X86
+
+//----------------------------------------------------------------------
+// Run-time dispatch, decided once.
+//----------------------------------------------------------------------
+typedef std::size_t (*select_fn)(id_triple const*, std::size_t, column_test const&, std::uint32_t*);
+typedef std::size_t (*refine_fn)(id_triple const*, column_test const&, std::uint32_t*, std::size_t);
+
+struct kernels
+{
+  select_fn select;
+  refine_fn refine;
+  char const* name;
+};
+
+inline kernels const& best_kernels()
+{
+  static kernels const k = []() {
+#ifdef BST_SIMD_FILTER_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt"))
+      {
+        kernels k = { &select_avx512, &refine_avx512, "avx512" };
+        return k;
+      }
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi"))
+      {
+        kernels k = { &select_avx2, &refine_avx2, "avx2" };
+        return k;
+      }
+#endif
+      kernels k = { &select_scalar, &refine_scalar, "scalar" };
+      return k;
+    }();
+  return k;
+}
+
+} // namespace
+
+//===========================================================================
+// The kernels. sel must have room for n indices. Both return the number
+// of indices written; refine( ) filters a selection vector in place.
+//===========================================================================
+inline std::size_t select(
+  id_triple const* triples, std::size_t n, column_test const& test, std::uint32_t* sel)
+{
+  return best_kernels().select(triples, n, test, sel);
+}
+
+inline std::size_t refine(
+  id_triple const* triples, column_test const& test, std::uint32_t* sel, std::size_t n)
+{
+  return best_kernels().refine(triples, test, sel, n);
+}
+
+inline char const* kernel_name()
+{
+  return best_kernels().name;
+}
+
+//===========================================================================
+// Evaluating predicate expressions over arrays. Leaves that map to a
+// column test (bound term_is, term_in with at most eight ids, kind_is)
+// use the kernels; conjunctions select on the left and refine on the
+// right; anything else is evaluated triple by triple. Expressions must be
+// bound to the dictionary the ids came from.
+//===========================================================================
+
+//----------------------------------------------------------------------
+// Turning leaves into column tests. Returns false for expressions that
+// have no column test.
+//----------------------------------------------------------------------
+template <typename E>
+bool to_column_test(E const&, column_test&)
+{
+  return false;
+}
+
+template <typename Pos>
+bool to_column_test(predicates::term_is<Pos> const& e, column_test& test)
+{
+  test = test_equal(Pos::index, e.id());
+  return true;
+}
+
+template <typename Pos>
+bool to_column_test(predicates::term_in<Pos> const& e, column_test& test)
+{
+  if (!e.bound())
+    throw std::domain_error("term set used without binding to a dictionary");
+  if (e.ids().size() > column_test::max_values)
+    return false;
+  test = test_in(Pos::index, std::begin(e.ids()), std::end(e.ids()));
+  return true;
+}
+
+template <typename Pos>
+bool to_column_test(predicates::kind_is<Pos> const& e, column_test& test)
+{
+  test = test_kind(Pos::index, e.kind());
+  return true;
+}
+
+template <typename E>
+std::size_t refine_matching(
+  predicates::expression<E> const& e, id_triple const* triples,
+  std::uint32_t* sel, std::size_t n);
+
+template <typename L, typename R>
+std::size_t refine_matching(
+  predicates::and_expr<L, R> const& e, id_triple const* triples,
+  std::uint32_t* sel, std::size_t n)
+{
+  n = refine_matching(e.left(), triples, sel, n);
+  return refine_matching(e.right(), triples, sel, n);
+}
+
+template <typename E>
+std::size_t refine_matching(
+  predicates::expression<E> const& e, id_triple const* triples,
+  std::uint32_t* sel, std::size_t n)
+{
+  column_test test;
+  if (to_column_test(e.derived(), test))
+    return refine(triples, test, sel, n);
+
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    std::uint32_t idx = sel[i];
+    sel[count] = idx;
+    count += e.derived()(triples[idx]) ? 1 : 0;
+  }
+  return count;
+}
+
+//----------------------------------------------------------------------
+// Write the indices of the triples in [triples, triples + n) that match
+// the expression to sel, which must have room for n indices, and return
+// how many there are.
+//----------------------------------------------------------------------
+template <typename E>
+std::size_t select_matching(
+  predicates::expression<E> const& e, id_triple const* triples,
+  std::size_t n, std::uint32_t* sel);
+
+template <typename L, typename R>
+std::size_t select_matching(
+  predicates::and_expr<L, R> const& e, id_triple const* triples,
+  std::size_t n, std::uint32_t* sel)
+{
+  std::size_t count = select_matching(e.left(), triples, n, sel);
+  return refine_matching(e.right(), triples, sel, count);
+}
+
+template <typename E>
+std::size_t select_matching(
+  predicates::expression<E> const& e, id_triple const* triples,
+  std::size_t n, std::uint32_t* sel)
+{
+  column_test test;
+  if (to_column_test(e.derived(), test))
+    return select(triples, n, test, sel);
+
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    sel[count] = static_cast<std::uint32_t>(i);
+    count += e.derived()(triples[i]) ? 1 : 0;
+  }
+  return count;
+}
+
+} // namespace simd
+} // namespace rdf
+
+#endif
@@ -0,0 +1,398 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines sorted_term_dictionary, a compact read-only term
+// dictionary. Terms are sorted and stored plain-front-coded: within each
+// block of (by default) 16 terms only the first is stored in full, and
+// every following term is stored as the length of the prefix it shares
+// with its predecessor plus the remaining suffix. Uris in a crawl share
+// long prefixes, so this takes a fraction of the memory of a string per
+// term, while still allowing
+//
+//   - string -> id by binary search over the block heads, then a scan of
+//     a single block, and
+//   - id -> string by decoding a single block.
+//===========================================================================
+
+#ifndef BST_SORTED_DICTIONARY_HPP_
+#define BST_SORTED_DICTIONARY_HPP_
+
+#include "term_dictionary.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+namespace rdf {
+
+//===========================================================================
+// One front-coded section: a sorted list of distinct strings, addressed
+// by their position in the list.
+//===========================================================================
+class front_coded_section
+{
+public:
+  static const std::uint32_t npos = 0xFFFFFFFFu;
+
+  front_coded_section()
+    : size_(0), block_size_(16)
+  {}
+
+  //----------------------------------------------------------------------
+  // Build a section from any list of strings; they are sorted and
+  // duplicates are dropped.
+  //----------------------------------------------------------------------
+  explicit front_coded_section(std::vector<std::string> strings, std::size_t block_size = 16)
+    : size_(0), block_size_(block_size == 0 ? 1 : block_size)
+  {
+    std::sort(std::begin(strings), std::end(strings));
+    strings.erase(std::unique(std::begin(strings), std::end(strings)), std::end(strings));
+    size_ = strings.size();
+
+    for (std::size_t i = 0; i < strings.size(); ++i)
+    {
+      std::string const& s = strings[i];
+      if (i % block_size_ == 0)
+      {
+        blocks_.push_back(static_cast<std::uint32_t>(data_.size()));
+        put_varint(s.size());
+      }
+      else
+      {
+        std::string const& prev = strings[i - 1];
+        std::size_t shared = 0;
+        while (shared < prev.size() && shared < s.size() && prev[shared] == s[shared])
+          ++shared;
+        put_varint(shared);
+        put_varint(s.size() - shared);
+        data_.insert(std::end(data_), s.begin() + shared, s.end());
+        continue;
+      }
+      data_.insert(std::end(data_), s.begin(), s.end());
+    }
+    data_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+  }
+
+  std::size_t size() const { return size_; }
+
+  //----------------------------------------------------------------------
+  // Position of a string, or npos if it is not in the section.
+  //----------------------------------------------------------------------
+  std::uint32_t find(char const* str, std::size_t len) const
+  {
+    if (blocks_.empty())
+      return npos;
+
+    // Find the last block whose head is <= str.
+    std::size_t lo = 0, hi = blocks_.size();
+    while (hi - lo > 1)
+    {
+      std::size_t mid = lo + (hi - lo) / 2;
+      if (compare_head(mid, str, len) <= 0)
+        lo = mid;
+      else
+        hi = mid;
+    }
+
+    // Then scan that block.
+    std::string current;
+    std::size_t count = block_count(lo);
+    char const* p = &data_[blocks_[lo]];
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      p = decode_next(p, i == 0, current);
+      int c = compare(current, str, len);
+      if (c == 0)
+        return static_cast<std::uint32_t>(lo * block_size_ + i);
+      if (c > 0)
+        break;
+    }
+    return npos;
+  }
+
+  //----------------------------------------------------------------------
+  // Decode the string at a position into out.
+  //----------------------------------------------------------------------
+  void at(std::uint32_t pos, std::string& out) const
+  {
+    if (pos >= size_)
+      throw std::domain_error("front coded position out of range");
+
+    std::size_t block = pos / block_size_;
+    char const* p = &data_[blocks_[block]];
+    out.clear();
+    for (std::size_t i = 0; i <= pos % block_size_; ++i)
+      p = decode_next(p, i == 0, out);
+  }
+
+  std::string at(std::uint32_t pos) const
+  {
+    std::string out;
+    at(pos, out);
+    return out;
+  }
+
+  //----------------------------------------------------------------------
+  // Call f(position, string) for every string, in order.
+  //----------------------------------------------------------------------
+  template <typename Func>
+  void for_each(Func f) const
+  {
+    std::string current;
+    for (std::size_t b = 0; b < blocks_.size(); ++b)
+    {
+      char const* p = &data_[blocks_[b]];
+      for (std::size_t i = 0; i < block_count(b); ++i)
+      {
+        p = decode_next(p, i == 0, current);
+        f(static_cast<std::uint32_t>(b * block_size_ + i), current);
+      }
+    }
+  }
+
+  std::size_t memory_usage() const
+  {
+    return data_.capacity() + blocks_.capacity() * sizeof(std::uint32_t);
+  }
+
+private:
+  void put_varint(std::size_t v)
+  {
+    while (v >= 0x80)
+    {
+      data_.push_back(static_cast<char>((v & 0x7F) | 0x80));
+      v >>= 7;
+    }
+    data_.push_back(static_cast<char>(v));
+  }
+
+  static char const* get_varint(char const* p, std::size_t& v)
+  {
+    v = 0;
+    unsigned shift = 0;
+    for (;;)
+    {
+      unsigned char c = static_cast<unsigned char>(*p++);
+      v |= static_cast<std::size_t>(c & 0x7F) << shift;
+      if (!(c & 0x80))
+        return p;
+      shift += 7;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // Decode the next string of a block in place: current holds the
+  // previous string on entry and the decoded one on exit.
+  //----------------------------------------------------------------------
+  static char const* decode_next(char const* p, bool head, std::string& current)
+  {
+    std::size_t shared = 0, len;
+    if (!head)
+      p = get_varint(p, shared);
+    p = get_varint(p, len);
+    current.resize(shared);
+    current.append(p, len);
+    return p + len;
+  }
+
+  std::size_t block_count(std::size_t block) const
+  {
+    return std::min(block_size_, size_ - block * block_size_);
+  }
+
+  static int compare(std::string const& a, char const* b, std::size_t blen)
+  {
+    return compare(a.data(), a.size(), b, blen);
+  }
+
+  static int compare(char const* a, std::size_t alen, char const* b, std::size_t blen)
+  {
+    int c = std::memcmp(a, b, std::min(alen, blen));
+    if (c != 0)
+      return c;
+    return alen < blen ? -1 : (alen > blen ? 1 : 0);
+  }
+
+  int compare_head(std::size_t block, char const* str, std::size_t len) const
+  {
+    std::size_t head_len;
+    char const* p = get_varint(&data_[blocks_[block]], head_len);
+    return compare(p, head_len, str, len);
+  }
+
+  std::size_t size_;
+  std::size_t block_size_;
+  std::vector<char> data_;
+  std::vector<std::uint32_t> blocks_;
+};
+
+//===========================================================================
+// A read-only term dictionary with one front-coded section per kind of
+// term. Ids use the same layout as term_dictionary ids (the kind in the
+// top two bits) followed by the position of the term in its section.
+// The well-known vocabulary keeps its fixed ids and is left out of the
+// uri section, whose positions start after the reserved ids.
+//
+// Literals are keyed as "datatype \0 language \0 value", so that
+// literals of the same datatype and language sort together and share
+// their prefix.
+//===========================================================================
+class sorted_term_dictionary
+{
+public:
+  sorted_term_dictionary()
+  {}
+
+  //----------------------------------------------------------------------
+  // Freeze the contents of a term_dictionary. Ids are not preserved; use
+  // find( ) to translate them.
+  //----------------------------------------------------------------------
+  explicit sorted_term_dictionary(term_dictionary const& dict, std::size_t block_size = 16)
+  {
+    std::vector<std::string> keys[3];
+    dict.for_each([&keys](term_id, term_view const& t) {
+        if (vocab::find(t) != invalid_term_id)
+          return;
+        std::string key;
+        encode(t, key);
+        keys[t.kind].push_back(key);
+      });
+
+    for (int k = 0; k < 3; ++k)
+      sections_[k] = front_coded_section(std::move(keys[k]), block_size);
+  }
+
+  //----------------------------------------------------------------------
+  // Build from a list of terms, possibly with duplicates.
+  //----------------------------------------------------------------------
+  template <typename Iter>
+  sorted_term_dictionary(Iter first, Iter last, std::size_t block_size = 16)
+  {
+    std::vector<std::string> keys[3];
+    for (; first != last; ++first)
+    {
+      if (vocab::find(*first) != invalid_term_id)
+        continue;
+      std::string key;
+      encode(*first, key);
+      keys[first->kind].push_back(key);
+    }
+
+    for (int k = 0; k < 3; ++k)
+      sections_[k] = front_coded_section(std::move(keys[k]), block_size);
+  }
+
+  term_id find(term_view const& t) const
+  {
+    term_id well_known = vocab::find(t);
+    if (well_known != invalid_term_id)
+      return well_known;
+
+    std::string key;
+    encode(t, key);
+
+    std::uint32_t pos = sections_[t.kind].find(key.data(), key.size());
+    if (pos == front_coded_section::npos)
+      return invalid_term_id;
+    return make_id(t.kind, pos);
+  }
+
+  //----------------------------------------------------------------------
+  // Decode a term into buffer and return a view of it. The view is valid
+  // until buffer is modified.
+  //----------------------------------------------------------------------
+  term_view lookup(term_id id, std::string& buffer) const
+  {
+    if (id == invalid_term_id)
+      throw std::domain_error("unknown term id");
+
+    if (vocab::is_well_known(id))
+    {
+      buffer = vocab::iri(id);
+      return term_view(uri_term, buffer.data(), buffer.size());
+    }
+
+    term_kind kind = kind_of(id);
+    sections_[kind].at((id & ((1u << term_kind_shift) - 1)) - first_position(kind), buffer);
+    return decode(kind, buffer);
+  }
+
+  std::size_t size() const
+  {
+    return vocab::well_known_count
+      + sections_[0].size() + sections_[1].size() + sections_[2].size();
+  }
+
+  front_coded_section const& section(term_kind kind) const { return sections_[kind]; }
+
+  std::size_t memory_usage() const
+  {
+    return sections_[0].memory_usage() + sections_[1].memory_usage()
+      + sections_[2].memory_usage();
+  }
+
+private:
+  static std::uint32_t first_position(term_kind kind)
+  {
+    return kind == uri_term ? static_cast<std::uint32_t>(vocab::well_known_count) : 0;
+  }
+
+  static term_id make_id(term_kind kind, std::uint32_t pos)
+  {
+    return (static_cast<term_id>(kind) << term_kind_shift) | (pos + first_position(kind));
+  }
+
+  static void encode(term_view const& t, std::string& key)
+  {
+    key.clear();
+    if (t.kind == literal_term)
+    {
+      key.append(t.datatype, t.datatype_size);
+      key.push_back('\0');
+      key.append(t.language, t.language_size);
+      key.push_back('\0');
+    }
+    key.append(t.data, t.size);
+  }
+
+  static term_view decode(term_kind kind, std::string const& key)
+  {
+    if (kind != literal_term)
+      return term_view(kind, key.data(), key.size());
+
+    std::size_t split = key.find('\0');
+    std::size_t lang_end = key.find('\0', split + 1);
+    return term_view(
+      kind, key.data() + lang_end + 1, key.size() - lang_end - 1, key.data(), split,
+      key.data() + split + 1, lang_end - split - 1);
+  }
+
+  front_coded_section sections_[3];
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,419 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines term_dictionary, a concurrent table that interns rdf
+// terms as small integer ids. Many parser threads may intern terms into
+// the same dictionary at once.
+//===========================================================================
+
+#ifndef BST_TERM_DICTIONARY_HPP_
+#define BST_TERM_DICTIONARY_HPP_
+
+#include "rdf_parser.hpp"
+#include "term_id.hpp"
+#include "vocabulary.hpp"
+#include "sharded.hpp"
+
+#include <mutex>
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+
+namespace rdf {
+
+//===========================================================================
+// The dictionary is split into stripes, each with its own lock, hash map
+// and id counter; a term's hash picks its stripe. Threads interning
+// different terms therefore rarely contend, and looking up an id only
+// locks the stripe it came from.
+//
+// Terms are stored under an encoded key (kind, value length, value, and
+// for literals language length, language, datatype). Keys never move once inserted, so the views handed out by
+// lookup( ) stay valid for the lifetime of the dictionary.
+//
+// Every dictionary is seeded with the well-known vocabulary at its fixed
+// ids: the keys are entered in the stripes their hashes select, but map
+// to ids in the reserved stripe 0, which has no terms of its own.
+//===========================================================================
+class term_dictionary
+{
+  static const std::size_t stripe_count = std::size_t(1) << term_stripe_bits;
+
+  struct key_hash
+  {
+    std::size_t operator()(std::string const& key) const { return hash(key); }
+  };
+
+  struct stripe
+  {
+    stripe() : next(0) {}
+
+    std::mutex mutex;
+    std::unordered_map<std::string, term_id, key_hash> ids;
+    std::deque<std::string const*> keys;
+    std::uint32_t next;
+  };
+
+public:
+  //----------------------------------------------------------------------
+  // A small direct-mapped cache of recently interned terms, meant to be
+  // owned by a single thread. Hot terms like rdf:type are then resolved
+  // without touching the shared stripes at all. A cache must only ever be
+  // used with one dictionary.
+  //----------------------------------------------------------------------
+  class cache
+  {
+  public:
+    cache() : entries_(size) {}
+
+  private:
+    friend class term_dictionary;
+
+    static const std::size_t size = 4096;
+
+    struct entry
+    {
+      entry() : id(invalid_term_id) {}
+
+      std::string key;
+      term_id id;
+    };
+
+    std::vector<entry> entries_;
+    std::string buffer_;
+  };
+
+  term_dictionary() : stripes_(stripe_count)
+  {
+    for (auto const& t : vocab::well_known_terms)
+    {
+      std::string key;
+      encode(term_view(uri_term, t.iri, std::strlen(t.iri)), key);
+      stripes_[stripe_of(hash(key))].ids.insert(std::make_pair(key, t.id));
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // Return the id of a term, adding it to the dictionary if needed.
+  //----------------------------------------------------------------------
+  term_id intern(term_view const& t)
+  {
+    std::string key;
+    encode(t, key);
+    return intern_key(key, hash(key));
+  }
+
+  term_id intern(term_view const& t, cache& c)
+  {
+    encode(t, c.buffer_);
+    std::size_t h = hash(c.buffer_);
+
+    cache::entry& e = c.entries_[h % cache::size];
+    if (e.id != invalid_term_id && e.key == c.buffer_)
+      return e.id;
+
+    e.id = intern_key(c.buffer_, h);
+    e.key = c.buffer_;
+    return e.id;
+  }
+
+  //----------------------------------------------------------------------
+  // Return the id of a term, or invalid_term_id if it was never interned.
+  //----------------------------------------------------------------------
+  term_id find(term_view const& t) const
+  {
+    std::string key;
+    encode(t, key);
+    std::size_t h = hash(key);
+
+    stripe& s = stripes_[stripe_of(h)];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.ids.find(key);
+    return it == s.ids.end() ? invalid_term_id : it->second;
+  }
+
+  //----------------------------------------------------------------------
+  // Return the term an id stands for. Throws std::domain_error for ids
+  // that did not come from this dictionary.
+  //----------------------------------------------------------------------
+  term_view lookup(term_id id) const
+  {
+    if (vocab::is_well_known(id))
+      return term_view(uri_term, vocab::iri(id), std::strlen(vocab::iri(id)));
+
+    std::string const* key = NULL;
+    {
+      stripe& s = stripes_[(id >> term_index_bits) & (stripe_count - 1)];
+      std::uint32_t index = id & ((1u << term_index_bits) - 1);
+
+      std::lock_guard<std::mutex> lock(s.mutex);
+      if (id == invalid_term_id || index >= s.keys.size())
+        throw std::domain_error("unknown term id");
+      key = s.keys[index];
+    }
+    return decode(*key);
+  }
+
+  std::size_t size() const
+  {
+    std::size_t n = vocab::well_known_count;
+    for (auto& s : stripes_)
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      n += s.keys.size();
+    }
+    return n;
+  }
+
+  //----------------------------------------------------------------------
+  // Call f(term_id, term_view) for every term. Terms interned while this
+  // runs may or may not be visited.
+  //----------------------------------------------------------------------
+  template <typename Func>
+  void for_each(Func f) const
+  {
+    for (auto const& t : vocab::well_known_terms)
+      f(t.id, term_view(uri_term, t.iri, std::strlen(t.iri)));
+
+    for (std::size_t i = 1; i < stripes_.size(); ++i)
+    {
+      stripe& s = stripes_[i];
+      std::vector<std::string const*> keys;
+      {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        keys.assign(std::begin(s.keys), std::end(s.keys));
+      }
+
+      for (std::size_t k = 0; k < keys.size(); ++k)
+      {
+        term_view t = decode(*keys[k]);
+        f(make_term_id(t.kind, static_cast<unsigned>(i), static_cast<std::uint32_t>(k)), t);
+      }
+    }
+  }
+
+private:
+  term_dictionary(term_dictionary const&);
+  term_dictionary& operator=(term_dictionary const&);
+
+  //----------------------------------------------------------------------
+  // 64-bit FNV-1a. The top bits pick the stripe, the rest feed the maps.
+  // Stripe 0 is reserved for the vocabulary.
+  //----------------------------------------------------------------------
+  static std::size_t hash(std::string const& key)
+  {
+    std::uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : key)
+    {
+      h ^= c;
+      h *= 1099511628211ULL;
+    }
+    return static_cast<std::size_t>(h);
+  }
+
+  static std::size_t stripe_of(std::size_t h)
+  {
+    return 1 + static_cast<std::size_t>(
+      (static_cast<std::uint64_t>(h) >> 32) % (stripe_count - 1));
+  }
+
+  static void encode(term_view const& t, std::string& key)
+  {
+    std::uint32_t size = static_cast<std::uint32_t>(t.size);
+
+    key.clear();
+    key.push_back(static_cast<char>(t.kind));
+    key.append(reinterpret_cast<char const*>(&size), sizeof(size));
+    key.append(t.data, t.size);
+    if (t.kind != literal_term)
+      return;
+
+    std::uint32_t language_size = static_cast<std::uint32_t>(t.language_size);
+    key.append(reinterpret_cast<char const*>(&language_size), sizeof(language_size));
+    key.append(t.language, t.language_size);
+    key.append(t.datatype, t.datatype_size);
+  }
+
+  static term_view decode(std::string const& key)
+  {
+    std::uint32_t size;
+    std::memcpy(&size, key.data() + 1, sizeof(size));
+
+    term_kind kind = static_cast<term_kind>(key[0]);
+    char const* value = key.data() + 1 + sizeof(size);
+    if (kind != literal_term)
+      return term_view(kind, value, size);
+
+    std::uint32_t language_size;
+    std::memcpy(&language_size, value + size, sizeof(language_size));
+    char const* language = value + size + sizeof(language_size);
+    char const* datatype = language + language_size;
+    return term_view(
+      kind, value, size,
+      datatype, key.data() + key.size() - datatype,
+      language, language_size);
+  }
+
+  term_id intern_key(std::string const& key, std::size_t h)
+  {
+    std::size_t si = stripe_of(h);
+    stripe& s = stripes_[si];
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.ids.find(key);
+    if (it != s.ids.end())
+      return it->second;
+
+    if (s.next >= (1u << term_index_bits))
+      throw std::domain_error("term dictionary stripe is full");
+
+    term_id id = make_term_id(
+      static_cast<term_kind>(key[0]), static_cast<unsigned>(si), s.next++);
+    it = s.ids.insert(std::make_pair(key, id)).first;
+    s.keys.push_back(&it->first);
+    return id;
+  }
+
+  mutable std::vector<stripe> stripes_;
+};
+
+//===========================================================================
+// A view of a raptor term, pointing into raptor's own buffers.
+//===========================================================================
+inline term_view make_term_view(raptor_uri* uri)
+{
+  if (uri == NULL)
+    return term_view(uri_term, "", 0);
+  char const* str = reinterpret_cast<char const*>(raptor_uri_as_string(uri));
+  return term_view(uri_term, str, std::strlen(str));
+}
+
+inline term_view make_term_view(raptor_term* rterm)
+{
+  switch (rterm->type)
+  {
+  case RAPTOR_TERM_TYPE_URI:
+    return make_term_view(rterm->value.uri);
+  case RAPTOR_TERM_TYPE_LITERAL:
+  {
+    raptor_term_literal_value const& lit = rterm->value.literal;
+    term_view dt = make_term_view(lit.datatype);
+    char const* lang = lit.language == NULL ? "" : reinterpret_cast<char const*>(lit.language);
+    return term_view(
+      literal_term, reinterpret_cast<char const*>(lit.string), lit.string_len,
+      dt.data, dt.size, lang, lit.language == NULL ? 0 : lit.language_len);
+  }
+  case RAPTOR_TERM_TYPE_BLANK:
+    return term_view(
+      blank_term, reinterpret_cast<char const*>(rterm->value.blank.string),
+      rterm->value.blank.string_len);
+  default:
+    throw std::domain_error("bad rdf data");
+  }
+}
+
+//===========================================================================
+// A converter for rdf_parser and rdf_web_parser that interns the terms of
+// each statement straight from raptor's buffers (or, with the native
+// parsers, straight from the input) and produces id_triples, without
+// building rdf_terms first. Each thread using the converter gets
+// its own lookup cache, so copies of it may be used by parallel parses.
+//===========================================================================
+class interning_converter
+{
+public:
+  typedef id_triple result_type;
+
+  explicit interning_converter(term_dictionary& dict)
+    : dict_(&dict)
+  {}
+
+  id_triple operator()(raptor_statement* statement) const
+  {
+    term_dictionary::cache& c = caches_.local();
+    id_triple t = {
+      dict_->intern(make_term_view(statement->subject), c),
+      dict_->intern(make_term_view(statement->predicate), c),
+      dict_->intern(make_term_view(statement->object), c)
+    };
+    return t;
+  }
+
+  id_triple operator()(view_triple const& v) const
+  {
+    term_dictionary::cache& c = caches_.local();
+    id_triple t = {
+      dict_->intern(v.subject, c),
+      dict_->intern(v.predicate, c),
+      dict_->intern(v.object, c)
+    };
+    return t;
+  }
+
+  //----------------------------------------------------------------------
+  // rdf_triples, as the ontology walker hands out, can be interned after
+  // the fact too.
+  //----------------------------------------------------------------------
+  id_triple operator()(rdf_triple const& r) const
+  {
+    term_dictionary::cache& c = caches_.local();
+    id_triple t = {
+      intern(r.subject(), c),
+      intern(r.predicate(), c),
+      intern(r.object(), c)
+    };
+    return t;
+  }
+
+private:
+  term_id intern(rdf_term const& t, term_dictionary::cache& c) const
+  {
+    if (rdf_uri const* u = boost::get<rdf_uri>(&t))
+    {
+      unsigned_string const& s = u->uri();
+      return dict_->intern(
+        term_view(uri_term, reinterpret_cast<char const*>(s.data()), s.size()), c);
+    }
+    if (rdf_literal const* l = boost::get<rdf_literal>(&t))
+    {
+      unsigned_string s = l->value();
+      unsigned_string dt = l->uri().uri();
+      return dict_->intern(
+        term_view(literal_term, reinterpret_cast<char const*>(s.data()), s.size(),
+                  reinterpret_cast<char const*>(dt.data()), dt.size()), c);
+    }
+    unsigned_string s = boost::get<rdf_blank>(t).value();
+    return dict_->intern(
+      term_view(blank_term, reinterpret_cast<char const*>(s.data()), s.size()), c);
+  }
+
+  term_dictionary* dict_;
+  sharded<term_dictionary::cache> caches_;
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,154 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines the integer representation of rdf terms shared by the
+// term dictionaries: term ids, term views, and triples of either.
+//===========================================================================
+
+#ifndef BST_TERM_ID_HPP_
+#define BST_TERM_ID_HPP_
+
+#include <string>
+#include <cstdint>
+
+namespace rdf {
+
+//===========================================================================
+// A term id packs the kind of the term into its top two bits, so the kind
+// can be tested without looking the term up:
+//
+//   [ kind : 2 ][ stripe : 6 ][ index within the stripe : 24 ]
+//
+// Stripe 0 is reserved for the well-known vocabulary (vocabulary.hpp),
+// whose ids are the same in every dictionary.
+//===========================================================================
+typedef std::uint32_t term_id;
+
+enum term_kind
+{
+  uri_term = 0,
+  literal_term = 1,
+  blank_term = 2
+};
+
+const term_id invalid_term_id = 0xFFFFFFFFu;
+
+const unsigned term_kind_shift = 30;
+const unsigned term_stripe_bits = 6;
+const unsigned term_index_bits = 24;
+
+inline term_kind kind_of(term_id id)
+{
+  return static_cast<term_kind>(id >> term_kind_shift);
+}
+
+inline term_id make_term_id(term_kind kind, unsigned stripe, std::uint32_t index)
+{
+  return (static_cast<term_id>(kind) << term_kind_shift)
+    | (static_cast<term_id>(stripe) << term_index_bits)
+    | index;
+}
+
+//===========================================================================
+// A non-owning view of a term: its kind, its lexical value and, for
+// literals, its datatype uri or language tag.
+//===========================================================================
+struct term_view
+{
+  term_view()
+    : kind(uri_term), data(""), size(0), datatype(""), datatype_size(0),
+      language(""), language_size(0)
+  {}
+
+  term_view(term_kind k, char const* d, std::size_t s,
+            char const* dt = "", std::size_t dt_size = 0,
+            char const* lang = "", std::size_t lang_size = 0)
+    : kind(k), data(d), size(s), datatype(dt), datatype_size(dt_size),
+      language(lang), language_size(lang_size)
+  {}
+
+  std::string value() const { return std::string(data, size); }
+
+  term_kind kind;
+  char const* data;
+  std::size_t size;
+  char const* datatype;
+  std::size_t datatype_size;
+  char const* language;
+  std::size_t language_size;
+};
+
+//===========================================================================
+// A triple of term views, as produced by a parser before the terms are
+// copied or interned anywhere.
+//===========================================================================
+struct view_triple
+{
+  term_view subject;
+  term_view predicate;
+  term_view object;
+};
+
+//===========================================================================
+// A triple of interned terms.
+//===========================================================================
+struct id_triple
+{
+  term_id subject;
+  term_id predicate;
+  term_id object;
+};
+
+inline bool operator==(id_triple const& a, id_triple const& b)
+{
+  return a.subject == b.subject && a.predicate == b.predicate && a.object == b.object;
+}
+
+inline bool operator!=(id_triple const& a, id_triple const& b)
+{
+  return !(a == b);
+}
+
+inline bool operator<(id_triple const& a, id_triple const& b)
+{
+  if (a.subject != b.subject) return a.subject < b.subject;
+  if (a.predicate != b.predicate) return a.predicate < b.predicate;
+  return a.object < b.object;
+}
+
+//----------------------------------------------------------------------
+// A hash for unordered containers of id_triples.
+//----------------------------------------------------------------------
+struct id_triple_hash
+{
+  std::size_t operator()(id_triple const& t) const
+  {
+    std::uint64_t h = (static_cast<std::uint64_t>(t.subject) << 32) ^ t.object;
+    h ^= static_cast<std::uint64_t>(t.predicate) * 0x9E3779B97F4A7C15ULL;
+    h *= 0xFF51AFD7ED558CCDULL;
+    return static_cast<std::size_t>(h ^ (h >> 32));
+  }
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,361 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains the term arena and the validating copy routines used
+// by the native parsers. A term's bytes are checked (UTF-8 well-formedness,
+// and for IRIs the characters IRIs may not contain) in the same pass that
+// copies them into the arena, sixteen bytes at a time, so each byte of
+// the input is only walked once on the way to its final home.
+//===========================================================================
+
+#ifndef BST_TERM_VALIDATION_HPP_
+#define BST_TERM_VALIDATION_HPP_
+
+#include "term_id.hpp"
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace rdf {
+
+//===========================================================================
+// A bump allocator for term bytes. Memory is handed out from large
+// chunks and only released all at once, by clear( ) or destruction, so
+// the pointers it returns are stable and allocation is nearly free.
+//===========================================================================
+class term_arena
+{
+public:
+  explicit term_arena(std::size_t chunk_size = 1 << 16)
+    : chunk_size_(chunk_size), used_(0), capacity_(0)
+  {}
+
+  char* allocate(std::size_t size)
+  {
+    if (size > capacity_ - used_)
+    {
+      std::size_t n = std::max(size, chunk_size_);
+      chunks_.push_back(std::unique_ptr<char[]>(new char[n]));
+      used_ = 0;
+      capacity_ = n;
+    }
+
+    char* p = chunks_.back().get() + used_;
+    used_ += size;
+    return p;
+  }
+
+  void clear()
+  {
+    chunks_.clear();
+    used_ = capacity_ = 0;
+  }
+
+  //----------------------------------------------------------------------
+  // Forget everything allocated so far but keep the current chunk, so an
+  // arena reused per statement does not go back to the heap.
+  //----------------------------------------------------------------------
+  void rewind()
+  {
+    if (chunks_.size() > 1)
+    {
+      chunks_.front() = std::move(chunks_.back());
+      chunks_.resize(1);
+    }
+    used_ = 0;
+  }
+
+private:
+  term_arena(term_arena const&);
+  term_arena& operator=(term_arena const&);
+
+  std::size_t chunk_size_;
+  std::size_t used_;
+  std::size_t capacity_;
+  std::vector<std::unique_ptr<char[]>> chunks_;
+};
+
+namespace {
+
+//----------------------------------------------------------------------
+// Validate one multi-byte UTF-8 sequence starting at src[i] (whose lead
+// byte is >= 0x80) and copy it. Returns the length of the sequence, or 0
+// if it is malformed: a bad lead byte, a missing continuation byte, an
+// overlong encoding, a surrogate, or a code point above U+10FFFF.
+//----------------------------------------------------------------------
+template <bool Copy>
+inline std::size_t copy_utf8_sequence(
+  unsigned char const* src, std::size_t i, std::size_t n, char* dst)
+{
+  unsigned char c = src[i];
+  std::size_t len;
+  std::uint32_t cp;
+  std::uint32_t min;
+
+  if (c >= 0xC2 && c <= 0xDF)      { len = 2; cp = c & 0x1F; min = 0x80; }
+  else if (c >= 0xE0 && c <= 0xEF) { len = 3; cp = c & 0x0F; min = 0x800; }
+  else if (c >= 0xF0 && c <= 0xF4) { len = 4; cp = c & 0x07; min = 0x10000; }
+  else
+    return 0;
+
+  if (i + len > n)
+    return 0;
+
+  for (std::size_t k = 1; k < len; ++k)
+  {
+    unsigned char cc = src[i + k];
+    if ((cc & 0xC0) != 0x80)
+      return 0;
+    cp = (cp << 6) | (cc & 0x3F);
+  }
+
+  if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    return 0;
+
+  if (Copy)
+    std::memcpy(dst + i, src + i, len);
+  return len;
+}
+
+//----------------------------------------------------------------------
+// Characters that may not appear in an IRI reference: controls, space
+// and <>"{}|^`\ .
+//----------------------------------------------------------------------
+inline bool is_iri_forbidden(unsigned char c)
+{
+  return c <= 0x20 || c == '<' || c == '>' || c == '"' || c == '{'
+    || c == '}' || c == '|' || c == '^' || c == '`' || c == '\\';
+}
+
+#if defined(__SSE2__)
+
+//----------------------------------------------------------------------
+// A mask of the bytes in a block that are ASCII IRI-forbidden. With
+// SSSE3 this is a nibble lookup: each byte's low and high nibbles index
+// two tables of class bits, and a byte is forbidden when the two share
+// a bit. The classes are
+//
+//   1: 0x00-0x1F           2: space and "      4: < > \ ^
+//   8: `                  16: { | }
+//----------------------------------------------------------------------
+inline int iri_forbidden_mask(__m128i b)
+{
+#if defined(__SSSE3__)
+  const __m128i low_classes = _mm_setr_epi8(
+    1|2|8, 1, 1|2, 1, 1, 1, 1, 1, 1, 1, 1, 1|16, 1|4|16, 1|16, 1|4, 1);
+  const __m128i high_classes = _mm_setr_epi8(
+    1, 1, 2, 4, 0, 4, 8, 16, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+
+  __m128i lo = _mm_shuffle_epi8(low_classes, _mm_and_si128(b, nibble));
+  __m128i hi = _mm_shuffle_epi8(high_classes, _mm_and_si128(_mm_srli_epi16(b, 4), nibble));
+  __m128i hit = _mm_and_si128(lo, hi);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128())) ^ 0xFFFF;
+#else
+  __m128i bad = _mm_cmpeq_epi8(_mm_min_epu8(b, _mm_set1_epi8(0x20)), b);
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('<')));
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('>')));
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('"')));
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('{')));
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('}')));
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('|')));
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('^')));
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('`')));
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi8(b, _mm_set1_epi8('\\')));
+  return _mm_movemask_epi8(bad);
+#endif
+}
+
+//----------------------------------------------------------------------
+// The bytes of a block that need a closer look: non-ASCII ones, and for
+// IRIs the forbidden ones.
+//----------------------------------------------------------------------
+template <bool Iri>
+inline int special_mask(__m128i b)
+{
+  int special = _mm_movemask_epi8(b);
+  if (Iri)
+    special |= iri_forbidden_mask(b);
+  return special;
+}
+
+#endif
+
+//----------------------------------------------------------------------
+// The shared loop. Blocks of sixteen pure ASCII bytes (that pass the IRI
+// check, if asked for) are copied with a single store; a block holding
+// anything else is handled byte by byte up to the end of the sequence
+// that crosses it. With Copy false nothing is written and dst may be null.
+//----------------------------------------------------------------------
+template <bool Iri, bool Copy>
+inline bool validate_copy(char const* source, std::size_t n, char* dst)
+{
+  unsigned char const* src = reinterpret_cast<unsigned char const*>(source);
+  std::size_t i = 0;
+
+  while (i < n)
+  {
+#if defined(__SSE2__)
+    if (i + 16 <= n)
+    {
+      __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+      if (Copy)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), b);
+
+      int special = special_mask<Iri>(b);
+      if (special == 0)
+      {
+        i += 16;
+        continue;
+      }
+
+      // Skip the clean prefix of the block and fall through to the
+      // byte-by-byte path for the rest of it.
+      std::size_t end = i + 16;
+      i += static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(special)));
+      while (i < end)
+      {
+        unsigned char c = src[i];
+        if (c < 0x80)
+        {
+          if (Iri && is_iri_forbidden(c))
+            return false;
+          if (Copy)
+            dst[i] = static_cast<char>(c);
+          ++i;
+        }
+        else
+        {
+          std::size_t len = copy_utf8_sequence<Copy>(src, i, n, dst);
+          if (len == 0)
+            return false;
+          i += len;
+        }
+      }
+      continue;
+    }
+
+    // The last few bytes of a term at least sixteen long are checked with
+    // one more load, overlapping bytes already seen. That only settles
+    // things if the whole block is clean, since the block may start in the
+    // middle of a sequence.
+    if (n >= 16)
+    {
+      __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + n - 16));
+      if (special_mask<Iri>(b) == 0)
+      {
+        if (Copy)
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + n - 16), b);
+        return true;
+      }
+    }
+#endif
+
+    unsigned char c = src[i];
+    if (c < 0x80)
+    {
+      if (Iri && is_iri_forbidden(c))
+        return false;
+      if (Copy)
+        dst[i] = static_cast<char>(c);
+      ++i;
+    }
+    else
+    {
+      std::size_t len = copy_utf8_sequence<Copy>(src, i, n, dst);
+      if (len == 0)
+        return false;
+      i += len;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+//===========================================================================
+// Copy n bytes from src to dst, checking that they are well-formed UTF-8
+// (and, for IRIs, contain no characters IRIs forbid). Returns false if
+// they are not, in which case the contents of dst are unspecified.
+//===========================================================================
+inline bool validate_copy_utf8(char const* src, std::size_t n, char* dst)
+{
+  return validate_copy<false, true>(src, n, dst);
+}
+
+inline bool validate_copy_iri(char const* src, std::size_t n, char* dst)
+{
+  return validate_copy<true, true>(src, n, dst);
+}
+
+//----------------------------------------------------------------------
+// The same checks for bytes that stay where they are.
+//----------------------------------------------------------------------
+inline bool validate_utf8(char const* src, std::size_t n)
+{
+  return validate_copy<false, false>(src, n, NULL);
+}
+
+inline bool validate_iri(char const* src, std::size_t n)
+{
+  return validate_copy<true, false>(src, n, NULL);
+}
+
+//===========================================================================
+// Validate a term and copy it into an arena in one pass. IRIs (the value
+// of uri terms and the datatype of literals) get the IRI check, all other
+// text the UTF-8 check. On success out points into the arena. Language
+// tags are checked by the parsers, and copied as they are.
+//===========================================================================
+inline bool validate_into_arena(term_view const& t, term_arena& arena, term_view& out)
+{
+  char* value = arena.allocate(t.size + t.datatype_size + t.language_size);
+  bool ok = (t.kind == uri_term)
+    ? validate_copy_iri(t.data, t.size, value)
+    : validate_copy_utf8(t.data, t.size, value);
+
+  if (ok && t.datatype_size != 0)
+    ok = validate_copy_iri(t.datatype, t.datatype_size, value + t.size);
+  if (!ok)
+    return false;
+
+  char* language = value + t.size + t.datatype_size;
+  std::memcpy(language, t.language, t.language_size);
+  out = term_view(t.kind, value, t.size, value + t.size, t.datatype_size,
+                  language, t.language_size);
+  return true;
+}
+
+} // namespace rdf
+
+#endif
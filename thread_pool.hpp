@@ -0,0 +1,227 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines a small fixed-size thread pool used by the batch and
+// parallel parts of the library.
+//===========================================================================
+
+#ifndef BST_THREAD_POOL_HPP_
+#define BST_THREAD_POOL_HPP_
+
+#include <mutex>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <iterator>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+namespace rdf {
+
+//===========================================================================
+// Tasks are run in submission order by a fixed set of worker threads. The
+// first exception thrown by a task is kept and rethrown by wait( ); the
+// remaining tasks still run.
+//
+// Neither waiting nor errors are tracked per caller: wait( ) waits for
+// every task in the pool and rethrows whichever error came first. A pool
+// is therefore meant for one caller at a time; two threads submitting
+// to the same pool would wait for, and receive the errors of, each
+// other's tasks.
+//===========================================================================
+class thread_pool
+{
+public:
+  explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency())
+    : pending_(0), stop_(false)
+  {
+    if (threads == 0)
+      threads = 1;
+    for (std::size_t i = 0; i < threads; ++i)
+      workers_.push_back(std::thread([this]() { run(); }));
+  }
+
+  ~thread_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_cond_.notify_all();
+    for (auto& t : workers_)
+      t.join();
+  }
+
+  std::size_t size() const { return workers_.size(); }
+
+  void submit(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+      ++pending_;
+    }
+    work_cond_.notify_one();
+  }
+
+  //----------------------------------------------------------------------
+  // Block until at most max_pending tasks are queued or running. With the
+  // default of zero this waits for everything submitted so far, and then
+  // rethrows the first exception a task threw, if any. A non-zero limit
+  // is useful to keep a producer from running too far ahead.
+  //----------------------------------------------------------------------
+  void wait(std::size_t max_pending = 0)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [this, max_pending]() { return pending_ <= max_pending; });
+
+    if (max_pending == 0 && error_)
+    {
+      std::exception_ptr error = error_;
+      error_ = std::exception_ptr();
+      std::rethrow_exception(error);
+    }
+  }
+
+private:
+  thread_pool(thread_pool const&);
+  thread_pool& operator=(thread_pool const&);
+
+  void run()
+  {
+    for (;;)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cond_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+
+      std::exception_ptr error;
+      try
+      {
+        task();
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (error && !error_)
+        error_ = error;
+      --pending_;
+      done_cond_.notify_all();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::size_t pending_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable work_cond_;
+  std::condition_variable done_cond_;
+};
+
+//===========================================================================
+// Call f(begin, end) over [0, n) in chunks of at least min_chunk, a few
+// per worker so uneven chunks even out, and wait for them all. The first
+// exception is rethrown. Must not be called from one of the pool's own
+// tasks, which would wait on itself.
+//===========================================================================
+template <typename Func>
+void parallel_for(thread_pool& workers, std::size_t n, Func f, std::size_t min_chunk = 1024)
+{
+  if (n == 0)
+    return;
+
+  std::size_t chunks = 4 * workers.size();
+  std::size_t chunk = std::max(min_chunk, (n + chunks - 1) / chunks);
+  if (chunk >= n)
+  {
+    f(std::size_t(0), n);
+    return;
+  }
+
+  for (std::size_t begin = 0; begin < n; begin += chunk)
+  {
+    std::size_t end = std::min(n, begin + chunk);
+    workers.submit([&f, begin, end]() { f(begin, end); });
+  }
+  workers.wait();
+}
+
+//===========================================================================
+// Sort [first, last) with the pool: slices are sorted in parallel, then
+// merged pairwise, a round of merges at a time.
+//===========================================================================
+template <typename Iter, typename Compare>
+void parallel_sort(thread_pool& workers, Iter first, Iter last, Compare comp,
+                   std::size_t min_slice = 1 << 16)
+{
+  std::size_t n = last - first;
+  std::size_t slices = std::min(workers.size(), n / std::max<std::size_t>(min_slice, 1));
+  if (slices <= 1)
+  {
+    std::sort(first, last, comp);
+    return;
+  }
+
+  std::vector<std::size_t> bounds(slices + 1);
+  for (std::size_t i = 0; i <= slices; ++i)
+    bounds[i] = n * i / slices;
+
+  parallel_for(workers, slices, [&](std::size_t b, std::size_t e) {
+      for (std::size_t i = b; i < e; ++i)
+        std::sort(first + bounds[i], first + bounds[i + 1], comp);
+    }, 1);
+
+  for (std::size_t width = 1; width < slices; width *= 2)
+    parallel_for(workers, (slices + 2 * width - 1) / (2 * width), [&](std::size_t b, std::size_t e) {
+        for (std::size_t m = b; m < e; ++m)
+        {
+          std::size_t lo = 2 * width * m;
+          std::size_t mid = std::min(lo + width, slices);
+          std::size_t hi = std::min(lo + 2 * width, slices);
+          std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi], comp);
+        }
+      }, 1);
+}
+
+template <typename Iter>
+void parallel_sort(thread_pool& workers, Iter first, Iter last)
+{
+  parallel_sort(workers, first, last, std::less<typename std::iterator_traits<Iter>::value_type>());
+}
+
+} // namespace rdf
+
+#endif
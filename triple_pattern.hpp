@@ -0,0 +1,185 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines triple patterns over interned terms: triples whose
+// positions are either a term id or a numbered variable, as matched by
+// the query engines.
+//===========================================================================
+
+#ifndef BST_TRIPLE_PATTERN_HPP_
+#define BST_TRIPLE_PATTERN_HPP_
+
+#include "term_id.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace rdf {
+
+//===========================================================================
+// A position of a pattern: a term id, or variable n. Term ids convert
+// implicitly, so vocabulary terms can be written as they are:
+//
+//   triple_pattern p = {
+//     pattern_term::variable(0), vocab::rdf_type, vocab::owl_Class
+//   };
+//
+// Variables are numbered from 0; the match of a group of patterns is a
+// binding holding one term id per variable.
+//===========================================================================
+class pattern_term
+{
+public:
+  pattern_term()
+    : id_(invalid_term_id), variable_(false)
+  {}
+
+  pattern_term(term_id id)
+    : id_(id), variable_(false)
+  {}
+
+  static pattern_term variable(unsigned n)
+  {
+    pattern_term t(n);
+    t.variable_ = true;
+    return t;
+  }
+
+  bool is_variable() const { return variable_; }
+
+  unsigned variable_number() const { return id_; }
+  term_id id() const { return id_; }
+
+private:
+  std::uint32_t id_;
+  bool variable_;
+};
+
+struct triple_pattern
+{
+  pattern_term subject;
+  pattern_term predicate;
+  pattern_term object;
+
+  pattern_term const& operator[](unsigned position) const
+  {
+    return position == 0 ? subject : (position == 1 ? predicate : object);
+  }
+};
+
+typedef std::vector<term_id> binding;
+
+//----------------------------------------------------------------------
+// The term at a position (0, 1 or 2) of a triple.
+//----------------------------------------------------------------------
+inline term_id term_at(id_triple const& t, unsigned position)
+{
+  return position == 0 ? t.subject : (position == 1 ? t.predicate : t.object);
+}
+
+//----------------------------------------------------------------------
+// The number of variables a group of patterns uses: one more than the
+// highest variable number.
+//----------------------------------------------------------------------
+inline unsigned variable_count(std::vector<triple_pattern> const& patterns)
+{
+  unsigned n = 0;
+  for (auto const& p : patterns)
+    for (unsigned i = 0; i < 3; ++i)
+      if (p[i].is_variable() && p[i].variable_number() >= n)
+        n = p[i].variable_number() + 1;
+  return n;
+}
+
+//----------------------------------------------------------------------
+// Whether a triple matches a pattern on its own: its terms are equal
+// where the pattern has terms, and where a variable repeats.
+//----------------------------------------------------------------------
+inline bool matches(triple_pattern const& p, id_triple const& t)
+{
+  for (unsigned i = 0; i < 3; ++i)
+  {
+    if (!p[i].is_variable())
+    {
+      if (p[i].id() != term_at(t, i))
+        return false;
+    }
+    else
+      for (unsigned j = 0; j < i; ++j)
+        if (p[j].is_variable() && p[j].variable_number() == p[i].variable_number()
+            && term_at(t, j) != term_at(t, i))
+          return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------
+// Set the pattern's variables in a binding from a triple it matches.
+//----------------------------------------------------------------------
+inline void bind_variables(triple_pattern const& p, id_triple const& t, binding& b)
+{
+  for (unsigned i = 0; i < 3; ++i)
+    if (p[i].is_variable())
+      b[p[i].variable_number()] = term_at(t, i);
+}
+
+//----------------------------------------------------------------------
+// The values of the variables a pattern shares with the patterns joined
+// before it, to hash partial matches and triples on; unused slots hold
+// invalid_term_id.
+//----------------------------------------------------------------------
+struct join_key
+{
+  term_id values[3];
+
+  bool operator==(join_key const& k) const
+  {
+    return values[0] == k.values[0] && values[1] == k.values[1]
+      && values[2] == k.values[2];
+  }
+};
+
+struct join_key_hash
+{
+  std::size_t operator()(join_key const& k) const
+  {
+    id_triple t = { k.values[0], k.values[1], k.values[2] };
+    return id_triple_hash()(t);
+  }
+};
+
+//----------------------------------------------------------------------
+// The triple a pattern stands for under a binding that binds all of its
+// variables.
+//----------------------------------------------------------------------
+inline id_triple instantiate(triple_pattern const& p, binding const& b)
+{
+  term_id terms[3];
+  for (unsigned i = 0; i < 3; ++i)
+    terms[i] = p[i].is_variable() ? b[p[i].variable_number()] : p[i].id();
+  id_triple t = { terms[0], terms[1], terms[2] };
+  return t;
+}
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,606 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains a small expression-template language for triple
+// predicates, for use with ontology_walker, the store_triples_if visitors
+// and the parsers:
+//
+//   using namespace rdf::predicates;
+//   auto pred = predicate_is(rdf::vocab::rdfs_subClassOf) && object_is_uri()
+//            && !subject_in(excluded);
+//
+// An expression is an ordinary function object that can be called on an
+// rdf_triple, a view_triple or an id_triple, and every check inlines into
+// the caller. Unlike a lambda, it can also be inspected: bind( ) resolves
+// its terms against a dictionary, required_term( ) tells an index or a
+// scan which term a position must have, and filter_statements( ) pushes
+// the whole test into the raptor callback, before any triple is built.
+//===========================================================================
+
+#ifndef BST_TRIPLE_PREDICATES_HPP_
+#define BST_TRIPLE_PREDICATES_HPP_
+
+#include "rdf_parser.hpp"
+#include "term_id.hpp"
+#include "term_dictionary.hpp"
+#include "vocabulary.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+#include <initializer_list>
+#include <cstring>
+
+namespace rdf { namespace predicates {
+
+//===========================================================================
+// Positions within a triple.
+//===========================================================================
+struct subject_position
+{
+  static const unsigned index = 0;
+
+  static rdf_term const& get(rdf_triple const& t) { return t.subject(); }
+  static term_view const& get(view_triple const& t) { return t.subject; }
+  static term_id get(id_triple const& t) { return t.subject; }
+};
+
+struct predicate_position
+{
+  static const unsigned index = 1;
+
+  static rdf_term const& get(rdf_triple const& t) { return t.predicate(); }
+  static term_view const& get(view_triple const& t) { return t.predicate; }
+  static term_id get(id_triple const& t) { return t.predicate; }
+};
+
+struct object_position
+{
+  static const unsigned index = 2;
+
+  static rdf_term const& get(rdf_triple const& t) { return t.object(); }
+  static term_view const& get(view_triple const& t) { return t.object; }
+  static term_id get(id_triple const& t) { return t.object; }
+};
+
+namespace {
+
+//----------------------------------------------------------------------
+// Whether a term is the uri given as a string. Literals and blank nodes
+// with the same text are not.
+//----------------------------------------------------------------------
+inline bool uri_equals(rdf_term const& t, std::string const& value)
+{
+  rdf_uri const* u = boost::get<rdf_uri>(&t);
+  if (u == NULL)
+    return false;
+  unsigned_string const& s = u->uri();
+  return s.size() == value.size() && std::memcmp(s.data(), value.data(), s.size()) == 0;
+}
+
+inline bool uri_equals(term_view const& t, std::string const& value)
+{
+  return t.kind == uri_term && t.size == value.size()
+    && std::memcmp(t.data, value.data(), t.size) == 0;
+}
+
+//----------------------------------------------------------------------
+// Ordering of strings against raw bytes, to look terms up in a sorted
+// vector of strings without copying them into a std::string first.
+//----------------------------------------------------------------------
+struct byte_range
+{
+  char const* data;
+  std::size_t size;
+};
+
+struct byte_range_less
+{
+  bool operator()(std::string const& a, byte_range const& b) const
+  {
+    return a.compare(0, a.size(), b.data, b.size) < 0;
+  }
+
+  bool operator()(byte_range const& a, std::string const& b) const
+  {
+    return b.compare(0, b.size(), a.data, a.size) > 0;
+  }
+};
+
+inline term_kind kind_of(rdf_term const& t)
+{
+  return is_uri(t) ? uri_term : (is_literal(t) ? literal_term : blank_term);
+}
+
+inline term_kind kind_of(term_view const& t)
+{
+  return t.kind;
+}
+
+inline term_kind kind_of(term_id id)
+{
+  return rdf::kind_of(id);
+}
+
+} // namespace
+
+//===========================================================================
+// The base of every expression, so that the operators below only apply
+// to expressions.
+//===========================================================================
+template <typename Derived>
+struct expression
+{
+  Derived const& derived() const { return static_cast<Derived const&>(*this); }
+};
+
+//----------------------------------------------------------------------
+// A uri term at a position. Terms given as strings can be tested on
+// rdf_triples and view_triples right away and on id_triples once bound to
+// a dictionary; terms given as ids the other way around. Well-known
+// vocabulary terms work everywhere without binding.
+//----------------------------------------------------------------------
+template <typename Pos>
+class term_is : public expression<term_is<Pos>>
+{
+public:
+  explicit term_is(std::string value)
+    : value_(std::move(value)),
+      id_(vocab::find(value_.data(), value_.size())),
+      has_value_(true),
+      has_id_(id_ != invalid_term_id)
+  {}
+
+  explicit term_is(term_id id)
+    : value_(vocab::is_well_known(id) ? vocab::iri(id) : ""),
+      id_(id),
+      has_value_(vocab::is_well_known(id)),
+      has_id_(true)
+  {}
+
+  bool operator()(rdf_triple const& t) const { return uri_equals(Pos::get(t), value()); }
+  bool operator()(view_triple const& t) const { return uri_equals(Pos::get(t), value()); }
+  bool operator()(id_triple const& t) const { return Pos::get(t) == id(); }
+
+  template <typename Dictionary>
+  term_is bind(Dictionary const& dict) const
+  {
+    term_is bound(*this);
+    if (!has_id_)
+      bound.id_ = dict.find(term_view(uri_term, value_.data(), value_.size()));
+    else if (!has_value_ && id_ != invalid_term_id)
+      bound.value_ = dict.lookup(id_).value();
+    bound.has_id_ = bound.has_value_ = true;
+    return bound;
+  }
+
+  std::string const& value() const
+  {
+    if (!has_value_)
+      throw std::domain_error("term id used without binding to a dictionary");
+    return value_;
+  }
+
+  term_id id() const
+  {
+    if (!has_id_)
+      throw std::domain_error("term string used without binding to a dictionary");
+    return id_;
+  }
+
+  bool has_id() const { return has_id_; }
+
+private:
+  std::string value_;
+  term_id id_;
+  bool has_value_;
+  bool has_id_;
+};
+
+//----------------------------------------------------------------------
+// A term at a position is one of a set of uris. The same binding rules
+// apply as for term_is.
+//----------------------------------------------------------------------
+template <typename Pos>
+class term_in : public expression<term_in<Pos>>
+{
+public:
+  template <typename Container>
+  explicit term_in(Container const& terms)
+    : unbound_(0)
+  {
+    for (auto const& t : terms)
+      add(t);
+    sort_values();
+  }
+
+  bool operator()(rdf_triple const& t) const
+  {
+    rdf_uri const* u = boost::get<rdf_uri>(&Pos::get(t));
+    if (u == NULL)
+      return false;
+    unsigned_string const& s = u->uri();
+    return contains(reinterpret_cast<char const*>(s.data()), s.size());
+  }
+
+  bool operator()(view_triple const& t) const
+  {
+    term_view const& v = Pos::get(t);
+    return v.kind == uri_term && contains(v.data, v.size);
+  }
+
+  bool operator()(id_triple const& t) const
+  {
+    if (unbound_ != 0)
+      throw std::domain_error("term set used without binding to a dictionary");
+    return ids_.count(Pos::get(t)) != 0;
+  }
+
+  template <typename Dictionary>
+  term_in bind(Dictionary const& dict) const
+  {
+    term_in bound(*this);
+    for (auto const& v : values_)
+      bound.ids_.insert(dict.find(term_view(uri_term, v.data(), v.size())));
+    for (auto id : ids_)
+      if (id != invalid_term_id)
+        bound.values_.push_back(dict.lookup(id).value());
+    bound.sort_values();
+    bound.unbound_ = 0;
+    return bound;
+  }
+
+  std::unordered_set<term_id> const& ids() const { return ids_; }
+  bool bound() const { return unbound_ == 0; }
+
+private:
+  bool contains(char const* data, std::size_t size) const
+  {
+    byte_range key = { data, size };
+    return std::binary_search(values_.begin(), values_.end(), key, byte_range_less());
+  }
+
+  void sort_values()
+  {
+    std::sort(values_.begin(), values_.end());
+    values_.erase(std::unique(values_.begin(), values_.end()), values_.end());
+  }
+
+  void add(std::string const& value)
+  {
+    values_.push_back(value);
+    term_id id = vocab::find(value.data(), value.size());
+    if (id == invalid_term_id)
+      ++unbound_;
+    else
+      ids_.insert(id);
+  }
+
+  void add(char const* value)
+  {
+    add(std::string(value));
+  }
+
+  void add(term_id id)
+  {
+    ids_.insert(id);
+    if (vocab::is_well_known(id))
+      values_.push_back(vocab::iri(id));
+  }
+
+  // Sorted, so views can be looked up without building strings.
+  std::vector<std::string> values_;
+  std::unordered_set<term_id> ids_;
+  std::size_t unbound_;
+};
+
+//----------------------------------------------------------------------
+// The term at a position is a uri, a literal or a blank node. On ids
+// this is a test of the top two bits.
+//----------------------------------------------------------------------
+template <typename Pos>
+class kind_is : public expression<kind_is<Pos>>
+{
+public:
+  explicit kind_is(term_kind kind) : kind_(kind) {}
+
+  template <typename Triple>
+  bool operator()(Triple const& t) const { return kind_of(Pos::get(t)) == kind_; }
+
+  template <typename Dictionary>
+  kind_is bind(Dictionary const&) const { return *this; }
+
+  term_kind kind() const { return kind_; }
+
+private:
+  term_kind kind_;
+};
+
+//----------------------------------------------------------------------
+// Always true.
+//----------------------------------------------------------------------
+struct any_triple : public expression<any_triple>
+{
+  template <typename Triple>
+  bool operator()(Triple const&) const { return true; }
+
+  template <typename Dictionary>
+  any_triple bind(Dictionary const&) const { return *this; }
+};
+
+//----------------------------------------------------------------------
+// Combinators.
+//----------------------------------------------------------------------
+template <typename L, typename R>
+class and_expr : public expression<and_expr<L, R>>
+{
+public:
+  and_expr(L const& l, R const& r) : left_(l), right_(r) {}
+
+  template <typename Triple>
+  bool operator()(Triple const& t) const { return left_(t) && right_(t); }
+
+  template <typename Dictionary>
+  and_expr bind(Dictionary const& dict) const
+  {
+    return and_expr(left_.bind(dict), right_.bind(dict));
+  }
+
+  L const& left() const { return left_; }
+  R const& right() const { return right_; }
+
+private:
+  L left_;
+  R right_;
+};
+
+template <typename L, typename R>
+class or_expr : public expression<or_expr<L, R>>
+{
+public:
+  or_expr(L const& l, R const& r) : left_(l), right_(r) {}
+
+  template <typename Triple>
+  bool operator()(Triple const& t) const { return left_(t) || right_(t); }
+
+  template <typename Dictionary>
+  or_expr bind(Dictionary const& dict) const
+  {
+    return or_expr(left_.bind(dict), right_.bind(dict));
+  }
+
+  L const& left() const { return left_; }
+  R const& right() const { return right_; }
+
+private:
+  L left_;
+  R right_;
+};
+
+template <typename E>
+class not_expr : public expression<not_expr<E>>
+{
+public:
+  explicit not_expr(E const& e) : expr_(e) {}
+
+  template <typename Triple>
+  bool operator()(Triple const& t) const { return !expr_(t); }
+
+  template <typename Dictionary>
+  not_expr bind(Dictionary const& dict) const
+  {
+    return not_expr(expr_.bind(dict));
+  }
+
+  E const& operand() const { return expr_; }
+
+private:
+  E expr_;
+};
+
+template <typename L, typename R>
+and_expr<L, R> operator&&(expression<L> const& l, expression<R> const& r)
+{
+  return and_expr<L, R>(l.derived(), r.derived());
+}
+
+template <typename L, typename R>
+or_expr<L, R> operator||(expression<L> const& l, expression<R> const& r)
+{
+  return or_expr<L, R>(l.derived(), r.derived());
+}
+
+template <typename E>
+not_expr<E> operator!(expression<E> const& e)
+{
+  return not_expr<E>(e.derived());
+}
+
+//===========================================================================
+// The leaves of the language.
+//===========================================================================
+inline term_is<subject_position> subject_is(std::string const& uri)
+{ return term_is<subject_position>(uri); }
+inline term_is<subject_position> subject_is(term_id id)
+{ return term_is<subject_position>(id); }
+
+inline term_is<predicate_position> predicate_is(std::string const& uri)
+{ return term_is<predicate_position>(uri); }
+inline term_is<predicate_position> predicate_is(term_id id)
+{ return term_is<predicate_position>(id); }
+
+inline term_is<object_position> object_is(std::string const& uri)
+{ return term_is<object_position>(uri); }
+inline term_is<object_position> object_is(term_id id)
+{ return term_is<object_position>(id); }
+
+template <typename Container>
+term_in<subject_position> subject_in(Container const& terms)
+{ return term_in<subject_position>(terms); }
+
+template <typename Container>
+term_in<predicate_position> predicate_in(Container const& terms)
+{ return term_in<predicate_position>(terms); }
+
+template <typename Container>
+term_in<object_position> object_in(Container const& terms)
+{ return term_in<object_position>(terms); }
+
+inline term_in<predicate_position> predicate_in(std::initializer_list<term_id> ids)
+{ return term_in<predicate_position>(std::vector<term_id>(ids)); }
+
+inline term_in<object_position> object_in(std::initializer_list<term_id> ids)
+{ return term_in<object_position>(std::vector<term_id>(ids)); }
+
+inline kind_is<subject_position> subject_is_uri() { return kind_is<subject_position>(uri_term); }
+inline kind_is<subject_position> subject_is_blank() { return kind_is<subject_position>(blank_term); }
+inline kind_is<object_position> object_is_uri() { return kind_is<object_position>(uri_term); }
+inline kind_is<object_position> object_is_literal() { return kind_is<object_position>(literal_term); }
+inline kind_is<object_position> object_is_blank() { return kind_is<object_position>(blank_term); }
+
+inline any_triple any() { return any_triple(); }
+
+//===========================================================================
+// Introspection.
+//===========================================================================
+
+//----------------------------------------------------------------------
+// Resolve every term of an expression against a dictionary, so that it
+// can be tested on that dictionary's id_triples.
+//----------------------------------------------------------------------
+template <typename E, typename Dictionary>
+E bind(expression<E> const& e, Dictionary const& dict)
+{
+  return e.derived().bind(dict);
+}
+
+//----------------------------------------------------------------------
+// The id every matching triple must have at position Pos, or
+// invalid_term_id if the expression does not pin that position down.
+// An index can use this to turn a filter into a lookup.
+//----------------------------------------------------------------------
+template <typename Pos, typename E>
+term_id required_term(E const&)
+{
+  return invalid_term_id;
+}
+
+template <typename Pos>
+term_id required_term(term_is<Pos> const& e)
+{
+  return e.has_id() ? e.id() : invalid_term_id;
+}
+
+template <typename Pos, typename L, typename R>
+term_id required_term(and_expr<L, R> const& e)
+{
+  term_id id = required_term<Pos>(e.left());
+  return id != invalid_term_id ? id : required_term<Pos>(e.right());
+}
+
+template <typename Pos, typename L, typename R>
+term_id required_term(or_expr<L, R> const& e)
+{
+  term_id id = required_term<Pos>(e.left());
+  return id == required_term<Pos>(e.right()) ? id : invalid_term_id;
+}
+
+//===========================================================================
+// Pushing an expression down into the parser: a converter that only lets
+// matching statements through. The test runs on views of raptor's own
+// buffers, so rejected statements are never converted at all.
+//
+//   parser(file, dest, filter_statements(predicate_is(rdf::vocab::rdf_type)));
+//===========================================================================
+template <typename E, typename Converter>
+class filtering_converter
+{
+public:
+  typedef typename Converter::result_type result_type;
+
+  filtering_converter(E const& e, Converter const& conv)
+    : expr_(e), conv_(conv)
+  {}
+
+  result_type operator()(raptor_statement* statement) const
+  {
+    return conv_(statement);
+  }
+
+  result_type operator()(view_triple const& t) const
+  {
+    return conv_(t);
+  }
+
+  bool accepts(view_triple const& t) const
+  {
+    return expr_(t);
+  }
+
+  bool accepts(raptor_statement* statement) const
+  {
+    view_triple t = {
+      make_term_view(statement->subject),
+      make_term_view(statement->predicate),
+      make_term_view(statement->object)
+    };
+    return expr_(t);
+  }
+
+private:
+  E expr_;
+  Converter conv_;
+};
+
+template <typename E, typename Converter>
+inline bool accept_statement(filtering_converter<E, Converter> const& conv, raptor_statement* statement)
+{
+  return conv.accepts(statement);
+}
+
+template <typename E, typename Converter>
+inline bool accept_statement(filtering_converter<E, Converter> const& conv, view_triple const& t)
+{
+  return conv.accepts(t);
+}
+
+template <typename E, typename Converter>
+filtering_converter<E, Converter>
+filter_statements(expression<E> const& e, Converter const& conv)
+{
+  return filtering_converter<E, Converter>(e.derived(), conv);
+}
+
+template <typename E>
+filtering_converter<E, rdf_triple_converter>
+filter_statements(expression<E> const& e)
+{
+  return filtering_converter<E, rdf_triple_converter>(e.derived(), rdf_triple_converter());
+}
+
+} // namespace predicates
+} // namespace rdf
+
+#endif
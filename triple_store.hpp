@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines triple_store, an in-memory store of interned triples:
+// a term_dictionary, the id_triples that refer to it, and a
+// membership_index over them.
+//===========================================================================
+
+#ifndef BST_TRIPLE_STORE_HPP_
+#define BST_TRIPLE_STORE_HPP_
+
+#include "term_id.hpp"
+#include "term_dictionary.hpp"
+#include "sharded.hpp"
+#include "membership_index.hpp"
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iterator>
+
+namespace rdf {
+
+//===========================================================================
+// Triples are kept in one vector, in the order they were added. Adding
+// triples is not thread-safe; to load a store from parallel parses use a
+// loader, which collects each thread's triples apart and adds them all at
+// once on commit( ).
+//===========================================================================
+class triple_store
+{
+public:
+  triple_store() {}
+
+  term_dictionary& dictionary() { return dict_; }
+  term_dictionary const& dictionary() const { return dict_; }
+
+  std::vector<id_triple> const& triples() const { return triples_; }
+  std::size_t size() const { return triples_.size(); }
+
+  //----------------------------------------------------------------------
+  // The predicate and class membership of the triples, kept up to date
+  // by every insert.
+  //----------------------------------------------------------------------
+  membership_index const& index() const { return index_; }
+
+  //----------------------------------------------------------------------
+  // A converter interning into this store's dictionary.
+  //----------------------------------------------------------------------
+  interning_converter converter() { return interning_converter(dict_); }
+
+  void insert(id_triple const& t)
+  {
+    triples_.push_back(t);
+    index_.add(t);
+  }
+
+  template <typename Iter>
+  void insert(Iter first, Iter last)
+  {
+    std::size_t old_size = triples_.size();
+    triples_.insert(triples_.end(), first, last);
+    index_.add(triples_.begin() + old_size, triples_.end());
+  }
+
+  //----------------------------------------------------------------------
+  // Replace all of the store's triples, e.g. by a rewritten copy.
+  //----------------------------------------------------------------------
+  void assign(std::vector<id_triple> triples)
+  {
+    triples_.swap(triples);
+    index_.clear();
+    index_.add(triples_.begin(), triples_.end());
+  }
+
+  //----------------------------------------------------------------------
+  // A visitor, for parse_files( ) or the ontology walker with this
+  // store's converter, that loads the triples it sees into the store.
+  // Copies share their shards and may be used from any number of
+  // threads; call commit( ) once they are done.
+  //----------------------------------------------------------------------
+  class loader
+  {
+  public:
+    explicit loader(triple_store& store)
+      : store_(&store)
+    {}
+
+    template <typename Iter>
+    void operator()(std::string const&, Iter first, Iter last) const
+    {
+      std::vector<id_triple>& shard = shards_.local();
+      shard.insert(shard.end(), first, last);
+    }
+
+    void commit() const
+    {
+      shards_.merge([this](std::vector<id_triple>&, std::vector<id_triple>& shard) {
+          store_->insert(shard.begin(), shard.end());
+          std::vector<id_triple>().swap(shard);
+        });
+    }
+
+  private:
+    triple_store* store_;
+    sharded<std::vector<id_triple>> shards_;
+  };
+
+  loader bulk_loader() { return loader(*this); }
+
+private:
+  triple_store(triple_store const&);
+  triple_store& operator=(triple_store const&);
+
+  term_dictionary dict_;
+  std::vector<id_triple> triples_;
+  membership_index index_;
+};
+
+} // namespace rdf
+
+#endif
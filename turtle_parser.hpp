@@ -0,0 +1,1071 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains a native streaming Turtle parser. Like the N-Triples
+// parser it bypasses raptor and hands view_triples to the same converters
+// rdf_parser uses, so its output can go straight into a term_dictionary.
+//
+// Input may arrive in chunks of any size (from a file, or from a network
+// stream as it is received): a small scanner finds where each top-level
+// statement ends, and each complete statement is then parsed in place.
+// Only the tail of a chunk holding an unfinished statement is copied.
+//
+// Prefixed names are resolved to a prefix id through a small cache, then
+// expanded as they are parsed: the namespace and local name are copied
+// into the per-statement arena, without touching the heap. Converters
+// take view_triples, so they only ever see the full IRI.
+//===========================================================================
+
+#ifndef BST_TURTLE_PARSER_HPP_
+#define BST_TURTLE_PARSER_HPP_
+
+#include "rdf_parser.hpp"
+#include "ntriples_parser.hpp"
+#include "term_id.hpp"
+#include "term_validation.hpp"
+#include "vocabulary.hpp"
+#include "iri_resolution.hpp"
+#include "file_reader.hpp"
+
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+namespace rdf {
+
+namespace {
+
+inline bool is_turtle_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline bool is_turtle_name_char(char c)
+{
+  unsigned char u = static_cast<unsigned char>(c);
+  return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9')
+    || u == '_' || u == '-' || u >= 0x80;
+}
+
+inline bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+//----------------------------------------------------------------------
+// Whether text starts with the keyword (in any case) followed by space.
+//----------------------------------------------------------------------
+inline bool starts_with_keyword(char const* text, std::size_t size, char const* keyword)
+{
+  std::size_t n = std::strlen(keyword);
+  if (size <= n)
+    return false;
+  for (std::size_t i = 0; i < n; ++i)
+    if ((text[i] | 0x20) != (keyword[i] | 0x20))
+      return false;
+  return is_turtle_space(text[n]);
+}
+
+struct turtle_syntax_error : std::domain_error
+{
+  explicit turtle_syntax_error(std::string const& what)
+    : std::domain_error(what)
+  {}
+};
+
+} // namespace
+
+//===========================================================================
+// Finds where the statement at the front of a stretch of Turtle ends,
+// without parsing it: it tracks just enough state (IRIs, strings,
+// comments and bracket depth) to tell a top-level '.' from any other.
+// Scanning picks up where it left off when more text arrives.
+//===========================================================================
+class turtle_boundary_scanner
+{
+public:
+  turtle_boundary_scanner()
+  {
+    reset();
+  }
+
+  //----------------------------------------------------------------------
+  // The length of the statement at the front of text, or 0 if text does
+  // not hold all of it yet. With final set, whatever is left is the last
+  // statement. text must start where it started on the previous call;
+  // it may only have grown since.
+  //----------------------------------------------------------------------
+  std::size_t scan(char const* text, std::size_t size, bool final)
+  {
+    while (pos_ < size)
+    {
+      char c = text[pos_];
+      switch (state_)
+      {
+      case start:
+        if (is_turtle_space(c))
+          ++pos_;
+        else if (c == '#')
+        {
+          state_ = start_comment;
+          ++pos_;
+        }
+        else if (c == '@')
+          state_ = top;
+        else
+        {
+          // SPARQL-style PREFIX and BASE end at their IRI, not at a '.'.
+          std::size_t avail = size - pos_;
+          if (avail <= 6 && !final)
+            return 0;
+          if (starts_with_keyword(text + pos_, avail, "prefix")
+              || starts_with_keyword(text + pos_, avail, "base"))
+            state_ = directive;
+          else
+            state_ = top;
+        }
+        break;
+
+      case start_comment:
+      case comment:
+        if (c == '\n')
+          state_ = (state_ == start_comment) ? start : top;
+        ++pos_;
+        break;
+
+      case directive:
+      case iri:
+      {
+        char const* gt = static_cast<char const*>(std::memchr(text + pos_, '>', size - pos_));
+        if (gt == NULL)
+        {
+          pos_ = size;
+          break;
+        }
+        pos_ = gt - text + 1;
+        if (state_ == directive)
+          return finish_statement(pos_);
+        state_ = top;
+        break;
+      }
+
+      case short_string:
+      case long_string:
+        while (c != quote_ && c != '\\' && !(state_ == short_string && is_line_break(c))
+               && ++pos_ < size)
+          c = text[pos_];
+        if (pos_ == size)
+          break;
+        if (is_line_break(c) && state_ == short_string)
+        {
+          // Short strings cannot span lines, so this one is unterminated.
+          // End the statement here: parsing it reports the error, and the
+          // rest of the document is not swallowed into one long string.
+          return finish_statement(pos_ + 1);
+        }
+        if (c == '\\')
+        {
+          if (pos_ + 1 >= size && !final)
+            return 0;
+          bool before_break = state_ == short_string && pos_ + 1 < size
+            && is_line_break(text[pos_ + 1]);
+          pos_ += before_break ? 1 : 2;
+          break;
+        }
+        if (c == quote_)
+        {
+          if (state_ == short_string)
+            state_ = top;
+          else
+          {
+            if (size - pos_ < 3 && !final)
+              return 0;
+            if (size - pos_ >= 3 && text[pos_ + 1] == quote_ && text[pos_ + 2] == quote_)
+            {
+              state_ = top;
+              pos_ += 2;
+            }
+          }
+        }
+        ++pos_;
+        break;
+
+      case top:
+        while (!is_boundary_special(c) && ++pos_ < size)
+          c = text[pos_];
+        if (pos_ == size)
+          break;
+        switch (c)
+        {
+        case '#':
+          state_ = comment;
+          break;
+        case '<':
+          state_ = iri;
+          break;
+        case '"':
+        case '\'':
+          if (size - pos_ < 3 && !final)
+            return 0;
+          quote_ = c;
+          if (size - pos_ >= 3 && text[pos_ + 1] == c && text[pos_ + 2] == c)
+          {
+            state_ = long_string;
+            pos_ += 2;
+          }
+          else
+            state_ = short_string;
+          break;
+        case '\\':
+          ++pos_;
+          break;
+        case '[':
+        case '(':
+          ++depth_;
+          break;
+        case ']':
+        case ')':
+          if (depth_ != 0)
+            --depth_;
+          break;
+        case '.':
+          if (depth_ == 0)
+          {
+            if (pos_ + 1 >= size && !final)
+              return 0;
+
+            // Dots also appear inside names and numbers.
+            char next = (pos_ + 1 < size) ? text[pos_ + 1] : ' ';
+            char prev = (pos_ > 0) ? text[pos_ - 1] : ' ';
+            bool inside_name = is_turtle_name_char(prev)
+              && (is_turtle_name_char(next) || next == ':' || next == '%');
+            if (!is_digit(next) && !inside_name)
+              return finish_statement(pos_ + 1);
+          }
+          break;
+        }
+        ++pos_;
+        break;
+      }
+    }
+
+    if (final && size != 0)
+      return finish_statement(size);
+    return 0;
+  }
+
+  void reset()
+  {
+    state_ = start;
+    depth_ = 0;
+    pos_ = 0;
+    quote_ = 0;
+  }
+
+private:
+  static bool is_line_break(char c)
+  {
+    return c == '\n' || c == '\r';
+  }
+
+  //----------------------------------------------------------------------
+  // The characters that mean anything to the scan at the top level.
+  //----------------------------------------------------------------------
+  static bool is_boundary_special(char c)
+  {
+    switch (c)
+    {
+    case '#': case '<': case '"': case '\'': case '\\':
+    case '[': case '(': case ']': case ')': case '.':
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  std::size_t finish_statement(std::size_t n)
+  {
+    reset();
+    return n;
+  }
+
+  enum scan_state
+  {
+    start, start_comment, top, comment, directive, iri, short_string, long_string
+  };
+
+  scan_state state_;
+  unsigned depth_;
+  std::size_t pos_;
+  char quote_;
+};
+
+//===========================================================================
+// A Turtle document being parsed. Text is fed in with feed( ) as it
+// arrives, and each statement's triples are written through dest as soon
+// as the statement is complete; finish( ) ends the document.
+//
+//   rdf::turtle_stream<Iter, rdf::rdf_triple_converter> s(url, dest, conv);
+//   while (...) s.feed(data, size);
+//   bool ok = s.finish();
+//
+// Syntax errors are reported on std::cerr; the offending statement is
+// skipped and finish( ) returns false.
+//===========================================================================
+template <typename Iter, typename Converter>
+class turtle_stream
+{
+public:
+  turtle_stream(std::string const& name, Iter dest, Converter conv)
+    : name_(name), dest_(dest), conv_(conv), base_(document_base(name)),
+      line_(1), good_(true), blank_count_(0)
+  {
+    std::fill(prefix_cache_, prefix_cache_ + prefix_cache_size, -1);
+    rdf_type_ = vocabulary_view(vocab::rdf_type);
+    rdf_first_ = vocabulary_view(vocab::rdf_first);
+    rdf_rest_ = vocabulary_view(vocab::rdf_rest);
+    rdf_nil_ = vocabulary_view(vocab::rdf_nil);
+  }
+
+  void feed(char const* data, std::size_t size)
+  {
+    if (pending_.empty())
+    {
+      std::size_t used = consume(data, size, false);
+      pending_.assign(data + used, size - used);
+    }
+    else
+    {
+      pending_.append(data, size);
+      std::size_t used = consume(pending_.data(), pending_.size(), false);
+      pending_.erase(0, used);
+    }
+  }
+
+  bool finish()
+  {
+    consume(pending_.data(), pending_.size(), true);
+    pending_.clear();
+    return good_;
+  }
+
+  Iter dest() const { return dest_; }
+  bool good() const { return good_; }
+
+  //----------------------------------------------------------------------
+  // The namespace IRI of a prefix id, as declared so far.
+  //----------------------------------------------------------------------
+  std::string const& prefix_iri(unsigned id) const { return prefix_iris_[id]; }
+
+private:
+  //----------------------------------------------------------------------
+  // A prefixed name, before it is expanded into a full IRI.
+  //----------------------------------------------------------------------
+  struct prefixed_name
+  {
+    unsigned prefix;
+    char const* local;
+    std::size_t local_size;
+    bool escaped;
+  };
+
+  static term_view vocabulary_view(term_id id)
+  {
+    char const* iri = vocab::iri(id);
+    return term_view(uri_term, iri, std::strlen(iri));
+  }
+
+  std::size_t consume(char const* text, std::size_t size, bool final)
+  {
+    std::size_t used = 0;
+    while (used < size)
+    {
+      std::size_t n = scanner_.scan(text + used, size - used, final);
+      if (n == 0)
+        break;
+      parse_statement(text + used, text + used + n);
+      used += n;
+    }
+    return used;
+  }
+
+  void parse_statement(char const* first, char const* last)
+  {
+    arena_.rewind();
+    p_ = first;
+    end_ = last;
+
+    try
+    {
+      statement();
+    }
+    catch (turtle_syntax_error const& e)
+    {
+      good_ = false;
+      std::size_t line = line_ + std::count(first, std::min(p_, last), '\n');
+      std::cerr << name_ << ":" << line << ": " << e.what() << std::endl;
+    }
+    line_ += std::count(first, last, '\n');
+  }
+
+  //----------------------------------------------------------------------
+  // The grammar, one function per production.
+  //----------------------------------------------------------------------
+  void statement()
+  {
+    skip_space();
+    if (p_ == end_)
+      return;
+
+    if (*p_ == '@')
+    {
+      if (starts_with_keyword(p_, end_ - p_, "@prefix"))
+      {
+        p_ += 7;
+        prefix_directive();
+      }
+      else if (starts_with_keyword(p_, end_ - p_, "@base"))
+      {
+        p_ += 5;
+        base_directive();
+      }
+      else
+        fail("unknown directive");
+      skip_space();
+      expect('.');
+    }
+    else if (starts_with_keyword(p_, end_ - p_, "prefix"))
+    {
+      p_ += 6;
+      prefix_directive();
+    }
+    else if (starts_with_keyword(p_, end_ - p_, "base"))
+    {
+      p_ += 4;
+      base_directive();
+    }
+    else
+    {
+      triples();
+      skip_space();
+      expect('.');
+    }
+
+    skip_space();
+    if (p_ != end_)
+      fail("unexpected text after statement");
+  }
+
+  void prefix_directive()
+  {
+    skip_space();
+    char const* name = p_;
+    while (p_ != end_ && *p_ != ':')
+    {
+      if (!is_turtle_name_char(*p_) && *p_ != '.')
+        fail("bad prefix name");
+      ++p_;
+    }
+    std::string prefix(name, p_);
+    expect(':');
+
+    skip_space();
+    term_view ns = iri_ref();
+    std::string iri = ns.value();
+
+    typename std::unordered_map<std::string, unsigned>::iterator i = prefix_ids_.find(prefix);
+    if (i == prefix_ids_.end())
+    {
+      prefix_ids_.insert(std::make_pair(prefix, static_cast<unsigned>(prefix_iris_.size())));
+      prefix_names_.push_back(prefix);
+      prefix_iris_.push_back(iri);
+    }
+    else
+      prefix_iris_[i->second] = iri;
+  }
+
+  void base_directive()
+  {
+    skip_space();
+    term_view b = iri_ref();
+    base_ = base_iri(b.value());
+  }
+
+  void triples()
+  {
+    if (*p_ == '[')
+    {
+      term_view subject = blank_node_property_list();
+      skip_space();
+      if (p_ != end_ && *p_ != '.')
+        predicate_object_list(subject);
+    }
+    else
+    {
+      term_view subject = subject_term();
+      predicate_object_list(subject);
+    }
+  }
+
+  void predicate_object_list(term_view const& subject)
+  {
+    for (;;)
+    {
+      skip_space();
+      term_view predicate = verb();
+      object_list(subject, predicate);
+
+      skip_space();
+      if (p_ == end_ || *p_ != ';')
+        return;
+      while (p_ != end_ && *p_ == ';')
+      {
+        ++p_;
+        skip_space();
+      }
+      if (p_ == end_ || *p_ == '.' || *p_ == ']')
+        return;
+    }
+  }
+
+  void object_list(term_view const& subject, term_view const& predicate)
+  {
+    for (;;)
+    {
+      skip_space();
+      term_view object = object_term();
+      emit(subject, predicate, object);
+
+      skip_space();
+      if (p_ == end_ || *p_ != ',')
+        return;
+      ++p_;
+    }
+  }
+
+  term_view subject_term()
+  {
+    if (p_ == end_)
+      fail("expected a subject");
+    switch (*p_)
+    {
+    case '<': return iri_ref();
+    case '(': return collection();
+    case '_': return blank_node_label();
+    default:  return expand(prefixed());
+    }
+  }
+
+  term_view verb()
+  {
+    if (keyword("a"))
+    {
+      ++p_;
+      return rdf_type_;
+    }
+    if (p_ != end_ && *p_ == '<')
+      return iri_ref();
+    return expand(prefixed());
+  }
+
+  term_view object_term()
+  {
+    if (p_ == end_)
+      fail("expected an object");
+
+    char c = *p_;
+    switch (c)
+    {
+    case '<': return iri_ref();
+    case '(': return collection();
+    case '[': return blank_node_property_list();
+    case '"':
+    case '\'':
+      return literal();
+    case '_':
+      if (p_ + 1 != end_ && p_[1] == ':')
+        return blank_node_label();
+      break;
+    }
+
+    if (is_digit(c) || c == '+' || c == '-' || (c == '.' && p_ + 1 != end_ && is_digit(p_[1])))
+      return number();
+    if (keyword("true") || keyword("false"))
+    {
+      char const* value = p_;
+      p_ += (*p_ == 't') ? 4 : 5;
+      return typed(value, p_ - value, vocab::xsd_boolean);
+    }
+    return expand(prefixed());
+  }
+
+  term_view blank_node_label()
+  {
+    if (end_ - p_ < 3 || p_[1] != ':')
+      fail("bad blank node label");
+    p_ += 2;
+
+    char const* label = p_;
+    while (p_ != end_ && (is_turtle_name_char(*p_)
+                          || (*p_ == '.' && p_ + 1 != end_ && is_turtle_name_char(p_[1]))))
+      ++p_;
+    if (p_ == label)
+      fail("bad blank node label");
+
+    // Labels starting with genid- get another genid- in front, which no
+    // generated label has, so the two can never meet; see new_blank( ).
+    std::size_t n = p_ - label;
+    if (n >= 6 && std::memcmp(label, "genid-", 6) == 0)
+    {
+      char* buffer = arena_.allocate(n + 6);
+      std::memcpy(buffer, "genid-", 6);
+      std::memcpy(buffer + 6, label, n);
+      return term_view(blank_term, buffer, n + 6);
+    }
+    return term_view(blank_term, label, n);
+  }
+
+  term_view blank_node_property_list()
+  {
+    ++p_;
+    term_view node = new_blank();
+    skip_space();
+    if (p_ != end_ && *p_ != ']')
+      predicate_object_list(node);
+    skip_space();
+    expect(']');
+    return node;
+  }
+
+  term_view collection()
+  {
+    ++p_;
+    skip_space();
+    if (p_ != end_ && *p_ == ')')
+    {
+      ++p_;
+      return rdf_nil_;
+    }
+
+    term_view head = new_blank();
+    term_view node = head;
+    for (;;)
+    {
+      term_view item = object_term();
+      emit(node, rdf_first_, item);
+
+      skip_space();
+      if (p_ != end_ && *p_ == ')')
+      {
+        ++p_;
+        emit(node, rdf_rest_, rdf_nil_);
+        return head;
+      }
+
+      term_view next = new_blank();
+      emit(node, rdf_rest_, next);
+      node = next;
+    }
+  }
+
+  term_view iri_ref()
+  {
+    expect('<');
+    char const* first = p_;
+    char const* last = static_cast<char const*>(std::memchr(p_, '>', end_ - p_));
+    if (last == NULL)
+      fail("unterminated IRI");
+    p_ = last + 1;
+
+    std::size_t size = last - first;
+    if (std::memchr(first, '\\', size) != NULL)
+    {
+      char* buffer = arena_.allocate(size);
+      std::ptrdiff_t n = unescape(first, last, buffer, true);
+      if (n < 0)
+        fail("bad escape in IRI");
+      first = buffer;
+      size = static_cast<std::size_t>(n);
+    }
+    if (!validate_iri(first, size))
+      fail("bad IRI");
+
+    if (scheme_length(first, size) != 0)
+      return term_view(uri_term, first, size);
+
+    base_.resolve(first, size, scratch_);
+    return copy_to_arena(uri_term, scratch_.data(), scratch_.size());
+  }
+
+  //----------------------------------------------------------------------
+  // A prefixed name: the prefix is looked up and the local name left as
+  // it is. Documents use few prefixes, so a small direct-mapped cache in
+  // front of the table catches nearly every lookup.
+  //----------------------------------------------------------------------
+  prefixed_name prefixed()
+  {
+    char const* name = p_;
+    while (p_ != end_ && (is_turtle_name_char(*p_) || *p_ == '.'))
+      ++p_;
+    if (p_ == end_ || *p_ != ':' || (p_ != name && p_[-1] == '.'))
+      fail("expected a prefixed name");
+
+    std::size_t name_size = p_ - name;
+    ++p_;
+
+    prefixed_name result;
+    std::size_t slot = (name_size == 0) ? 0
+      : (name_size * 31 + static_cast<unsigned char>(name[0]) * 7
+         + static_cast<unsigned char>(name[name_size - 1])) % prefix_cache_size;
+    int cached = prefix_cache_[slot];
+    if (cached >= 0
+        && prefix_names_[cached].size() == name_size
+        && std::memcmp(prefix_names_[cached].data(), name, name_size) == 0)
+      result.prefix = static_cast<unsigned>(cached);
+    else
+    {
+      typename std::unordered_map<std::string, unsigned>::const_iterator i =
+        prefix_ids_.find(std::string(name, name_size));
+      if (i == prefix_ids_.end())
+        fail("undeclared prefix");
+      result.prefix = i->second;
+      prefix_cache_[slot] = static_cast<int>(i->second);
+    }
+
+    result.local = p_;
+    result.escaped = false;
+    while (p_ != end_)
+    {
+      char c = *p_;
+      if (is_turtle_name_char(c) || c == ':' || c == '%')
+        ++p_;
+      else if (c == '\\' && p_ + 1 != end_)
+      {
+        result.escaped = true;
+        p_ += 2;
+      }
+      else if (c == '.' && p_ + 1 != end_
+               && (is_turtle_name_char(p_[1]) || p_[1] == ':' || p_[1] == '%' || p_[1] == '\\'))
+        ++p_;
+      else
+        break;
+    }
+    result.local_size = p_ - result.local;
+    return result;
+  }
+
+  term_view expand(prefixed_name const& name)
+  {
+    std::string const& ns = prefix_iris_[name.prefix];
+    char* buffer = arena_.allocate(ns.size() + name.local_size);
+    std::memcpy(buffer, ns.data(), ns.size());
+
+    char* out = buffer + ns.size();
+    if (!name.escaped)
+    {
+      std::memcpy(out, name.local, name.local_size);
+      out += name.local_size;
+    }
+    else
+    {
+      for (char const* c = name.local; c != name.local + name.local_size; ++c)
+        if (*c != '\\')
+          *out++ = *c;
+        else
+          *out++ = *++c;
+    }
+
+    std::size_t size = out - buffer;
+    if (!validate_utf8(buffer + ns.size(), size - ns.size()))
+      fail("bad local name");
+    return term_view(uri_term, buffer, size);
+  }
+
+  term_view literal()
+  {
+    char quote = *p_;
+    bool is_long = (end_ - p_ >= 6 && p_[1] == quote && p_[2] == quote);
+    p_ += is_long ? 3 : 1;
+
+    char const* first = p_;
+    bool escaped = false;
+    for (;;)
+    {
+      if (p_ == end_)
+        fail("unterminated string");
+      char c = *p_;
+      if (c == '\\')
+      {
+        if (end_ - p_ < 2)
+          fail("unterminated string");
+        escaped = true;
+        p_ += 2;
+        continue;
+      }
+      if (c == quote && (!is_long || (end_ - p_ >= 3 && p_[1] == quote && p_[2] == quote)))
+        break;
+      if (!is_long && (c == '\n' || c == '\r'))
+        fail("line break in string");
+      ++p_;
+    }
+    char const* last = p_;
+    p_ += is_long ? 3 : 1;
+
+    std::size_t size = last - first;
+    if (escaped)
+    {
+      char* buffer = arena_.allocate(size);
+      std::ptrdiff_t n = unescape(first, last, buffer, false);
+      if (n < 0)
+        fail("bad escape in string");
+      first = buffer;
+      size = static_cast<std::size_t>(n);
+    }
+    if (!validate_utf8(first, size))
+      fail("bad UTF-8 in string");
+
+    term_view result(literal_term, first, size);
+    if (p_ != end_ && *p_ == '@')
+    {
+      char const* tag = ++p_;
+      while (p_ != end_ && (is_turtle_name_char(*p_) && *p_ != '_'))
+        ++p_;
+      if (p_ == tag)
+        fail("bad language tag");
+      result.language = tag;
+      result.language_size = p_ - tag;
+    }
+    else if (end_ - p_ >= 2 && p_[0] == '^' && p_[1] == '^')
+    {
+      p_ += 2;
+      term_view datatype = (p_ != end_ && *p_ == '<') ? iri_ref() : expand(prefixed());
+      result.datatype = datatype.data;
+      result.datatype_size = datatype.size;
+    }
+    return result;
+  }
+
+  term_view number()
+  {
+    char const* first = p_;
+    if (*p_ == '+' || *p_ == '-')
+      ++p_;
+
+    char const* digits = p_;
+    while (p_ != end_ && is_digit(*p_))
+      ++p_;
+    bool integral = (p_ != digits);
+    term_id type = vocab::xsd_integer;
+
+    if (p_ != end_ && *p_ == '.' && p_ + 1 != end_ && is_digit(p_[1]))
+    {
+      ++p_;
+      while (p_ != end_ && is_digit(*p_))
+        ++p_;
+      integral = true;
+      type = vocab::xsd_decimal;
+    }
+    if (!integral)
+      fail("bad number");
+
+    if (p_ != end_ && (*p_ == 'e' || *p_ == 'E'))
+    {
+      ++p_;
+      if (p_ != end_ && (*p_ == '+' || *p_ == '-'))
+        ++p_;
+      char const* exponent = p_;
+      while (p_ != end_ && is_digit(*p_))
+        ++p_;
+      if (p_ == exponent)
+        fail("bad number");
+      type = vocab::xsd_double;
+    }
+    return typed(first, p_ - first, type);
+  }
+
+  //----------------------------------------------------------------------
+  // Helpers.
+  //----------------------------------------------------------------------
+  term_view typed(char const* value, std::size_t size, term_id datatype)
+  {
+    char const* dt = vocab::iri(datatype);
+    return term_view(literal_term, value, size, dt, std::strlen(dt));
+  }
+
+  // Generated labels are genid- followed by digits only; see
+  // blank_node_label( ) for how the document's labels are kept clear.
+  term_view new_blank()
+  {
+    char* label = arena_.allocate(32);
+    int n = std::snprintf(label, 32, "genid-%lu", static_cast<unsigned long>(++blank_count_));
+    return term_view(blank_term, label, static_cast<std::size_t>(n));
+  }
+
+  term_view copy_to_arena(term_kind kind, char const* data, std::size_t size)
+  {
+    char* buffer = arena_.allocate(size);
+    std::memcpy(buffer, data, size);
+    return term_view(kind, buffer, size);
+  }
+
+  bool keyword(char const* word)
+  {
+    std::size_t n = std::strlen(word);
+    return static_cast<std::size_t>(end_ - p_) >= n
+      && std::memcmp(p_, word, n) == 0
+      && (p_ + n == end_ || !(is_turtle_name_char(p_[n]) || p_[n] == ':'));
+  }
+
+  void skip_space()
+  {
+    while (p_ != end_)
+    {
+      if (is_turtle_space(*p_))
+        ++p_;
+      else if (*p_ == '#')
+      {
+        char const* nl = static_cast<char const*>(std::memchr(p_, '\n', end_ - p_));
+        p_ = (nl == NULL) ? end_ : nl;
+      }
+      else
+        break;
+    }
+  }
+
+  void expect(char c)
+  {
+    if (p_ == end_ || *p_ != c)
+      throw turtle_syntax_error(std::string("expected '") + c + "'");
+    ++p_;
+  }
+
+  void fail(char const* what)
+  {
+    throw turtle_syntax_error(what);
+  }
+
+  void emit(term_view const& s, term_view const& p, term_view const& o)
+  {
+    view_triple t = { s, p, o };
+    if (accept_statement(conv_, t))
+    {
+      *dest_ = conv_(t);
+      ++dest_;
+    }
+  }
+
+  turtle_stream(turtle_stream const&);
+  turtle_stream& operator=(turtle_stream const&);
+
+  std::string name_;
+  Iter dest_;
+  Converter conv_;
+  base_iri base_;
+  std::size_t line_;
+  bool good_;
+  unsigned long blank_count_;
+
+  turtle_boundary_scanner scanner_;
+  std::string pending_;
+  term_arena arena_;
+  std::string scratch_;
+
+  std::unordered_map<std::string, unsigned> prefix_ids_;
+  std::vector<std::string> prefix_names_;
+  std::vector<std::string> prefix_iris_;
+  static const std::size_t prefix_cache_size = 61;
+  int prefix_cache_[prefix_cache_size];
+
+  term_view rdf_type_;
+  term_view rdf_first_;
+  term_view rdf_rest_;
+  term_view rdf_nil_;
+
+  char const* p_;
+  char const* end_;
+};
+
+//===========================================================================
+// The Turtle parser, with the same interface as rdf_parser and
+// ntriples_parser. For input that arrives piecemeal, use a turtle_stream
+// directly.
+//===========================================================================
+class turtle_parser
+{
+public:
+  explicit turtle_parser(read_options const& opts = read_options())
+    : opts_(opts)
+  {}
+
+  template <typename Iter>
+  bool operator()(std::string const& file_name, Iter dest) const
+  {
+    return (*this)(file_name, dest, rdf_triple_converter());
+  }
+
+  //----------------------------------------------------------------------
+  // Parse a file. Throws std::domain_error if the file cannot be opened
+  // or read.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  bool operator()(std::string const& file_name, Iter dest, Converter conv) const
+  {
+    file_reader reader(file_name, opts_);
+    turtle_stream<Iter, Converter> stream(file_name, dest, conv);
+    reader.for_each_chunk([&stream](unsigned char const* data, std::size_t size) {
+        stream.feed(reinterpret_cast<char const*>(data), size);
+      });
+    return stream.finish();
+  }
+
+  //----------------------------------------------------------------------
+  // Parse a document that is already in memory. name is its base IRI.
+  //----------------------------------------------------------------------
+  template <typename Iter, typename Converter>
+  bool parse_buffer(
+    std::string const& name, unsigned char const* data, std::size_t size,
+    Iter dest, Converter conv) const
+  {
+    turtle_stream<Iter, Converter> stream(name, dest, conv);
+    stream.feed(reinterpret_cast<char const*>(data), size);
+    return stream.finish();
+  }
+
+  template <typename Iter>
+  bool parse_buffer(
+    std::string const& name, unsigned char const* data, std::size_t size, Iter dest) const
+  {
+    return parse_buffer(name, data, size, dest, rdf_triple_converter());
+  }
+
+private:
+  read_options opts_;
+};
+
+} // namespace rdf
+
+#endif
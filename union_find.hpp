@@ -0,0 +1,213 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file defines concurrent_union_find, a lock-free disjoint-set
+// forest over the integers [0, n) that many threads may unite at once,
+// and sparse_union_find, the same over the whole 32-bit range.
+//===========================================================================
+
+#ifndef BST_UNION_FIND_HPP_
+#define BST_UNION_FIND_HPP_
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace rdf {
+
+//===========================================================================
+// Roots are linked with a compare-and-swap, always the larger under the
+// smaller, so every set ends up represented by its smallest element and
+// the result does not depend on the order of the unions. find( ) halves
+// the paths it walks as it goes. Elements are 32-bit.
+//===========================================================================
+class concurrent_union_find
+{
+public:
+  explicit concurrent_union_find(std::size_t n)
+    : parent_(n)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+      parent_[i].store(static_cast<std::uint32_t>(i), std::memory_order_relaxed);
+  }
+
+  std::size_t size() const { return parent_.size(); }
+
+  std::uint32_t find(std::uint32_t x)
+  {
+    for (;;)
+    {
+      std::uint32_t p = parent_[x].load(std::memory_order_relaxed);
+      if (p == x)
+        return x;
+      std::uint32_t gp = parent_[p].load(std::memory_order_relaxed);
+      if (gp != p)
+        parent_[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+      x = gp;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // Merge the sets of a and b. Returns false if they were already one.
+  //----------------------------------------------------------------------
+  bool unite(std::uint32_t a, std::uint32_t b)
+  {
+    for (;;)
+    {
+      a = find(a);
+      b = find(b);
+      if (a == b)
+        return false;
+      if (a < b)
+        std::swap(a, b);
+
+      // Link the larger root under the smaller, unless it stopped being
+      // a root in the meantime.
+      std::uint32_t expected = a;
+      if (parent_[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+        return true;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // Whether x represents its set. Only meaningful once the unions are
+  // done.
+  //----------------------------------------------------------------------
+  bool is_root(std::uint32_t x) const
+  {
+    return parent_[x].load(std::memory_order_relaxed) == x;
+  }
+
+private:
+  std::vector<std::atomic<std::uint32_t>> parent_;
+};
+
+//===========================================================================
+// The same forest over every 32-bit integer, for elements such as term ids
+// whose range is not known up front. Parents are kept in blocks of 64K
+// elements allocated the first time one of their elements is united, so
+// finding an element nobody united costs no memory.
+//===========================================================================
+class sparse_union_find
+{
+  static const unsigned block_bits = 16;
+  static const std::size_t block_size = std::size_t(1) << block_bits;
+  static const std::size_t block_count = std::size_t(1) << (32 - block_bits);
+
+  struct block
+  {
+    std::atomic<std::uint32_t> parent[block_size];
+  };
+
+public:
+  sparse_union_find()
+    : blocks_(new std::atomic<block*>[block_count])
+  {
+    for (std::size_t i = 0; i < block_count; ++i)
+      blocks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+
+  ~sparse_union_find()
+  {
+    for (std::size_t i = 0; i < block_count; ++i)
+      delete blocks_[i].load(std::memory_order_relaxed);
+  }
+
+  std::uint32_t find(std::uint32_t x)
+  {
+    block* b = blocks_[x >> block_bits].load(std::memory_order_acquire);
+    if (!b)
+      return x;
+    for (;;)
+    {
+      std::atomic<std::uint32_t>& px = slot(x);
+      std::uint32_t p = px.load(std::memory_order_relaxed);
+      if (p == x)
+        return x;
+      std::uint32_t gp = slot(p).load(std::memory_order_relaxed);
+      if (gp != p)
+        px.compare_exchange_weak(p, gp, std::memory_order_relaxed);
+      x = gp;
+    }
+  }
+
+  //----------------------------------------------------------------------
+  // Merge the sets of a and b. Returns false if they were already one.
+  //----------------------------------------------------------------------
+  bool unite(std::uint32_t a, std::uint32_t b)
+  {
+    allocate(a);
+    allocate(b);
+    for (;;)
+    {
+      a = find(a);
+      b = find(b);
+      if (a == b)
+        return false;
+      if (a < b)
+        std::swap(a, b);
+
+      std::uint32_t expected = a;
+      if (slot(a).compare_exchange_strong(expected, b, std::memory_order_relaxed))
+        return true;
+    }
+  }
+
+private:
+  sparse_union_find(sparse_union_find const&);
+  sparse_union_find& operator=(sparse_union_find const&);
+
+  //----------------------------------------------------------------------
+  // The parent of x, whose block must have been allocated. Every element
+  // of a set lives in an allocated block, since only unite( ) links.
+  //----------------------------------------------------------------------
+  std::atomic<std::uint32_t>& slot(std::uint32_t x)
+  {
+    block* b = blocks_[x >> block_bits].load(std::memory_order_acquire);
+    return b->parent[x & (block_size - 1)];
+  }
+
+  void allocate(std::uint32_t x)
+  {
+    std::atomic<block*>& b = blocks_[x >> block_bits];
+    if (b.load(std::memory_order_acquire))
+      return;
+
+    block* fresh = new block;
+    std::uint32_t first = x & ~std::uint32_t(block_size - 1);
+    for (std::size_t i = 0; i < block_size; ++i)
+      fresh->parent[i].store(first + static_cast<std::uint32_t>(i), std::memory_order_relaxed);
+
+    // Another thread may have allocated the same block meanwhile.
+    block* expected = nullptr;
+    if (!b.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel))
+      delete fresh;
+  }
+
+  std::unique_ptr<std::atomic<block*>[]> blocks_;
+};
+
+} // namespace rdf
+
+#endif
@@ -0,0 +1,284 @@
+//------------------------------------------------------------------------------
+// Copyright 2011 Bryan St. Amour
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// This file is part of Raptor++.
+//
+// Raptor++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Raptor++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Raptor++.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+//===========================================================================
+// This file contains the well-known rdf, rdfs, owl and xsd vocabulary as
+// compile-time constants. Every term dictionary reserves the same fixed
+// ids for these terms, so code that filters on them (is the predicate
+// rdf:type? is it owl:sameAs?) can compare a single integer instead of a
+// uri string:
+//
+//   if (t.predicate == rdf::vocab::rdfs_subClassOf) ...
+//
+// The reserved ids are uri ids in stripe 0, which the dictionaries never
+// hand out for anything else.
+//===========================================================================
+
+#ifndef BST_VOCABULARY_HPP_
+#define BST_VOCABULARY_HPP_
+
+#include "term_id.hpp"
+
+#include <string>
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+
+namespace rdf { namespace vocab {
+
+// http://www.w3.org/1999/02/22-rdf-syntax-ns#
+constexpr term_id rdf_type = 0;
+constexpr term_id rdf_Property = 1;
+constexpr term_id rdf_Statement = 2;
+constexpr term_id rdf_subject = 3;
+constexpr term_id rdf_predicate = 4;
+constexpr term_id rdf_object = 5;
+constexpr term_id rdf_first = 6;
+constexpr term_id rdf_rest = 7;
+constexpr term_id rdf_nil = 8;
+constexpr term_id rdf_List = 9;
+constexpr term_id rdf_value = 10;
+constexpr term_id rdf_Seq = 11;
+constexpr term_id rdf_Bag = 12;
+constexpr term_id rdf_Alt = 13;
+constexpr term_id rdf_langString = 14;
+constexpr term_id rdf_XMLLiteral = 15;
+
+// http://www.w3.org/2000/01/rdf-schema#
+constexpr term_id rdfs_Resource = 16;
+constexpr term_id rdfs_Class = 17;
+constexpr term_id rdfs_Literal = 18;
+constexpr term_id rdfs_Datatype = 19;
+constexpr term_id rdfs_Container = 20;
+constexpr term_id rdfs_subClassOf = 21;
+constexpr term_id rdfs_subPropertyOf = 22;
+constexpr term_id rdfs_domain = 23;
+constexpr term_id rdfs_range = 24;
+constexpr term_id rdfs_label = 25;
+constexpr term_id rdfs_comment = 26;
+constexpr term_id rdfs_seeAlso = 27;
+constexpr term_id rdfs_isDefinedBy = 28;
+constexpr term_id rdfs_member = 29;
+
+// http://www.w3.org/2002/07/owl#
+constexpr term_id owl_Ontology = 30;
+constexpr term_id owl_Class = 31;
+constexpr term_id owl_Thing = 32;
+constexpr term_id owl_Nothing = 33;
+constexpr term_id owl_NamedIndividual = 34;
+constexpr term_id owl_Restriction = 35;
+constexpr term_id owl_ObjectProperty = 36;
+constexpr term_id owl_DatatypeProperty = 37;
+constexpr term_id owl_AnnotationProperty = 38;
+constexpr term_id owl_FunctionalProperty = 39;
+constexpr term_id owl_InverseFunctionalProperty = 40;
+constexpr term_id owl_TransitiveProperty = 41;
+constexpr term_id owl_SymmetricProperty = 42;
+constexpr term_id owl_sameAs = 43;
+constexpr term_id owl_differentFrom = 44;
+constexpr term_id owl_equivalentClass = 45;
+constexpr term_id owl_equivalentProperty = 46;
+constexpr term_id owl_inverseOf = 47;
+constexpr term_id owl_disjointWith = 48;
+constexpr term_id owl_imports = 49;
+constexpr term_id owl_versionInfo = 50;
+constexpr term_id owl_deprecated = 51;
+constexpr term_id owl_onProperty = 52;
+constexpr term_id owl_someValuesFrom = 53;
+constexpr term_id owl_allValuesFrom = 54;
+constexpr term_id owl_hasValue = 55;
+constexpr term_id owl_unionOf = 56;
+constexpr term_id owl_intersectionOf = 57;
+constexpr term_id owl_complementOf = 58;
+constexpr term_id owl_oneOf = 59;
+
+// http://www.w3.org/2001/XMLSchema#
+constexpr term_id xsd_string = 60;
+constexpr term_id xsd_boolean = 61;
+constexpr term_id xsd_decimal = 62;
+constexpr term_id xsd_integer = 63;
+constexpr term_id xsd_double = 64;
+constexpr term_id xsd_float = 65;
+constexpr term_id xsd_date = 66;
+constexpr term_id xsd_dateTime = 67;
+constexpr term_id xsd_time = 68;
+constexpr term_id xsd_duration = 69;
+constexpr term_id xsd_gYear = 70;
+constexpr term_id xsd_int = 71;
+constexpr term_id xsd_long = 72;
+constexpr term_id xsd_short = 73;
+constexpr term_id xsd_byte = 74;
+constexpr term_id xsd_nonNegativeInteger = 75;
+constexpr term_id xsd_positiveInteger = 76;
+constexpr term_id xsd_anyURI = 77;
+
+//===========================================================================
+// The table of well-known terms, indexed by id.
+//===========================================================================
+struct well_known_term
+{
+  term_id id;
+  char const* iri;
+};
+
+constexpr well_known_term well_known_terms[] = {
+  { rdf_type, "http://www.w3.org/1999/02/22-rdf-syntax-ns#type" },
+  { rdf_Property, "http://www.w3.org/1999/02/22-rdf-syntax-ns#Property" },
+  { rdf_Statement, "http://www.w3.org/1999/02/22-rdf-syntax-ns#Statement" },
+  { rdf_subject, "http://www.w3.org/1999/02/22-rdf-syntax-ns#subject" },
+  { rdf_predicate, "http://www.w3.org/1999/02/22-rdf-syntax-ns#predicate" },
+  { rdf_object, "http://www.w3.org/1999/02/22-rdf-syntax-ns#object" },
+  { rdf_first, "http://www.w3.org/1999/02/22-rdf-syntax-ns#first" },
+  { rdf_rest, "http://www.w3.org/1999/02/22-rdf-syntax-ns#rest" },
+  { rdf_nil, "http://www.w3.org/1999/02/22-rdf-syntax-ns#nil" },
+  { rdf_List, "http://www.w3.org/1999/02/22-rdf-syntax-ns#List" },
+  { rdf_value, "http://www.w3.org/1999/02/22-rdf-syntax-ns#value" },
+  { rdf_Seq, "http://www.w3.org/1999/02/22-rdf-syntax-ns#Seq" },
+  { rdf_Bag, "http://www.w3.org/1999/02/22-rdf-syntax-ns#Bag" },
+  { rdf_Alt, "http://www.w3.org/1999/02/22-rdf-syntax-ns#Alt" },
+  { rdf_langString, "http://www.w3.org/1999/02/22-rdf-syntax-ns#langString" },
+  { rdf_XMLLiteral, "http://www.w3.org/1999/02/22-rdf-syntax-ns#XMLLiteral" },
+  { rdfs_Resource, "http://www.w3.org/2000/01/rdf-schema#Resource" },
+  { rdfs_Class, "http://www.w3.org/2000/01/rdf-schema#Class" },
+  { rdfs_Literal, "http://www.w3.org/2000/01/rdf-schema#Literal" },
+  { rdfs_Datatype, "http://www.w3.org/2000/01/rdf-schema#Datatype" },
+  { rdfs_Container, "http://www.w3.org/2000/01/rdf-schema#Container" },
+  { rdfs_subClassOf, "http://www.w3.org/2000/01/rdf-schema#subClassOf" },
+  { rdfs_subPropertyOf, "http://www.w3.org/2000/01/rdf-schema#subPropertyOf" },
+  { rdfs_domain, "http://www.w3.org/2000/01/rdf-schema#domain" },
+  { rdfs_range, "http://www.w3.org/2000/01/rdf-schema#range" },
+  { rdfs_label, "http://www.w3.org/2000/01/rdf-schema#label" },
+  { rdfs_comment, "http://www.w3.org/2000/01/rdf-schema#comment" },
+  { rdfs_seeAlso, "http://www.w3.org/2000/01/rdf-schema#seeAlso" },
+  { rdfs_isDefinedBy, "http://www.w3.org/2000/01/rdf-schema#isDefinedBy" },
+  { rdfs_member, "http://www.w3.org/2000/01/rdf-schema#member" },
+  { owl_Ontology, "http://www.w3.org/2002/07/owl#Ontology" },
+  { owl_Class, "http://www.w3.org/2002/07/owl#Class" },
+  { owl_Thing, "http://www.w3.org/2002/07/owl#Thing" },
+  { owl_Nothing, "http://www.w3.org/2002/07/owl#Nothing" },
+  { owl_NamedIndividual, "http://www.w3.org/2002/07/owl#NamedIndividual" },
+  { owl_Restriction, "http://www.w3.org/2002/07/owl#Restriction" },
+  { owl_ObjectProperty, "http://www.w3.org/2002/07/owl#ObjectProperty" },
+  { owl_DatatypeProperty, "http://www.w3.org/2002/07/owl#DatatypeProperty" },
+  { owl_AnnotationProperty, "http://www.w3.org/2002/07/owl#AnnotationProperty" },
+  { owl_FunctionalProperty, "http://www.w3.org/2002/07/owl#FunctionalProperty" },
+  { owl_InverseFunctionalProperty, "http://www.w3.org/2002/07/owl#InverseFunctionalProperty" },
+  { owl_TransitiveProperty, "http://www.w3.org/2002/07/owl#TransitiveProperty" },
+  { owl_SymmetricProperty, "http://www.w3.org/2002/07/owl#SymmetricProperty" },
+  { owl_sameAs, "http://www.w3.org/2002/07/owl#sameAs" },
+  { owl_differentFrom, "http://www.w3.org/2002/07/owl#differentFrom" },
+  { owl_equivalentClass, "http://www.w3.org/2002/07/owl#equivalentClass" },
+  { owl_equivalentProperty, "http://www.w3.org/2002/07/owl#equivalentProperty" },
+  { owl_inverseOf, "http://www.w3.org/2002/07/owl#inverseOf" },
+  { owl_disjointWith, "http://www.w3.org/2002/07/owl#disjointWith" },
+  { owl_imports, "http://www.w3.org/2002/07/owl#imports" },
+  { owl_versionInfo, "http://www.w3.org/2002/07/owl#versionInfo" },
+  { owl_deprecated, "http://www.w3.org/2002/07/owl#deprecated" },
+  { owl_onProperty, "http://www.w3.org/2002/07/owl#onProperty" },
+  { owl_someValuesFrom, "http://www.w3.org/2002/07/owl#someValuesFrom" },
+  { owl_allValuesFrom, "http://www.w3.org/2002/07/owl#allValuesFrom" },
+  { owl_hasValue, "http://www.w3.org/2002/07/owl#hasValue" },
+  { owl_unionOf, "http://www.w3.org/2002/07/owl#unionOf" },
+  { owl_intersectionOf, "http://www.w3.org/2002/07/owl#intersectionOf" },
+  { owl_complementOf, "http://www.w3.org/2002/07/owl#complementOf" },
+  { owl_oneOf, "http://www.w3.org/2002/07/owl#oneOf" },
+  { xsd_string, "http://www.w3.org/2001/XMLSchema#string" },
+  { xsd_boolean, "http://www.w3.org/2001/XMLSchema#boolean" },
+  { xsd_decimal, "http://www.w3.org/2001/XMLSchema#decimal" },
+  { xsd_integer, "http://www.w3.org/2001/XMLSchema#integer" },
+  { xsd_double, "http://www.w3.org/2001/XMLSchema#double" },
+  { xsd_float, "http://www.w3.org/2001/XMLSchema#float" },
+  { xsd_date, "http://www.w3.org/2001/XMLSchema#date" },
+  { xsd_dateTime, "http://www.w3.org/2001/XMLSchema#dateTime" },
+  { xsd_time, "http://www.w3.org/2001/XMLSchema#time" },
+  { xsd_duration, "http://www.w3.org/2001/XMLSchema#duration" },
+  { xsd_gYear, "http://www.w3.org/2001/XMLSchema#gYear" },
+  { xsd_int, "http://www.w3.org/2001/XMLSchema#int" },
+  { xsd_long, "http://www.w3.org/2001/XMLSchema#long" },
+  { xsd_short, "http://www.w3.org/2001/XMLSchema#short" },
+  { xsd_byte, "http://www.w3.org/2001/XMLSchema#byte" },
+  { xsd_nonNegativeInteger, "http://www.w3.org/2001/XMLSchema#nonNegativeInteger" },
+  { xsd_positiveInteger, "http://www.w3.org/2001/XMLSchema#positiveInteger" },
+  { xsd_anyURI, "http://www.w3.org/2001/XMLSchema#anyURI" },
+};
+
+constexpr std::size_t well_known_count =
+  sizeof(well_known_terms) / sizeof(well_known_terms[0]);
+
+namespace {
+
+constexpr bool ids_match_positions(std::size_t i = 0)
+{
+  return i == well_known_count
+    || (well_known_terms[i].id == i && ids_match_positions(i + 1));
+}
+
+static_assert(ids_match_positions(), "well-known term ids must match their positions");
+
+} // namespace
+
+constexpr bool is_well_known(term_id id)
+{
+  return id < well_known_count;
+}
+
+inline char const* iri(term_id id)
+{
+  return well_known_terms[id].iri;
+}
+
+//----------------------------------------------------------------------
+// The id of a well-known uri, or invalid_term_id.
+//----------------------------------------------------------------------
+inline term_id find(char const* data, std::size_t size)
+{
+  typedef std::pair<std::string, term_id> entry;
+
+  static std::vector<entry> const sorted = []() {
+      std::vector<entry> v;
+      for (auto const& t : well_known_terms)
+        v.push_back(entry(t.iri, t.id));
+      std::sort(std::begin(v), std::end(v));
+      return v;
+    }();
+
+  auto it = std::lower_bound(std::begin(sorted), std::end(sorted), data,
+    [size](entry const& e, char const* str) {
+      return e.first.compare(0, std::string::npos, str, size) < 0;
+    });
+
+  if (it != std::end(sorted) && it->first.size() == size
+      && std::memcmp(it->first.data(), data, size) == 0)
+    return it->second;
+  return invalid_term_id;
+}
+
+inline term_id find(term_view const& t)
+{
+  return t.kind == uri_term ? find(t.data, t.size) : invalid_term_id;
+}
+
+} // namespace vocab
+} // namespace rdf
+
+#endif